@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "BatchScheduler.hpp"
+#include "InferenceModel.hpp"
+#include "Layer.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * Compares scoring concurrent requests one by one with batching them through a `BatchScheduler`, on the 784-128-64-32-10 network of src/main.cpp
+ *
+ * BatchingThroughput [threads] [requests per thread]
+ */
+
+/**
+ * Runs a function for every request on each thread, timing every call
+ * @returns the latency of each call in microseconds, sorted, and the number of calls per second
+ */
+pair<vector<double>, double> Measure(const function<void(size_t)> &fn, size_t threadCount, size_t requestCount) {
+    vector<vector<double>> latencies(threadCount, vector<double>(requestCount));
+    vector<thread> threads;
+    auto start = steady_clock::now();
+
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < requestCount; i++) {
+                auto requestStart = steady_clock::now();
+                fn(t * requestCount + i);
+                latencies[t][i] = duration<double, micro>(steady_clock::now() - requestStart).count();
+            }
+        });
+    }
+
+    for (thread &t : threads) {
+        t.join();
+    }
+
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    vector<double> all;
+
+    for (const vector<double> &threadLatencies : latencies) {
+        all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+    }
+
+    sort(all.begin(), all.end());
+    return {all, all.size() / seconds};
+}
+
+void Report(const string &name, const pair<vector<double>, double> &result) {
+    const vector<double> &latencies = result.first;
+    auto percentile = [&](double p) { return latencies[min(latencies.size() - 1, (size_t) (p * latencies.size()))]; };
+
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(14) << result.second << setw(10) << percentile(0.5) << setw(10) << percentile(0.99) << endl;
+}
+
+int main(int argc, char **argv) {
+    const size_t threadCount = argc > 1 ? stoul(argv[1]) : 16;
+    const size_t requestCount = argc > 2 ? stoul(argv[2]) : 2000;
+
+    vector<Layer> layers = {Layer(28 * 28)};
+    layers.push_back(Layer(128, new ActivationFn::ReLU()));
+    layers.push_back(Layer(64, new ActivationFn::ReLU()));
+    layers.push_back(Layer(32, new ActivationFn::ReLU()));
+    layers.push_back(Layer(10, new ActivationFn::LogisticSigmoid()));
+
+    for (size_t i = 1; i < layers.size(); i++) {
+        layers[i].InitializeConnections(layers[i - 1].neuronCount);
+    }
+
+    const size_t distinctRequests = 256;
+    mt19937 rng(42);
+    uniform_real_distribution<float> pixel(0, 1);
+    vector<float> requests(distinctRequests * 784);
+    generate(requests.begin(), requests.end(), [&] { return pixel(rng); });
+
+    InferenceModel model(layers);
+    vector<vector<float>> outputs(threadCount * requestCount, vector<float>(10));
+
+    cout << threadCount << " threads, " << requestCount << " requests each" << endl;
+    cout << left << setw(28) << "path" << right << setw(14) << "requests/s" << setw(10) << "p50 us" << setw(10) << "p99 us" << endl;
+
+    Report("InferenceModel single", Measure([&](size_t i) {
+        model.Predict(&requests[i % distinctRequests * 784], outputs[i].data());
+    }, threadCount, requestCount));
+
+    for (long delay : {50, 200, 1000}) {
+        // No more requests than there are threads can be waiting at once, so larger batches would only wait out the delay
+        BatchScheduler scheduler(model, min<size_t>(threadCount, 64), microseconds(delay));
+
+        Report("BatchScheduler " + to_string(delay) + " us", Measure([&](size_t i) {
+            scheduler.Predict(&requests[i % distinctRequests * 784], outputs[i].data());
+        }, threadCount, requestCount));
+
+        cout << "    " << setprecision(1) << scheduler.Metrics().averageBatchSize << " requests per batch" << endl;
+    }
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "Benchmark.hpp"
+#include "InferenceModel.hpp"
+#include "Layer.hpp"
+#include "Matrix.hpp"
+#include "NeuralNetwork.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * Measures the latency of scoring single instances with the 784-128-64-32-10 network of src/main.cpp
+ *
+ * InferenceLatency [iterations] [--json path] [--baseline path] [--threshold fraction]
+ *
+ * The latencies of every path are also added to the benchmark results, so the median of each is compared with the baseline
+ */
+
+/**
+ * Times every call of a function, after warming up
+ * @returns the latency of each call in microseconds, sorted
+ */
+vector<double> Measure(const function<void(size_t)> &fn, size_t iterations) {
+    for (size_t i = 0; i < iterations / 10 + 1; i++) {
+        fn(i);
+    }
+
+    vector<double> latencies(iterations);
+
+    for (size_t i = 0; i < iterations; i++) {
+        auto start = steady_clock::now();
+        fn(i);
+        latencies[i] = duration<double, micro>(steady_clock::now() - start).count();
+    }
+
+    sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+void Report(Benchmark::Suite &suite, const string &name, const vector<double> &latencies) {
+    vector<double> nanoseconds(latencies.size());
+    transform(latencies.begin(), latencies.end(), nanoseconds.begin(), [](double latency) { return latency * 1e3; });
+    suite.Add(name, nanoseconds);
+
+    auto percentile = [&](double p) { return latencies[min(latencies.size() - 1, (size_t) (p * latencies.size()))]; };
+
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(10) << percentile(0.5) << setw(10) << percentile(0.99) << setw(10) << latencies.back() << endl;
+}
+
+int main(int argc, char **argv) {
+    vector<string> positional;
+    Benchmark::Suite suite("InferenceLatency", Benchmark::ParseOptions(argc, argv, positional));
+
+    const size_t iterations = positional.size() > 0 ? stoul(positional[0]) : 10000;
+
+    vector<Layer> layers = {Layer(28 * 28)};
+    layers.push_back(Layer(128, new ActivationFn::ReLU()));
+    layers.push_back(Layer(64, new ActivationFn::ReLU()));
+    layers.push_back(Layer(32, new ActivationFn::ReLU()));
+    layers.push_back(Layer(10, new ActivationFn::LogisticSigmoid()));
+
+    for (size_t i = 1; i < layers.size(); i++) {
+        layers[i].InitializeConnections(layers[i - 1].neuronCount);
+    }
+
+    // A pool of distinct requests, so the inputs are not always hot in cache
+    const size_t requestCount = 256;
+    mt19937 rng(42);
+    uniform_real_distribution<float> pixel(0, 1);
+    vector<float> requests(requestCount * 784);
+    generate(requests.begin(), requests.end(), [&] { return pixel(rng); });
+
+    InferenceModel model(layers);
+    vector<float> output(10);
+
+    cout << left << setw(28) << "path (us)" << right << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "max" << endl;
+
+    // The training forward pass, as used to score a request before the inference model existed
+    Report(suite, "Layer::CalculateValues", Measure([&](size_t i) {
+        const float *request = &requests[i % requestCount * 784];
+        Math::Matrix values(784, 1, vector<double>(request, request + 784));
+
+        for (size_t j = 1; j < layers.size(); j++) {
+            values = layers[j].CalculateValues(values);
+        }
+    }, iterations));
+
+    Report(suite, "InferenceModel single", Measure([&](size_t i) {
+        model.Predict(&requests[i % requestCount * 784], output.data());
+    }, iterations));
+
+    // Latency of a whole batch, for comparison with scoring its instances one by one
+    vector<float> batchOutput(64 * 10);
+
+    Report(suite, "InferenceModel batch of 64", Measure([&](size_t i) {
+        model.Predict(&requests[i % (requestCount - 64) * 784], 64, batchOutput.data());
+    }, iterations / 10));
+
+    cout << endl;
+    return suite.Finish(cout);
+}
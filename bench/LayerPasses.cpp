@@ -0,0 +1,67 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "Benchmark.hpp"
+#include "Layer.hpp"
+#include "Matrix.hpp"
+#include "MixedPrecision.hpp"
+#include "Optimizer.hpp"
+#include "Vector.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+
+/**
+ * Times the forward pass, the gradients and the update of each dense layer of the 784-128-64-32-10 network of src/main.cpp,
+ * in double and in mixed precision
+ *
+ * LayerPasses [--filter text] [--json path] [--baseline path] [--threshold fraction] [--min-time seconds] [--samples count]
+ *     [--compare all|allocations]
+ */
+
+int main(int argc, char **argv) {
+    vector<string> positional;
+    Benchmark::Suite suite("LayerPasses", Benchmark::ParseOptions(argc, argv, positional));
+
+    const vector<pair<size_t, size_t>> shapes = {{784, 128}, {128, 64}, {64, 32}, {32, 10}};
+    Optimizer::SGD optimizer;
+
+    for (Precision precision : {Precision::Double, Precision::Float}) {
+        const string suffix = precision == Precision::Double ? "" : " float";
+
+        for (size_t batch : {32, 128}) {
+            for (const pair<size_t, size_t> &shape : shapes) {
+                const size_t in = shape.first, out = shape.second;
+                const string name = to_string(in) + "->" + to_string(out) + " batch " + to_string(batch) + suffix;
+
+                Layer layer(out, new ActivationFn::ReLU());
+                layer.InitializeConnections(in);
+                layer.SetPrecision(precision);
+
+                Math::Matrix input = Math::Matrix::RandomMatrix(in, batch, 0, 1);
+                Math::Matrix adjustments = Math::Matrix::RandomMatrix(out, batch);
+                Math::Matrix weightGradients = layer.CalculateWeightDerivatives(adjustments, input);
+                Math::Vector biasGradients(out, 0.01);
+                Math::Matrix result(1, 1);
+
+                const double flops = 2.0 * in * out * batch;
+
+                suite.Run("forward " + name, [&] { result = layer.CalculateValues(input); }, 0, flops);
+                suite.Run("input gradients " + name, [&] { result = layer.CalculateInputDerivatives(adjustments); }, 0, flops);
+                suite.Run("weight gradients " + name, [&] { result = layer.CalculateWeightDerivatives(adjustments, input); }, 0, flops);
+
+                // the update does not depend on the batch, so it is only timed once per layer
+                if (batch == 32) {
+                    // a tiny rate keeps the weights from drifting over the millions of updates
+                    suite.Run("update " + to_string(in) + "->" + to_string(out) + suffix, [&] {
+                        layer.Optimize(optimizer, 0, weightGradients, biasGradients, 1e-12);
+                    }, 3.0 * (in * out + out) * sizeof(double));
+                }
+            }
+        }
+    }
+
+    return suite.Finish(cout);
+}
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "Matrix.hpp"
+#include "Vector.hpp"
+
+using namespace std;
+
+/**
+ * Times the operations of `Math::Matrix` on the shapes of training the 784-128-64-32-10 network of src/main.cpp
+ *
+ * MatrixOps [--filter text] [--json path] [--baseline path] [--threshold fraction] [--min-time seconds] [--samples count]
+ *     [--compare all|allocations]
+ */
+
+string Shape(size_t rows, size_t cols) {
+    return to_string(rows) + "x" + to_string(cols);
+}
+
+int main(int argc, char **argv) {
+    vector<string> positional;
+    Benchmark::Suite suite("MatrixOps", Benchmark::ParseOptions(argc, argv, positional));
+
+    // Weights of each layer as (outputs, inputs), multiplied with a batch of inputs of each size
+    const vector<pair<size_t, size_t>> layers = {{128, 784}, {64, 128}, {32, 64}, {10, 32}};
+    const vector<size_t> batchSizes = {32, 128};
+
+    for (size_t batch : batchSizes) {
+        for (const pair<size_t, size_t> &layer : layers) {
+            const size_t out = layer.first, in = layer.second;
+            Math::Matrix weights = Math::Matrix::RandomMatrix(out, in);
+            Math::Matrix input = Math::Matrix::RandomMatrix(in, batch);
+            Math::Matrix adjustments = Math::Matrix::RandomMatrix(out, batch);
+            Math::Matrix result(1, 1);
+
+            const double flops = 2.0 * out * in * batch;
+            const double bytes = (out * in + in * batch + out * batch) * sizeof(double);
+
+            // forward pass, W * X
+            suite.Run("gemm " + Shape(out, in) + " * " + Shape(in, batch), [&] { result = weights * input; }, bytes, flops);
+
+            // weight gradients, dZ * X^T, the transpose being part of the cost as training pays it
+            suite.Run("gemm " + Shape(out, batch) + " * " + Shape(in, batch) + "^T", [&] { result = adjustments * input.Transpose(); }, bytes, flops);
+
+            // input gradients, W^T * dZ
+            suite.Run("gemm " + Shape(out, in) + "^T * " + Shape(out, batch), [&] { result = weights.Transpose() * adjustments; }, bytes, flops);
+        }
+    }
+
+    for (size_t batch : batchSizes) {
+        for (size_t rows : {784, 128, 10}) {
+            Math::Matrix a = Math::Matrix::RandomMatrix(rows, batch);
+            Math::Matrix b = Math::Matrix::RandomMatrix(rows, batch);
+            Math::Vector bias(vector<double>(rows, 0.5));
+            Math::Vector ones(batch, 1.0);
+            Math::Matrix result(1, 1);
+
+            const string shape = Shape(rows, batch);
+            const double count = rows * batch;
+
+            suite.Run("add " + shape, [&] { result = a + b; }, 3 * count * sizeof(double), count);
+            suite.Run("add column " + shape, [&] { result = a + bias; }, (2 * count + rows) * sizeof(double), count);
+            suite.Run("hadamard " + shape, [&] { result = a & b; }, 3 * count * sizeof(double), count);
+            suite.Run("scale " + shape, [&] { result = a * 0.5; }, 2 * count * sizeof(double), count);
+            suite.Run("in-place add " + shape, [&] { a += b; }, 3 * count * sizeof(double), count);
+
+            // rows are summed as bias gradients are, by multiplying with a vector of ones
+            suite.Run("row sum " + shape, [&] { result = a * ones; }, (count + batch + rows) * sizeof(double), 2 * count);
+
+            suite.Run("apply " + shape, [&] { result = a.Apply([](double x) { return max(x, 0.0); }); }, 2 * count * sizeof(double));
+            suite.Run("transpose " + shape, [&] { result = a.Transpose(); }, 2 * count * sizeof(double));
+        }
+    }
+
+    return suite.Finish(cout);
+}
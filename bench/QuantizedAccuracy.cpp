@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "Dataset.hpp"
+#include "DatasetStream.hpp"
+#include "InferenceModel.hpp"
+#include "NeuralNetwork.hpp"
+#include "QuantizedModel.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+using namespace std::chrono;
+
+/**
+ * Compares the accuracy, weight size and throughput of a checkpoint quantized to 8 bits with its single precision inference model
+ *
+ * QuantizedAccuracy <model> <training dataset> <testing dataset> [calibration size]
+ *
+ * Datasets are binary datasets written by tools/ConvertDataset.cpp, the activations are calibrated on a sample of the training set
+ */
+
+/**
+ * Index of the largest output, the class predicted for an instance
+ */
+size_t Class(const float *values, size_t size) {
+    return max_element(values, values + size) - values;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        cerr << "usage: QuantizedAccuracy <model> <training dataset> <testing dataset> [calibration size]" << endl;
+        return 1;
+    }
+
+    const size_t calibrationSize = argc > 4 ? stoul(argv[4]) : 1024;
+
+    try {
+        MultilayerPerceptron network;
+        network.Load(argv[1]);
+
+        Dataset trainingSet = Dataset::Load(argv[2]);
+        DatasetStream training(trainingSet);
+        Dataset testing = Dataset::Load(argv[3]);
+
+        InferenceModel model = network.Compile();
+        QuantizedModel quantized = network.Quantize(training, calibrationSize);
+
+        // Instances are read through a stream, as binary datasets may store narrower types than double
+        const Benchmark::Instances instances = Benchmark::ReadInstances(testing);
+        const size_t count = instances.count;
+        const size_t outputSize = model.outputSize();
+        const vector<float> &inputs = instances.inputs;
+
+        vector<float> floatOutputs(count * outputSize);
+        vector<float> quantizedOutputs(count * outputSize);
+
+        auto start = steady_clock::now();
+        model.Predict(inputs.data(), count, floatOutputs.data());
+        double floatSeconds = duration<double>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        quantized.Predict(inputs.data(), count, quantizedOutputs.data());
+        double quantizedSeconds = duration<double>(steady_clock::now() - start).count();
+
+        size_t floatCorrect = 0;
+        size_t quantizedCorrect = 0;
+        size_t agreeing = 0;
+        double largestDifference = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            size_t target = instances.classes[i];
+            size_t floatClass = Class(&floatOutputs[i * outputSize], outputSize);
+            size_t quantizedClass = Class(&quantizedOutputs[i * outputSize], outputSize);
+
+            floatCorrect += floatClass == target;
+            quantizedCorrect += quantizedClass == target;
+            agreeing += floatClass == quantizedClass;
+
+            for (size_t j = 0; j < outputSize; j++) {
+                largestDifference = max(largestDifference, (double) abs(floatOutputs[i * outputSize + j] - quantizedOutputs[i * outputSize + j]));
+            }
+        }
+
+        // Each quantized weight takes a byte
+        const size_t parameterCount = quantized.weightSize();
+        double floatAccuracy = (double) floatCorrect / count;
+        double quantizedAccuracy = (double) quantizedCorrect / count;
+
+        cout << fixed << setprecision(4);
+        cout << count << " testing instances, calibrated on " << min(calibrationSize, trainingSet.size()) << " training instances" << endl;
+        cout << "weights       double " << parameterCount * sizeof(double) << " bytes, float " << parameterCount * sizeof(float)
+             << " bytes, int8 " << quantized.weightSize() << " bytes (padded rows and inputs included)" << endl;
+        cout << "accuracy      float " << floatAccuracy << ", int8 " << quantizedAccuracy << ", delta " << quantizedAccuracy - floatAccuracy << endl;
+        cout << "agreement     " << (double) agreeing / count << " of predicted classes, largest output difference " << largestDifference << endl;
+        cout << setprecision(2);
+        cout << "throughput    float " << count / floatSeconds << " instances/s, int8 " << count / quantizedSeconds << " instances/s" << endl;
+    }
+    catch (const exception &error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
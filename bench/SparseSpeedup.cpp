@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "Benchmark.hpp"
+#include "Dataset.hpp"
+#include "InferenceModel.hpp"
+#include "Layer.hpp"
+#include "Matrix.hpp"
+#include "NeuralNetwork.hpp"
+#include "Pruning.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+
+/**
+ * Measures the speedup of the sparse inference kernels over the dense ones as the layers are pruned further
+ *
+ * SparseSpeedup [model] [testing dataset]
+ *
+ * Without a model, the 784-128-64-32-10 network of src/main.cpp is initialized randomly. With a model and a binary testing
+ * dataset, the accuracy of each pruned model is reported too, pruned without fine-tuning
+ */
+
+int main(int argc, char **argv) {
+    auto network = [&] {
+        unique_ptr<MultilayerPerceptron> model(new MultilayerPerceptron());
+
+        if (argc > 1) {
+            model->Load(argv[1]);
+            return model;
+        }
+
+        model->AddLayer(Layer(28 * 28));
+        model->AddLayer(Layer(128, new ActivationFn::ReLU()));
+        model->AddLayer(Layer(64, new ActivationFn::ReLU()));
+        model->AddLayer(Layer(32, new ActivationFn::ReLU()));
+        model->AddLayer(Layer(10, new ActivationFn::LogisticSigmoid()));
+        return model;
+    };
+
+    // Testing instances, or random requests without a dataset
+    vector<float> inputs;
+    vector<size_t> classes;
+    size_t count = 1024;
+
+    if (argc > 2) {
+        Benchmark::Instances testing = Benchmark::ReadInstances(Dataset::Load(argv[2]));
+        count = testing.count;
+        inputs = move(testing.inputs);
+        classes = move(testing.classes);
+    }
+    else {
+        mt19937 rng(42);
+        uniform_real_distribution<float> pixel(0, 1);
+        inputs.resize(count * 784);
+        generate(inputs.begin(), inputs.end(), [&] { return pixel(rng); });
+    }
+
+    struct Level
+    {
+        string name;
+        PruningOptions options;
+        double sparsity;
+    };
+
+    vector<Level> levels;
+
+    for (double sparsity : {0.0, 0.5, 0.7, 0.8, 0.9, 0.95, 0.98}) {
+        PruningOptions options;
+        options.sparsity = sparsity;
+        levels.push_back({"magnitude " + to_string((int) lround(sparsity * 100)) + "%", options, sparsity});
+    }
+
+    PruningOptions nm;
+    nm.pattern = PruningOptions::Pattern::NM;
+    levels.push_back({"2:4", nm, 0.5});
+
+    PruningOptions block;
+    block.pattern = PruningOptions::Pattern::Block;
+    block.sparsity = 0.9;
+    levels.push_back({"block 4x4 90%", block, 0.9});
+
+    cout << left << setw(18) << "pruning" << right << setw(10) << "sparse"
+         << setw(12) << "dense us" << setw(12) << "sparse us" << setw(10) << "speedup"
+         << setw(12) << "dense us" << setw(12) << "sparse us" << setw(10) << "speedup";
+
+    if (!classes.empty())
+        cout << setw(10) << "accuracy";
+
+    cout << endl << left << setw(28) << "" << right << setw(34) << "per instance, batches of 64" << setw(34) << "single instance" << endl;
+
+    for (const Level &level : levels) {
+        unique_ptr<MultilayerPerceptron> model = network();
+        model->Prune(level.options);
+
+        // Density 0 keeps every layer dense, density 1 makes every layer sparse
+        InferenceModel dense = model->Compile(64, 0);
+        InferenceModel sparse = model->Compile(64, 1);
+
+        const size_t inputSize = dense.inputSize();
+        const size_t outputSize = dense.outputSize();
+        vector<float> denseOutputs(count * outputSize);
+        vector<float> sparseOutputs(count * outputSize);
+
+        double denseBatch = Benchmark::Median([&] { dense.Predict(inputs.data(), 64, denseOutputs.data()); }, 200) / 64;
+        double sparseBatch = Benchmark::Median([&] { sparse.Predict(inputs.data(), 64, sparseOutputs.data()); }, 200) / 64;
+
+        size_t next = 0;
+        double denseSingle = Benchmark::Median([&] { dense.Predict(&inputs[next++ % count * inputSize], denseOutputs.data()); }, 5000);
+        double sparseSingle = Benchmark::Median([&] { sparse.Predict(&inputs[next++ % count * inputSize], sparseOutputs.data()); }, 5000);
+
+        cout << left << setw(18) << level.name << right << fixed << setprecision(2)
+             << setw(10) << level.sparsity << setw(12) << denseBatch << setw(12) << sparseBatch << setw(10) << denseBatch / sparseBatch
+             << setw(12) << denseSingle << setw(12) << sparseSingle << setw(10) << denseSingle / sparseSingle;
+
+        if (!classes.empty()) {
+            sparse.Predict(inputs.data(), count, sparseOutputs.data());
+            size_t correct = 0;
+
+            for (size_t i = 0; i < count; i++) {
+                const float *output = &sparseOutputs[i * outputSize];
+                correct += (size_t) (max_element(output, output + outputSize) - output) == classes[i];
+            }
+
+            cout << setw(10) << setprecision(4) << (double) correct / count;
+        }
+
+        cout << endl;
+    }
+}
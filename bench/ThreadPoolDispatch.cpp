@@ -0,0 +1,85 @@
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "TaskGraph.hpp"
+#include "Threadpool.hpp"
+
+using namespace std;
+
+/**
+ * Times dispatching work to a `ThreadPool`, alone and through a `TaskGraph`, with tasks doing nothing so only the overhead is left
+ *
+ * ThreadPoolDispatch [--filter text] [--json path] [--baseline path] [--threshold fraction] [--min-time seconds] [--samples count]
+ *     [--compare all|allocations]
+ */
+
+/**
+ * Queues empty tasks and waits until they have all run
+ */
+void Dispatch(ThreadPool &pool, size_t taskCount) {
+    mutex doneMutex;
+    condition_variable done;
+    size_t remaining = taskCount;
+
+    for (size_t i = 0; i < taskCount; i++) {
+        pool.QueueTask([&] {
+            unique_lock<mutex> lock(doneMutex);
+
+            if (--remaining == 0)
+                done.notify_one();
+        });
+    }
+
+    unique_lock<mutex> lock(doneMutex);
+    done.wait(lock, [&remaining] { return remaining == 0; });
+}
+
+int main(int argc, char **argv) {
+    vector<string> positional;
+    Benchmark::Suite suite("ThreadPoolDispatch", Benchmark::ParseOptions(argc, argv, positional));
+
+    // waking pool threads depends on the scheduler more than on the code, so dispatch times vary widely between runs
+    suite.SetThreshold(0.5);
+
+    ThreadPool pool;
+
+    // latency of a round trip to a sleeping pool thread and back
+    suite.Run("dispatch 1 task", [&] { Dispatch(pool, 1); });
+
+    // tasks queued faster than they run, so the time per task is the throughput of the queue
+    for (size_t taskCount : {16, 256, 4096}) {
+        suite.Run("dispatch " + to_string(taskCount) + " tasks", [&] { Dispatch(pool, taskCount); });
+    }
+
+    // graphs shaped as backpropagation's, a chain of dependent tasks and tasks fanning out from one
+    for (size_t taskCount : {4, 16}) {
+        suite.Run("task graph chain of " + to_string(taskCount), [&] {
+            TaskGraph graph;
+            TaskGraph::TaskId previous = graph.AddTask([] {});
+
+            for (size_t i = 1; i < taskCount; i++) {
+                previous = graph.AddTask([] {}, {previous});
+            }
+
+            graph.Run(pool);
+        });
+
+        suite.Run("task graph fan out of " + to_string(taskCount), [&] {
+            TaskGraph graph;
+            TaskGraph::TaskId root = graph.AddTask([] {});
+
+            for (size_t i = 1; i < taskCount; i++) {
+                graph.AddTask([] {}, {root});
+            }
+
+            graph.Run(pool);
+        });
+    }
+
+    return suite.Finish(cout);
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "Benchmark.hpp"
+#include "CostFn.hpp"
+#include "Dataset.hpp"
+#include "NeuralNetwork.hpp"
+#include "Optimizer.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+
+/**
+ * Times whole training epochs of the 784-128-64-32-10 network of src/main.cpp on synthetic MNIST-like data, so it runs without the dataset
+ *
+ * TrainingEpoch [instances] [--filter text] [--json path] [--baseline path] [--threshold fraction] [--min-time seconds] [--samples count]
+ *     [--compare all|allocations]
+ */
+
+/**
+ * Discards everything written to it, silencing the progress training prints
+ */
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+};
+
+/**
+ * Instances of 10 classes of 28x28 images, each a noisy copy of a random pattern of strokes, most pixels being 0 as in MNIST
+ */
+Dataset SyntheticDigits(size_t count) {
+    mt19937 rng(42);
+    uniform_real_distribution<double> uniform(0, 1);
+    normal_distribution<double> noise(0, 0.2);
+
+    vector<vector<double>> patterns(10, vector<double>(784, 0));
+
+    for (vector<double> &pattern : patterns) {
+        for (double &pixel : pattern) {
+            pixel = uniform(rng) < 0.2 ? uniform(rng) * 0.5 + 0.5 : 0;
+        }
+    }
+
+    Dataset dataset(count, 784, 1);
+
+    for (size_t i = 0; i < count; i++) {
+        const size_t label = i % 10;
+        double *parameters = dataset.Parameters(i);
+
+        for (size_t j = 0; j < 784; j++) {
+            parameters[j] = patterns[label][j] > 0 ? min(1.0, max(0.0, patterns[label][j] + noise(rng))) : 0;
+        }
+
+        dataset.Labels(i)[0] = label;
+    }
+
+    return dataset;
+}
+
+/**
+ * Adds the layers of src/main.cpp, evaluating a small sample of the training set without printing it
+ */
+void Configure(MultilayerPerceptron &model) {
+    model.AddLayer(Layer(28 * 28));
+    model.AddLayer(Layer(128, new ActivationFn::ReLU()));
+    model.AddLayer(Layer(64, new ActivationFn::ReLU()));
+    model.AddLayer(Layer(32, new ActivationFn::ReLU()));
+    model.AddLayer(Layer(10, new ActivationFn::LogisticSigmoid()));
+
+    EvaluationOptions evaluation;
+    evaluation.trainingSampleSize = 500;
+    evaluation.callback = [](const EvaluationResult &) {};
+    model.SetEvaluationOptions(evaluation);
+}
+
+int main(int argc, char **argv) {
+    vector<string> positional;
+    Benchmark::Suite suite("TrainingEpoch", Benchmark::ParseOptions(argc, argv, positional));
+
+    const size_t instances = positional.size() > 0 ? stoul(positional[0]) : 6000;
+    const Dataset dataset = SyntheticDigits(instances);
+
+    NullBuffer nullBuffer;
+    streambuf *console = cout.rdbuf();
+
+    // Every sample trains a fresh model for one epoch, each batch a forward pass, backpropagation and an update
+    auto epoch = [&](size_t batchSize, Precision precision, bool adam) {
+        return [&, batchSize, precision, adam] {
+            MultilayerPerceptron model(new CostFn::SparseCategoricalCrossEntropy());
+            Configure(model);
+
+            if (adam)
+                model.SetOptimizer(new Optimizer::Adam());
+
+            MixedPrecisionOptions mixedPrecision;
+            mixedPrecision.precision = precision;
+            model.SetMixedPrecision(mixedPrecision);
+
+            cout.rdbuf(&nullBuffer);
+            model.Train(dataset, 1, 0.1, batchSize);
+            cout.rdbuf(console);
+        };
+    };
+
+    // the many small products of batches of 32 leave the epoch at the mercy of the scheduler, so its samples vary widely
+    suite.SetThreshold(0.5);
+    suite.Run("epoch batch 32", epoch(32, Precision::Double, false));
+    suite.SetThreshold(0);
+
+    suite.Run("epoch batch 128", epoch(128, Precision::Double, false));
+    suite.Run("epoch batch 128 float", epoch(128, Precision::Float, false));
+    suite.Run("epoch batch 128 adam", epoch(128, Precision::Double, true));
+
+    return suite.Finish(cout);
+}
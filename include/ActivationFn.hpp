@@ -1,10 +1,26 @@
 #pragma once
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <functional>
 
 namespace ActivationFn
 {
+    /**
+     * Identifies an activation function in saved models, values must stay stable across versions
+     */
+    enum class Id : std::uint8_t
+    {
+        None = 0,
+        Identity = 1,
+        ReLU = 2,
+        LeakyReLU = 3,
+        Tanh = 4,
+        LogisticSigmoid = 5,
+        Linear = 6
+    };
+
     class ActivationFn
     {
     public:
@@ -15,6 +31,7 @@ namespace ActivationFn
         virtual double dx(double x);
         std::function<double(double)> dx();
         virtual ActivationFn* clone();
+        virtual Id id() const;
     };
 
     class ReLU : public ActivationFn
@@ -23,6 +40,7 @@ namespace ActivationFn
         double fn(double x) override;
         double dx(double x) override;
         ActivationFn* clone() override;
+        Id id() const override;
     };
 
     class LeakyReLU : public ActivationFn
@@ -31,6 +49,7 @@ namespace ActivationFn
         double fn(double x) override;
         double dx(double x) override;
         ActivationFn* clone() override;
+        Id id() const override;
     };
 
     class Tanh : public ActivationFn
@@ -39,6 +58,7 @@ namespace ActivationFn
         double fn(double x) override;
         double dx(double x) override;
         ActivationFn* clone() override;
+        Id id() const override;
     };
 
     class LogisticSigmoid : public ActivationFn
@@ -47,6 +67,7 @@ namespace ActivationFn
         double fn(double x) override;
         double dx(double x) override;
         ActivationFn* clone() override;
+        Id id() const override;
     };
 
     class Linear : public ActivationFn
@@ -55,5 +76,17 @@ namespace ActivationFn
         double fn(double x) override;
         double dx(double x) override;
         ActivationFn* clone() override;
+        Id id() const override;
     };
+
+    /**
+     * Creates the activation function of an id
+     * @returns the activation function, or nullptr for `Id::None`
+     */
+    ActivationFn* Create(Id id);
+
+    /**
+     * Applies the activation function of an id to consecutive single precision values in place, for the inference models
+     */
+    void Apply(Id id, float *values, std::size_t count);
 }
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+
+/**
+ * A single heap allocation aligned to a given boundary, zero initialized
+ */
+class AlignedBuffer
+{
+public:
+    /**
+     * @param size size of the buffer in bytes
+     * @param alignment alignment of the start of the buffer in bytes, must be a power of two
+     */
+    AlignedBuffer(std::size_t size, std::size_t alignment = 64);
+    ~AlignedBuffer();
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    void *data();
+    const void *data() const;
+    std::size_t size() const;
+
+    /**
+     * Rounds a size up to the next multiple of an alignment
+     */
+    static std::size_t AlignUp(std::size_t size, std::size_t alignment = 64);
+
+private:
+    void *allocation;   // Start of the underlying allocation, before alignment
+    void *aligned;
+    std::size_t bufferSize;
+};
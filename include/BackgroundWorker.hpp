@@ -0,0 +1,48 @@
+#pragma once
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+ * Runs one job at a time on a background thread of lower priority, so it only uses cores left idle by the caller
+ */
+class BackgroundWorker
+{
+public:
+    using Job = std::function<void()>;
+
+    BackgroundWorker();
+
+    /**
+     * Waits for the running job to finish, ignoring its errors
+     */
+    ~BackgroundWorker();
+
+    BackgroundWorker(const BackgroundWorker &) = delete;
+    BackgroundWorker &operator=(const BackgroundWorker &) = delete;
+
+    /**
+     * Waits for the running job to finish, then starts another
+     *
+     * An error thrown by the previous job is rethrown here instead of starting the new one
+     */
+    void Submit(const Job &job);
+
+    /**
+     * Waits for the running job to finish, rethrowing its error
+     */
+    void Wait();
+
+private:
+    Job job;
+    bool should_terminate = false;
+    std::exception_ptr error;
+
+    std::mutex job_mutex;
+    std::condition_variable job_condition;
+    std::thread worker;
+
+    void WorkerLoop();
+};
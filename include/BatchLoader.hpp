@@ -0,0 +1,118 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Data.hpp"
+#include "DataStream.hpp"
+#include "Dataset.hpp"
+
+/**
+ * Prepares training batches on a background thread while the current batch trains
+ *
+ * Batches are gathered into a ring of preallocated buffers, shuffling only an index permutation each epoch.
+ * The loader keeps running across epochs, so the first batches of the next epoch are ready before it starts
+ */
+class BatchLoader
+{
+public:
+    /**
+     * Gathers the instances at the given indices into the columns of a batch
+     * @param indices indices of the instances to gather
+     * @param count number of indices, the batch is already resized to hold this many instances
+     * @param batch preallocated batch to write into
+     */
+    using Gatherer = std::function<void(const std::uint32_t *indices, std::size_t count, Data &batch)>;
+
+    /**
+     * @param data dataset to batch, must outlive the loader
+     * @param batchSize the size of each training batch (0 for no batching)
+     * @param prefetchCount number of batches prepared ahead of the one being trained on
+     * @param shuffle whether to reshuffle the instances every epoch
+     * @param sparse whether to gather the parameters of each batch into compressed sparse rows
+     */
+    BatchLoader(const Dataset &data, std::size_t batchSize = 0, std::size_t prefetchCount = 4, bool shuffle = true, bool sparse = false);
+
+    /**
+     * @param gatherer function writing instances into a batch
+     * @param instanceCount number of instances in the data source
+     * @param parameterSize size of the parameter list of each instance
+     * @param labelSize size of the label list of each instance
+     * @param batchSize the size of each training batch (0 for no batching)
+     * @param prefetchCount number of batches prepared ahead of the one being trained on
+     * @param shuffle whether to reshuffle the instances every epoch
+     */
+    BatchLoader(Gatherer gatherer, std::size_t instanceCount, std::size_t parameterSize, std::size_t labelSize, std::size_t batchSize = 0, std::size_t prefetchCount = 4, bool shuffle = true);
+
+    /**
+     * Reads batches from a stream in its order, rewinding it at the end of every epoch
+     * @param stream stream to batch, must outlive the loader and is only read by the loader thread
+     * @param batchSize the size of each training batch
+     * @param prefetchCount number of batches prepared ahead of the one being trained on
+     */
+    BatchLoader(DataStream &stream, std::size_t batchSize, std::size_t prefetchCount = 4);
+
+    ~BatchLoader();
+
+    BatchLoader(const BatchLoader &) = delete;
+    BatchLoader &operator=(const BatchLoader &) = delete;
+
+    /**
+     * Waits for the next prepared batch, releasing the batch previously returned back to the loader
+     * @returns the batch, valid until the next call
+     */
+    Data &Next();
+
+    /**
+     * Whether the batch last returned by `Next` is the last batch of its epoch
+     */
+    bool EndOfEpoch() const;
+
+    /**
+     * Number of batches in each epoch, or 0 when batching a stream whose length is not known ahead
+     */
+    std::size_t BatchCount() const;
+
+private:
+    /**
+     * Writes the next batch into a slot
+     * @returns whether the batch is the last of its epoch
+     */
+    using Producer = std::function<bool(Data &batch)>;
+
+    Producer producer;
+    Gatherer gatherer;
+    std::size_t instanceCount;
+    std::size_t batchSize;
+    bool shuffle;
+    bool sparse = false;
+
+    std::vector<std::uint32_t> indices;     // Owned by the loader thread
+    std::size_t nextBatch = 0;              // Batch of the epoch gathered next, owned by the loader thread
+    std::default_random_engine rng;
+    std::vector<Data> slots;                // Ring of batch buffers
+    std::vector<char> slotEndsEpoch;        // Whether the batch in each slot is the last of its epoch
+    bool endOfEpoch = false;
+
+    std::size_t producedCount = 0;          // Batches written to the ring
+    std::size_t consumedCount = 0;          // Batches handed out by Next
+    bool should_terminate = false;
+    std::exception_ptr error;
+
+    std::mutex ring_mutex;
+    std::condition_variable ring_condition;
+    std::thread loader;
+
+    void Start(std::size_t parameterSize, std::size_t labelSize, std::size_t prefetchCount);
+    void LoaderLoop();
+
+    /**
+     * Gathers the next batch of the shuffled indices, shuffling them again at the start of every epoch
+     */
+    bool GatherNext(Data &batch);
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "InferenceModel.hpp"
+
+namespace NeuralNetwork
+{
+    /**
+     * Throughput and latency of the requests served by a `BatchScheduler`
+     */
+    struct SchedulerMetrics
+    {
+        std::size_t requests;
+        std::size_t batches;
+        double averageBatchSize;
+
+        /**
+         * Requests served per second, since the scheduler started or the metrics were last reset
+         */
+        double throughput;
+
+        /**
+         * Latencies in microseconds from a request arriving to its output being written, over the most recent requests
+         */
+        double meanLatency;
+        double p50Latency;
+        double p99Latency;
+        double maxLatency;
+    };
+
+    /**
+     * Collects concurrent single-instance requests into batches, so callers on many threads share the efficiency of a batched forward pass
+     *
+     * A batch is run once it reaches the maximum batch size, or once its oldest request has waited for the maximum delay.
+     * Inputs are gathered into one buffer, predicted by a dispatcher thread, and the outputs scattered back to the waiting callers
+     */
+    class BatchScheduler
+    {
+    public:
+        /**
+         * Number of latencies kept for the percentiles of `Metrics`
+         */
+        static const std::size_t LATENCY_WINDOW = 1 << 16;
+
+        /**
+         * @param model model predicting the batches, must outlive the scheduler
+         * @param maxBatchSize largest batch to run at once, 0 for the maximum batch size of the model
+         * @param maxDelay longest time a request waits for others to join its batch
+         */
+        BatchScheduler(const InferenceModel &model, std::size_t maxBatchSize = 0, std::chrono::microseconds maxDelay = std::chrono::microseconds(200));
+
+        /**
+         * Finishes every queued request before stopping the dispatcher
+         */
+        ~BatchScheduler();
+
+        BatchScheduler(const BatchScheduler &) = delete;
+        BatchScheduler &operator=(const BatchScheduler &) = delete;
+
+        /**
+         * Predicts the output of a single instance as part of a batch, blocking until it is written, safe to call from many threads at once
+         * @param input parameters of the instance, read by the dispatcher so it must stay valid until the call returns
+         * @param output written with the output of the instance
+         */
+        void Predict(const float *input, float *output);
+
+        /**
+         * @param reset whether to start counting requests and latencies anew after reading them
+         * @returns metrics of the requests served since the scheduler started or the metrics were last reset
+         */
+        SchedulerMetrics Metrics(bool reset = false);
+
+    private:
+        /**
+         * A request waiting on the stack of its caller
+         */
+        struct Request
+        {
+            const float *input;
+            float *output;
+            std::chrono::steady_clock::time_point arrival;
+            bool done = false;
+            std::exception_ptr error;
+            std::condition_variable condition;
+        };
+
+        const InferenceModel &model;
+        std::size_t batchSize;
+        std::chrono::microseconds maxDelay;
+
+        std::vector<Request *> pending;
+        bool should_terminate = false;
+
+        std::mutex queue_mutex;
+        std::condition_variable queue_condition;
+        std::thread dispatcher;
+
+        std::vector<float> inputs;                  // Gathered inputs of the running batch
+        std::vector<float> outputs;
+
+        std::size_t requestCount = 0;
+        std::size_t batchCount = 0;
+        std::vector<double> latencies;              // Ring of the most recent latencies, in microseconds
+        std::size_t latencyCount = 0;               // Latencies recorded since the last reset, including overwritten ones
+        double latencyTotal = 0;
+        std::chrono::steady_clock::time_point metricsStart;
+
+        void DispatchLoop();
+    };
+}
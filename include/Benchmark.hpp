@@ -0,0 +1,150 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Dataset;
+
+/**
+ * Harness of the programs in bench/, timing benchmarks, writing their results as JSON and comparing them with a stored baseline
+ *
+ * Every program accepts the options parsed by `ParseOptions`, and exits with 1 when a benchmark regressed against the baseline
+ */
+namespace Benchmark
+{
+    /**
+     * Timings of a benchmark, in nanoseconds per iteration
+     */
+    struct Result
+    {
+        std::string name;
+        double median;
+        double min;
+        double max;
+        std::size_t samples;
+        double bytes;           // Bytes touched per iteration, 0 when not counted
+        double flops;           // Floating point operations per iteration, 0 when not counted
+        double allocations;     // Allocations of matrix storage per iteration, -1 when the library is built without `NN_PROFILE`
+
+        /**
+         * Largest slowdown of the median tolerated by a baseline, as a fraction of it, 0 for the threshold of the comparison
+         */
+        double threshold;
+    };
+
+    struct Options
+    {
+        std::string filter;             // Only benchmarks whose name contains it are run
+        std::string jsonPath;           // Results are written there when not empty
+        std::string baselinePath;       // Results are compared with the baseline there when not empty
+        double threshold = 0.1;         // Slowdown of the median over which a benchmark regressed
+        double minSeconds = 0.5;        // Time spent measuring each benchmark
+        std::size_t samples = 7;
+
+        /**
+         * Whether medians are compared with the baseline, or only allocations, as in profile builds whose timings the profiler slows
+         */
+        bool timesCompared = true;
+    };
+
+    /**
+     * Parses `--filter <text>`, `--json <path>`, `--baseline <path>`, `--threshold <fraction>`, `--min-time <seconds>`, `--samples <count>`
+     * and `--compare <all|allocations>`
+     * @returns the options, the arguments a program takes itself being left in `positional`
+     */
+    Options ParseOptions(int argc, char **argv, std::vector<std::string> &positional);
+
+    /**
+     * The benchmarks of a program
+     */
+    class Suite
+    {
+    public:
+        Suite(const std::string &name, const Options &options);
+
+        /**
+         * Whether a benchmark is run under the filter of the options, so costly setup can be skipped
+         */
+        bool Selected(const std::string &name) const;
+
+        /**
+         * Sets the slowdown tolerated for the benchmarks run after it, for noisy benchmarks, kept in the results so baselines written from them keep it
+         * @param threshold fraction of the median, 0 for the threshold of the comparison
+         */
+        void SetThreshold(double threshold);
+
+        /**
+         * Times a function, calling it enough times per sample for the samples to take `minSeconds` together
+         * @param bytes bytes touched by a call, for reporting bandwidth
+         * @param flops floating point operations of a call, for reporting arithmetic throughput
+         */
+        void Run(const std::string &name, const std::function<void()> &fn, double bytes = 0, double flops = 0);
+
+        /**
+         * Adds a benchmark timed by the caller
+         * @param nanoseconds time of each sample per iteration
+         */
+        void Add(const std::string &name, std::vector<double> nanoseconds, double bytes = 0, double flops = 0, double allocations = -1);
+
+        /**
+         * Prints the results, writes them as JSON and compares them with the baseline, as the options ask
+         * @returns the exit code of the program, 1 when a benchmark regressed
+         */
+        int Finish(std::ostream &out);
+
+        const std::vector<Result> &results() const;
+
+    private:
+        std::string name;
+        Options options;
+        std::vector<Result> suiteResults;
+        double threshold = 0;
+    };
+
+    /**
+     * Writes the results of a suite as JSON
+     * @param pathname path of the file to write
+     */
+    void WriteResults(const std::string &suite, const std::vector<Result> &results, const std::string &pathname);
+
+    /**
+     * Reads results written by `WriteResults`
+     * @param pathname path of the file to read
+     */
+    std::vector<Result> ReadResults(const std::string &pathname);
+
+    /**
+     * Compares results with a baseline by name, printing the change of every median
+     *
+     * Medians are compared rather than minimums, so a single lucky sample does not hide a regression. Allocations regress
+     * as soon as there are more of them, when both sides counted them
+     * @param threshold slowdown tolerated for baseline results without their own threshold
+     * @param timesCompared false to only compare allocations
+     * @returns the number of benchmarks that regressed
+     */
+    std::size_t Compare(const std::vector<Result> &baseline, const std::vector<Result> &results, double threshold, std::ostream &out, bool timesCompared = true);
+
+    /**
+     * Times a function after warming up, for the tools reporting single latencies rather than a suite
+     * @returns the median time of a call in microseconds
+     */
+    double Median(const std::function<void()> &fn, std::size_t iterations);
+
+    /**
+     * Instances of a dataset as single precision, one instance after another, as inference models take them
+     */
+    struct Instances
+    {
+        std::vector<float> inputs;
+        std::vector<std::size_t> classes;   // Class of each instance, from scalar or one-hot labels
+        std::size_t count;
+        std::size_t inputSize;
+    };
+
+    /**
+     * Reads every instance of a dataset through a stream, as binary datasets may store narrower types than double
+     */
+    Instances ReadInstances(const Dataset &dataset);
+}
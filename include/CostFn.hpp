@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <functional>
 
 #include "Matrix.hpp"
@@ -7,6 +8,17 @@
 
 namespace CostFn
 {
+    /**
+     * Identifies a cost function in saved models, values must stay stable across versions
+     */
+    enum class Id : std::uint8_t
+    {
+        Default = 0,
+        L2 = 1,
+        CrossEntropy = 2,
+        SparseCategoricalCrossEntropy = 3
+    };
+
     // Uses L2 as placeholder virtual functions to stop compiler from screaming
     class CostFn
     {
@@ -27,6 +39,14 @@ namespace CostFn
          * @return whether prediction is correct
         */
         virtual double evaluate(const Math::Matrix &pred, const Math::Matrix &label);
+
+        /**
+         * total cost of a set of predictions, without transforming the labels into a matrix first
+         * @param pred predicted labels as output vectors
+         * @param label real labels
+         * @return sum of the cost of every prediction
+        */
+        virtual double cost(const Math::Matrix &pred, const Math::Matrix &label);
         
         /**
          * transforms labels of a dataset to fit the output space, with reference to the output layer
@@ -35,6 +55,8 @@ namespace CostFn
          * @return data with transformed labels
         */
         virtual Data transformLabels(const Data &data, const NeuralNetwork::Layer &outputLayer);
+
+        virtual Id id() const;
     };
 
     class L2 : public CostFn
@@ -42,6 +64,7 @@ namespace CostFn
     public:
         double fn(double value, double target) override;
         double dx(double value, double target) override;
+        Id id() const override;
     };
 
     // A.K.A. Log Loss
@@ -51,6 +74,7 @@ namespace CostFn
         double fn(double value, double target) override;
         double dx(double value, double target) override;
         double evaluate(const Math::Matrix &pred, const Math::Matrix &label) override;
+        Id id() const override;
     };
 
     // A.K.A. Log Loss for Multiclass Classification
@@ -58,6 +82,13 @@ namespace CostFn
     {
     public:
         double evaluate(const Math::Matrix &pred, const Math::Matrix &label) override;
+        double cost(const Math::Matrix &pred, const Math::Matrix &label) override;
         virtual Data transformLabels(const Data &data, const NeuralNetwork::Layer &outputLayer) override;
+        Id id() const override;
     };
+
+    /**
+     * Creates the cost function of an id
+     */
+    CostFn* Create(Id id);
 }
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Dataset.hpp"
+
+/**
+ * Describes how the columns of a csv file map onto a dataset
+ */
+struct CsvOptions
+{
+    /**
+     * Whether the first line holds column titles rather than data
+     */
+    bool hasHeader = true;
+
+    char delimiter = ',';
+
+    /**
+     * Columns read into the label of each instance, in order
+     */
+    std::vector<std::size_t> labelColumns = {0};
+
+    /**
+     * Columns read into the parameters of each instance, in order (empty for every column that is not a label)
+     */
+    std::vector<std::size_t> parameterColumns = {};
+
+    /**
+     * Parameters are normalized to `value * scale + offset`, labels are stored as is
+     */
+    double scale = 1;
+    double offset = 0;
+
+    /**
+     * Maximum number of rows to read (0 for every row)
+     */
+    std::size_t maxRows = 0;
+};
+
+/**
+ * Reads numeric csv files directly into a contiguous dataset
+ *
+ * The file is memory-mapped and split into newline-aligned chunks, which are counted and then parsed in parallel on a threadpool
+ */
+class CsvReader
+{
+public:
+    CsvReader(CsvOptions options = CsvOptions());
+
+    /**
+     * Reads a whole csv file
+     * @param pathname path to the csv file
+     * @returns a sequential dataset with one instance per row
+     */
+    Dataset Read(const std::string &pathname) const;
+
+    /**
+     * Reads csv text held in memory, in the same way as `Read`
+     */
+    Dataset Parse(const char *begin, const char *end) const;
+
+    /**
+     * Parses one row of the csv, must be called after the column layout is known (see `SetColumnCount`)
+     * @param cursor start of the row
+     * @param end end of the csv text
+     * @param parameters parameter list to write into
+     * @param labels label list to write into
+     * @returns start of the next row
+     */
+    const char *ParseRow(const char *cursor, const char *end, double *parameters, double *labels) const;
+
+    /**
+     * Sets the number of columns in each row, resolving which columns are read into parameters and labels
+     */
+    void SetColumnCount(std::size_t count);
+
+    /**
+     * Counts the columns of the row at the cursor
+     */
+    std::size_t CountColumns(const char *cursor, const char *end) const;
+
+    /**
+     * Skips the header row if the options specify one
+     * @returns start of the first data row
+     */
+    const char *SkipHeader(const char *begin, const char *end) const;
+
+    std::size_t parameterSize() const;
+    std::size_t labelSize() const;
+
+private:
+    CsvOptions options;
+
+    std::size_t columnCount;
+    std::vector<std::int32_t> parameterSlots;   // Parameter index each column is read into, or -1
+    std::vector<std::int32_t> labelSlots;       // Label index each column is read into, or -1
+    std::size_t parameterCount;
+};
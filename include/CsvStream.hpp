@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CsvReader.hpp"
+#include "Data.hpp"
+#include "DataStream.hpp"
+
+/**
+ * Streams the rows of a csv file through a fixed-size read buffer, so files larger than memory can be trained on
+ *
+ * Rows are parsed in the same way as `CsvReader`, the buffer only growing when a single row does not fit in it
+ */
+class CsvStream : public DataStream
+{
+public:
+    /**
+     * @param pathname path to the csv file
+     * @param options layout of the csv columns
+     * @param bufferSize size of the read buffer in bytes
+     */
+    CsvStream(const std::string &pathname, CsvOptions options = CsvOptions(), std::size_t bufferSize = 1 << 20);
+
+    std::size_t parameterSize() const override;
+    std::size_t labelSize() const override;
+
+    std::size_t Read(std::size_t count, Data &batch) override;
+    bool AtEnd() override;
+    void Reset() override;
+    std::unique_ptr<DataStream> Reopen() const override;
+
+private:
+    std::string pathname;
+    CsvOptions options;
+    CsvReader reader;
+
+    std::ifstream file;
+    std::vector<char> buffer;
+    std::size_t bufferStart;        // Start of the unread text in the buffer
+    std::size_t bufferEnd;          // End of the text read from the file
+    bool fileEnded;
+
+    std::size_t rowCount;           // Rows read since the last reset
+    std::vector<double> instances;  // Parsed rows of the current read, one instance after another
+
+    /**
+     * Ensures the line at the start of the unread text is wholly in the buffer, reading more of the file if needed
+     * @returns the end of the line, or nullptr when there is no text left
+     */
+    const char *NextLine();
+};
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "Matrix.hpp"
+#include "SparseMatrix.hpp"
 #include "Vector.hpp"
 
 struct Data
@@ -13,6 +14,12 @@ struct Data
     Math::Matrix parameters;
     Math::Matrix label;
 
+    /**
+     * Parameters in compressed sparse rows, one row per instance, used instead of `parameters` when `sparse` is set
+     */
+    Math::SparseMatrix sparseParameters;
+    bool sparse;
+
     /**
      * Size of parameter list
      */
@@ -31,7 +38,14 @@ struct Data
     Data(std::vector<double> p_parameters, double p_labels);
     Data(std::vector<double> p_parameters, std::vector<double> p_label);
     Data(Math::Matrix p_parameters, Math::Matrix p_labels);
-    Data(std::vector<Data> data);
+
+    /**
+     * Sparse data, `parameters` is left as a placeholder
+     * @param p_parameters one row of parameters per instance
+     * @param p_labels one column of labels per instance
+     */
+    Data(Math::SparseMatrix p_parameters, Math::Matrix p_labels);
+    Data(const std::vector<Data> &data);
         
     /**
      * Partitions data into a training and a testing set
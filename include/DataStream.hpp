@@ -0,0 +1,53 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+
+#include "Data.hpp"
+
+/**
+ * A source of data instances read front to back in chunks, so datasets larger than memory can be trained on
+ *
+ * Only the instances of the chunk being read have to be resident, the stream is rewound with `Reset` at the end of every epoch
+ */
+class DataStream
+{
+public:
+    virtual ~DataStream() = default;
+
+    virtual std::size_t parameterSize() const = 0;
+    virtual std::size_t labelSize() const = 0;
+
+    /**
+     * Reads the next instances into the columns of a batch
+     * @param count maximum number of instances to read
+     * @param batch batch to write into, resized to the number of instances read
+     * @returns the number of instances read, 0 only once the stream is at its end
+     */
+    virtual std::size_t Read(std::size_t count, Data &batch) = 0;
+
+    /**
+     * Whether every instance has been read
+     */
+    virtual bool AtEnd() = 0;
+
+    /**
+     * Rewinds the stream to its first instance
+     */
+    virtual void Reset() = 0;
+
+    /**
+     * Opens an independent stream over the same instances, so they can be evaluated while this stream is being trained on
+     *
+     * The reopened stream is not shuffled
+     */
+    virtual std::unique_ptr<DataStream> Reopen() const = 0;
+
+protected:
+    /**
+     * Copies sample-major instances into the columns of a batch, resizing it to hold them
+     * @param instances parameters then labels of each instance, one instance after another
+     * @param count number of instances
+     * @param batch batch to write into
+     */
+    void WriteBatch(const double *instances, std::size_t count, Data &batch) const;
+};
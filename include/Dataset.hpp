@@ -0,0 +1,233 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AlignedBuffer.hpp"
+#include "Data.hpp"
+#include "Matrix.hpp"
+
+/**
+ * A set of data instances stored in one contiguous, aligned, sample-major block
+ *
+ * Shuffling and partitioning only permute an index array, so copies and partitions of a dataset share the same storage.
+ * Parameters may be stored in a narrower type than double, and are converted and normalized as batches are gathered
+ */
+class Dataset
+{
+public:
+    using TrainTestPartition = std::pair<Dataset, Dataset>;
+
+    /**
+     * Type of the values held in storage
+     */
+    enum class DType : std::uint8_t
+    {
+        Float64 = 0,
+        UInt8 = 1,
+        UInt16 = 2
+    };
+
+    /**
+     * Allocates a zeroed dataset, to be filled through `Parameters` and `Labels`
+     * @param count number of instances
+     * @param parameterSize size of the parameter list of each instance
+     * @param labelSize size of the label list of each instance
+     * @param parameterType type parameters are stored in
+     * @param labelType type labels are stored in
+     */
+    Dataset(std::size_t count, std::size_t parameterSize, std::size_t labelSize = 1, DType parameterType = DType::Float64, DType labelType = DType::Float64);
+
+    /**
+     * Copies singular instances of data into a contiguous dataset
+     */
+    explicit Dataset(const std::vector<Data> &data);
+
+    /**
+     * Wraps existing sample-major storage without copying it
+     * @param owner keeps the storage alive for as long as any dataset uses it
+     * @param parameters start of the parameters of the first instance
+     * @param labels start of the labels of the first instance
+     * @param count number of instances
+     * @param parameterSize size of the parameter list of each instance
+     * @param labelSize size of the label list of each instance
+     * @param parameterType type of the stored parameters
+     * @param labelType type of the stored labels
+     * @param parameterStride distance in values between the parameters of consecutive instances (0 for `parameterSize`)
+     */
+    static Dataset Wrap(std::shared_ptr<const void> owner, const void *parameters, const void *labels, std::size_t count, std::size_t parameterSize, std::size_t labelSize, DType parameterType, DType labelType, std::size_t parameterStride = 0);
+
+    /**
+     * Number of instances in the dataset
+     */
+    std::size_t size() const;
+    std::size_t parameterSize() const;
+    std::size_t labelSize() const;
+    DType parameterType() const;
+    DType labelType() const;
+
+    /**
+     * Size of a stored value in bytes
+     */
+    static std::size_t SizeOf(DType type);
+
+    /**
+     * Parameters of the i-th instance, the dataset must store doubles
+     *
+     * Writable while the storage is not shared with other datasets, storage wrapped from a file mapping is read-only
+     */
+    double *Parameters(std::size_t i);
+    const double *Parameters(std::size_t i) const;
+
+    /**
+     * Label of the i-th instance, the dataset must store doubles
+     *
+     * Writable while the storage is not shared with other datasets, storage wrapped from a file mapping is read-only
+     */
+    double *Labels(std::size_t i);
+    const double *Labels(std::size_t i) const;
+
+    /**
+     * Stored parameters of the i-th instance, of type `parameterType()`
+     */
+    void *ParameterData(std::size_t i);
+    const void *ParameterData(std::size_t i) const;
+
+    /**
+     * Stored label of the i-th instance, of type `labelType()`
+     */
+    void *LabelData(std::size_t i);
+    const void *LabelData(std::size_t i) const;
+
+    /**
+     * Normalizes parameters to `value * scale + offset` as they are gathered into batches, leaving storage untouched
+     */
+    void SetNormalization(double scale, double offset = 0);
+
+    /**
+     * Normalizes each parameter to `value * scales[j] + offsets[j]` as they are gathered into batches, leaving storage untouched
+     * @param scales scale of each parameter
+     * @param offsets offset of each parameter
+     */
+    void SetNormalization(const std::vector<double> &scales, const std::vector<double> &offsets);
+
+    /**
+     * Stores the dataset in an integer type, with a per-parameter scale and offset spanning the range of each parameter
+     *
+     * Parameters are dequantized as batches are gathered, labels are kept in their current type
+     * @param type integer type to store parameters in
+     * @returns a sequential dataset holding the instances in this dataset's order
+     */
+    Dataset Quantize(DType type = DType::UInt8) const;
+
+    /**
+     * Shuffles the order of the instances
+     */
+    void Shuffle();
+
+    /**
+     * Partitions data into a training and a testing set, both sharing this dataset's storage
+     * @param trainingDataRatio the percentage of data meant for training examples
+     * @returns a training dataset and a testing dataset
+     */
+    TrainTestPartition Partition(double trainingDataRatio = 0.9) const;
+
+    /**
+     * Consecutive instances of the dataset, sharing its storage
+     */
+    Dataset Subset(std::size_t start, std::size_t count) const;
+
+    /**
+     * Gathers instances into the columns of a batch, converting and normalizing them to doubles
+     *
+     * Sparse batches receive one row of nonzero parameters per instance instead
+     * @param positions positions of the instances in the dataset
+     * @param count number of positions
+     * @param batch batch with `count` columns, or `count` rows of sparse parameters, to write into
+     */
+    void Gather(const std::uint32_t *positions, std::size_t count, Data &batch) const;
+
+    /**
+     * Copies consecutive instances into the columns of a batch
+     * @param start position of the first instance
+     * @param count number of instances
+     * @param batch batch with `count` columns to write into
+     */
+    void Batch(std::size_t start, std::size_t count, Data &batch) const;
+    Data Batch(std::size_t start, std::size_t count) const;
+
+    /**
+     * Copies the dataset into singular instances of data
+     */
+    std::vector<Data> ToVector() const;
+
+    /**
+     * Loads MNIST from data/MNIST, reading the IDX files when present and the csv files otherwise
+     * @param maxDataSize maximum number of instances read from each file (0 for every instance)
+     * @returns a training dataset and a testing dataset
+     */
+    static TrainTestPartition LoadMNIST(std::size_t maxDataSize = 10000);
+
+    /**
+     * Reads an MNIST csv file, with the label in the first column and pixels normalized to [0, 1]
+     * @param pathname path to the csv file
+     * @param maxDataSize maximum number of instances to read (0 for every instance)
+     */
+    static Dataset ReadMNISTFile(const std::string &pathname, std::size_t maxDataSize = 0);
+
+    /**
+     * Memory-maps a pair of unsigned byte IDX files, the storage of the dataset being the mappings themselves
+     * @param imagesPathname IDX file of the parameters, the first dimension indexing instances
+     * @param labelsPathname IDX file of the labels, with the same number of instances
+     * @returns a sequential dataset of unsigned bytes, without normalization
+     */
+    static Dataset ReadIDX(const std::string &imagesPathname, const std::string &labelsPathname);
+
+    /**
+     * Writes the dataset in instance order to a binary file, which `Load` maps without parsing
+     *
+     * The file holds a versioned header describing types, shape and normalization, followed by page-aligned sample-major blocks
+     * @param pathname path of the file to write
+     */
+    void Save(const std::string &pathname) const;
+
+    /**
+     * Memory-maps a binary dataset written by `Save`, the mapping directly backing the dataset's storage
+     *
+     * Processes loading the same file share its pages through the page cache
+     * @param pathname path of the file to map
+     */
+    static Dataset Load(const std::string &pathname);
+
+private:
+    Dataset() = default;
+
+    std::shared_ptr<const void> parameterStorage;
+    std::shared_ptr<const void> labelStorage;
+
+    const unsigned char *parameterData;
+    const unsigned char *labelData;
+    std::size_t parameterCount;
+    std::size_t labelCount;
+    DType parameterDType;
+    DType labelDType;
+    std::size_t parameterStride;            // In values, parameter rows of owned storage are padded so every instance starts aligned
+    std::size_t labelStride;
+    std::size_t storedCount;                // Number of instances in the storage, shared by every subset
+
+    double scale = 1;
+    double offset = 0;
+    std::vector<double> featureScales;      // Per-parameter normalization, replacing scale and offset when not empty
+    std::vector<double> featureOffsets;
+
+    std::vector<std::uint32_t> indices;     // Storage row of each instance, in dataset order
+
+    void Allocate(std::size_t count);
+
+    /**
+     * Gathers instances into the rows of the sparse parameters of a batch, and the columns of its labels
+     */
+    void GatherSparse(const std::uint32_t *positions, std::size_t count, Data &batch) const;
+};
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+
+#include "Data.hpp"
+#include "DataStream.hpp"
+#include "Dataset.hpp"
+
+/**
+ * Streams the instances of a dataset in its order
+ *
+ * Datasets loaded through `Dataset::Load` are memory-mapped, so streaming them only keeps the pages being read resident
+ */
+class DatasetStream : public DataStream
+{
+public:
+    /**
+     * @param data dataset to stream, its storage is shared rather than copied
+     */
+    DatasetStream(const Dataset &data);
+
+    std::size_t parameterSize() const override;
+    std::size_t labelSize() const override;
+
+    std::size_t Read(std::size_t count, Data &batch) override;
+    bool AtEnd() override;
+    void Reset() override;
+    std::unique_ptr<DataStream> Reopen() const override;
+
+private:
+    Dataset data;
+    std::size_t position;
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <tuple>
+#include <vector>
+
+#include "CostFn.hpp"
+#include "Data.hpp"
+#include "DataStream.hpp"
+#include "Layer.hpp"
+#include "Matrix.hpp"
+
+namespace NeuralNetwork
+{
+    /**
+     * Results of evaluating the model after an epoch of training
+     */
+    struct EvaluationResult
+    {
+        int epoch;
+        double accuracy;
+        double cost;
+
+        /**
+         * Whether a testing set was evaluated, the validation results are 0 otherwise
+         */
+        bool validated;
+        double validationAccuracy;
+        double validationCost;
+    };
+
+    /**
+     * A result of evaluation followed by learning rate schedules and early stopping
+     */
+    enum class Metric
+    {
+        Accuracy,
+        Cost,
+        ValidationAccuracy,
+        ValidationCost
+    };
+
+    /**
+     * @returns the value of a metric in the results of an epoch
+     */
+    double MetricValue(const EvaluationResult &results, Metric metric);
+
+    /**
+     * Whether a metric improves by increasing, as accuracy does, rather than by decreasing, as cost does
+     */
+    bool MetricIncreases(Metric metric);
+
+    /**
+     * Whether a metric needs a testing set
+     */
+    bool IsValidationMetric(Metric metric);
+
+    /**
+     * Follows the best value of a metric over the epochs of a training session
+     */
+    class MetricMonitor
+    {
+    public:
+        /**
+         * @param metric metric followed
+         * @param minDelta smallest change of the metric counted as an improvement
+         */
+        MetricMonitor(Metric metric, double minDelta = 0);
+
+        /**
+         * Records the results of an epoch
+         * @returns whether they improve on the best results so far, the first results always doing
+         */
+        bool Observe(const EvaluationResult &results);
+
+        /**
+         * Forgets every result, for a new training session
+         */
+        void Reset();
+
+        /**
+         * Number of epochs between the best results and the last results, 0 when the last were the best
+         */
+        int epochsSinceBest() const;
+
+        /**
+         * Epoch of the best results, -1 before any were observed
+         */
+        int bestEpoch() const;
+
+        /**
+         * Metric followed by the monitor
+         */
+        Metric followedMetric() const;
+
+    private:
+        Metric metric;
+        double minDelta;
+
+        double best = 0;
+        int bestAt = -1;
+        int latest = -1;
+    };
+
+    /**
+     * Evaluates a model in fixed-size chunks, running the forward pass through buffers allocated once per evaluator
+     *
+     * Memory use depends only on the chunk size and the layer sizes, not on the number of instances evaluated,
+     * and the layers themselves are only read, so their values are left as training set them
+     */
+    class Evaluator
+    {
+    public:
+        /**
+         * @param layers layers of the model, must outlive the evaluator
+         * @param costFn cost function of the model
+         * @param chunkSize number of instances evaluated at once, small enough for a chunk of every layer to stay in cache
+         */
+        Evaluator(const std::vector<Layer> &layers, CostFn::CostFn &costFn, std::size_t chunkSize = 128);
+
+        /**
+         * Evaluates the model on every instance of a stream
+         * @param data stream to evaluate, rewound before reading
+         * @return a tuple describing accuracy and cost, averaged over every instance
+         */
+        std::tuple<double, double> Evaluate(DataStream &data);
+
+    private:
+        const std::vector<Layer> &layers;
+        CostFn::CostFn &costFn;
+        std::size_t chunkSize;
+
+        Data chunk;
+        std::vector<Math::Matrix> outputs;      // Activated output of each layer for the current chunk
+        std::vector<Math::Matrix> factorOutputs;    // Inputs multiplied by the second factor of each factorized layer
+
+        /**
+         * Runs the forward pass on the current chunk, leaving the prediction in the output of the last layer
+         */
+        void Forward();
+    };
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "AlignedBuffer.hpp"
+#include "Layer.hpp"
+
+namespace NeuralNetwork
+{
+    /**
+     * An immutable, single precision copy of a trained model, only able to predict
+     *
+     * Weights are packed into blocks of rows interleaved by input, so the kernel streams them with unit stride
+     * while broadcasting inputs, and bias and activation are applied in the same pass that writes each output.
+     * Predictions run through preallocated ping-pong buffers, taken from a pool so many threads can predict at once.
+     * Layers mostly zeroed by pruning are stored in compressed sparse rows instead, and only their nonzero weights are multiplied.
+     * Factorized layers are stored as two packed layers, one per factor
+     */
+    class InferenceModel
+    {
+    public:
+        /**
+         * Number of rows in a packed weight block, matching the width of a SIMD register of floats
+         */
+        static const std::size_t ROW_BLOCK = 8;
+
+        /**
+         * Fraction of nonzero weights below which the sparse kernels outperform the dense ones for single instances as well as batches
+         *
+         * Measured by bench/SparseSpeedup.cpp, batches alone break even at about 0.65, as single instances gather their inputs one at a time
+         */
+        static constexpr double DEFAULT_SPARSE_DENSITY = 0.1;
+
+        /**
+         * @param layers layers of a trained model, the input layer first
+         * @param maxBatchSize number of instances each buffer holds, larger predictions are run in batches of this size
+         * @param maxSparseDensity layers with at most this fraction of nonzero weights are stored as sparse matrices, 0 to keep every layer dense
+         */
+        InferenceModel(const std::vector<Layer> &layers, std::size_t maxBatchSize = 64, double maxSparseDensity = DEFAULT_SPARSE_DENSITY);
+
+        /**
+         * Predicts the outputs of instances, safe to call from many threads at once
+         * @param input parameters of each instance, one instance after another
+         * @param count number of instances
+         * @param output written with the output of each instance, one instance after another
+         */
+        void Predict(const float *input, std::size_t count, float *output) const;
+
+        /**
+         * Predicts the output of a single instance through a latency-optimized matrix-vector path, safe to call from many threads at once
+         *
+         * Activations are kept in a buffer owned by the calling thread, so after the first call on a thread nothing is allocated or locked
+         * @param input parameters of the instance
+         * @param output written with the output of the instance
+         */
+        void Predict(const float *input, float *output) const;
+
+        std::size_t inputSize() const;
+        std::size_t outputSize() const;
+        std::size_t maxBatchSize() const;
+
+        /**
+         * @returns number of layers stored as sparse matrices
+         */
+        std::size_t sparseLayerCount() const;
+
+    private:
+        struct PackedLayer
+        {
+            std::size_t inputCount;
+            std::size_t outputCount;
+            std::size_t paddedOutputCount;          // Rounded up to a whole number of row blocks
+            ActivationFn::Id activation;
+            std::unique_ptr<AlignedBuffer> weights; // Per row block, ROW_BLOCK weights of every input in turn, or the nonzero weights of each row when sparse
+            std::unique_ptr<AlignedBuffer> bias;
+
+            bool sparse;
+            std::unique_ptr<AlignedBuffer> rowOffsets;  // When sparse, the index of the first nonzero weight of each padded row, and the number of nonzero weights
+            std::unique_ptr<AlignedBuffer> columns;     // When sparse, the input of each nonzero weight
+        };
+
+        /**
+         * Ping-pong activation buffers, each holding the widest layer for a whole batch,
+         * and the inputs of sparse layers regrouped so the instances of each input are consecutive
+         */
+        struct Workspace
+        {
+            AlignedBuffer front;
+            AlignedBuffer back;
+            AlignedBuffer transposed;
+
+            Workspace(std::size_t size, std::size_t transposedSize);
+        };
+
+        /**
+         * Workspaces not in use, grown when more threads predict at once than there are workspaces
+         */
+        struct WorkspacePool
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<Workspace>> available;
+        };
+
+        std::vector<PackedLayer> layers;
+        std::size_t inputCount;
+        std::size_t batchSize;
+        std::size_t workspaceSize;                  // In bytes, for each of the two buffers
+        std::size_t transposedSize;                 // In bytes, for the inputs of sparse layers
+
+        std::unique_ptr<WorkspacePool> workspaces;
+
+        /**
+         * Converts the weights and bias of a layer to single precision, packed into row blocks or compressed sparse rows
+         * @param source row-major weights, one row per output
+         * @param biasSource bias of each output, or nullptr for none
+         * @param maxSparseDensity the layer is stored as a sparse matrix when at most this fraction of its weights are nonzero
+         */
+        static PackedLayer Pack(const double *source, const double *biasSource, std::size_t outputCount, std::size_t inputCount, ActivationFn::Id activation, double maxSparseDensity);
+
+        /**
+         * Runs a batch of at most `batchSize` instances through every layer
+         */
+        void PredictBatch(const float *input, std::size_t count, float *output, Workspace &workspace) const;
+    };
+}
@@ -2,8 +2,13 @@
 #include <vector>
 
 #include "ActivationFn.hpp"
+#include "LowRank.hpp"
 #include "Matrix.hpp"
+#include "MixedPrecision.hpp"
 #include "Neuron.hpp"
+#include "Optimizer.hpp"
+#include "Pruning.hpp"
+#include "SparseMatrix.hpp"
 #include "Vector.hpp"
 
 namespace NeuralNetwork
@@ -11,6 +16,11 @@ namespace NeuralNetwork
     struct Layer
     {
     public:
+        /**
+         * Number of optimizer slots used by a layer, for its weights or first factor, its second factor and its bias
+         */
+        static const std::size_t OPTIMIZER_SLOTS = 3;
+
         std::size_t neuronCount;
         std::size_t connectionCount;
 
@@ -18,20 +28,160 @@ namespace NeuralNetwork
         Math::Vector biasVector;
         Math::Matrix valueMatrix;
 
+        /**
+         * 1 for each weight kept by pruning and 0 for each weight removed, only meaningful once `pruned` is set
+         */
+        Math::Matrix pruningMask;
+        bool pruned;
+
+        /**
+         * Rank of the weights when factorized, 0 when they are stored whole in `weightMatrix`
+         *
+         * A factorized layer stores its weights as `factorU * factorV` instead, multiplying its inputs by each factor in turn,
+         * and `weightMatrix` is left empty
+         */
+        std::size_t rank;
+        Math::Matrix factorU;           // neuronCount x rank
+        Math::Matrix factorV;           // rank x connectionCount
+        Math::Matrix factorValues;      // `factorV` times the inputs of the last calculation, kept for adjusting `factorU`
+
+        /**
+         * Precision of the products of training, set by `SetPrecision`
+         *
+         * Dense layers training in lower precision keep a single precision copy of their weights, refreshed after every update
+         */
+        Precision precision;
+        std::vector<float> lowPrecisionWeights;
+
         ActivationFn::ActivationFn* activationFn;
 
         Layer();
         Layer(std::size_t count);
         Layer(std::size_t count, ActivationFn::ActivationFn* fn);
 
+        /**
+         * A layer whose weights are trained directly as the product of two factors of the given rank
+         * @param rank rank of the weights, at most the smaller of the layer's size and the size of the previous layer
+         */
+        Layer(std::size_t count, ActivationFn::ActivationFn* fn, std::size_t rank);
+
         ~Layer();
         Layer(const Layer &p_layer);
+        Layer &operator=(const Layer &p_layer);
 
         void InitializeConnections(std::size_t count);
         Neuron Neurons(unsigned int i);
 
         Math::Matrix Output();
         Math::Matrix CalculateValues(Math::Matrix input);
+
+        /**
+         * Calculates the layer values from sparse inputs, in time proportional to their nonzero values
+         * @param input one row of inputs per instance
+         */
+        Math::Matrix CalculateValues(const Math::SparseMatrix &input);
+
+        /**
+         * Weights of the layer, multiplied out when factorized
+         */
+        Math::Matrix Weights() const;
+
+        /**
+         * Propagates adjustments to the values of the layer back to its inputs
+         * @param adjustmentMatrix one column of adjustments to the values of the layer per instance
+         * @returns `transpose(weights) * adjustmentMatrix`, through each factor in turn when factorized
+         */
+        Math::Matrix CalculateInputDerivatives(const Math::Matrix &adjustmentMatrix);
+
+        /**
+         * Calculates the gradient of the cost with respect to each weight
+         * @param adjustmentMatrix one column of adjustments to the values of the layer per instance
+         * @param input inputs the values were calculated from, one column per instance
+         * @returns `adjustmentMatrix * transpose(input)`
+         */
+        Math::Matrix CalculateWeightDerivatives(const Math::Matrix &adjustmentMatrix, Math::Matrix input);
+
+        /**
+         * Sets the precision of the products of training, the weights themselves staying in double
+         *
+         * Factorized layers and sparse inputs are always computed in double
+         */
+        void SetPrecision(Precision p_precision);
+
+        /**
+         * Whether the dense products of the layer run in lower precision
+         */
+        bool lowPrecision() const;
+
         void AdjustNeurons(Math::Matrix weightShiftMatrix, Math::Vector biasShiftVector, double mult = 1);
+
+        /**
+         * Adjusts the weights by the product of the layer's adjustments and its sparse inputs, without forming the weight shift matrix
+         *
+         * Only the weights of inputs nonzero in some instance are touched
+         * @param adjustmentMatrix one column of adjustments to the values of the layer per instance
+         * @param input one row of inputs per instance
+         */
+        void AdjustNeurons(const Math::Matrix &adjustmentMatrix, const Math::SparseMatrix &input, Math::Vector biasShiftVector, double mult = 1);
+
+        /**
+         * Adjusts the factors of a factorized layer by the gradients of each, given the adjustments to the values of the layer
+         *
+         * Uses `factorValues`, so the layer's values must have been calculated from the same inputs
+         * @param adjustmentMatrix one column of adjustments to the values of the layer per instance
+         * @param input inputs the values were calculated from, one column per instance
+         */
+        void AdjustFactors(const Math::Matrix &adjustmentMatrix, Math::Matrix input, Math::Vector biasShiftVector, double mult = 1);
+
+        /**
+         * Adjusts the factors of a factorized layer from sparse inputs, `factorV` only where the inputs are nonzero
+         * @param adjustmentMatrix one column of adjustments to the values of the layer per instance
+         * @param input one row of inputs per instance
+         */
+        void AdjustFactors(const Math::Matrix &adjustmentMatrix, const Math::SparseMatrix &input, Math::Vector biasShiftVector, double mult = 1);
+
+        /**
+         * Updates the weights and bias in place through an optimizer, from the gradients of the cost
+         * @param slot first of the `OPTIMIZER_SLOTS` optimizer slots of the layer
+         * @param weightGradients gradient of the cost with respect to each weight
+         * @param biasGradients gradient of the cost with respect to each bias
+         */
+        void Optimize(Optimizer::Optimizer &optimizer, std::size_t slot, const Math::Matrix &weightGradients, const Math::Vector &biasGradients, double learningRate);
+
+        /**
+         * Updates the parameters in place through an optimizer, from the adjustments to the values of the layer and the inputs they were calculated from
+         *
+         * Factorized layers form the gradients of each factor, and must have calculated their values from the same inputs
+         * @param slot first of the `OPTIMIZER_SLOTS` optimizer slots of the layer
+         * @param adjustmentMatrix one column of adjustments to the values of the layer per instance
+         * @param input inputs the values were calculated from, one column per instance
+         * @param biasGradients gradient of the cost with respect to each bias
+         */
+        void Optimize(Optimizer::Optimizer &optimizer, std::size_t slot, const Math::Matrix &adjustmentMatrix, Math::Matrix input, const Math::Vector &biasGradients, double learningRate);
+
+        /**
+         * Updates the parameters in place through an optimizer, from the adjustments to the values of the layer and sparse inputs
+         *
+         * Plain gradient descent only touches the weights of nonzero inputs. Stateful optimizers move every weight, so the gradients are formed whole
+         * @param input one row of inputs per instance
+         */
+        void Optimize(Optimizer::Optimizer &optimizer, std::size_t slot, const Math::Matrix &adjustmentMatrix, const Math::SparseMatrix &input, const Math::Vector &biasGradients, double learningRate);
+
+        /**
+         * Replaces the weights by the product of two factors of the given rank, from their truncated singular value decomposition
+         *
+         * The factorized layer keeps training through its factors. Pruning is lost, as the factors are dense
+         * @param rank rank of the weights, at most the smaller dimension of the weights
+         * @returns the factors, along with every singular value of the weights
+         */
+        LowRankFactors Factorize(std::size_t rank);
+
+        /**
+         * Zeroes the weights removed by pruning, and keeps them at zero through later adjustments so the layer can be fine-tuned
+         *
+         * Pruning a layer again only removes more weights, factorized layers cannot be pruned
+         * @param options pattern and amount of pruning
+         */
+        void Prune(const PruningOptions &options);
     };
 }
\ No newline at end of file
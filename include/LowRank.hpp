@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Matrix.hpp"
+
+namespace NeuralNetwork
+{
+    /**
+     * A matrix approximated by the product of two thinner matrices, `u * v`
+     */
+    struct LowRankFactors
+    {
+        Math::Matrix u;                         // rows x rank
+        Math::Matrix v;                         // rank x cols
+        std::vector<double> singularValues;     // Every singular value of the matrix, largest first
+    };
+
+    /**
+     * Approximates a matrix by the product of two factors of a given rank, keeping its largest singular values
+     *
+     * The singular value decomposition is computed with one-sided Jacobi rotations of the rows, accurate even for small singular values.
+     * Each singular value is split evenly between the factors, so neither factor dominates the scale of the other while training
+     * @param matrix matrix to approximate, such as the weights of a layer
+     * @param rank number of singular values kept, at most the smaller dimension of the matrix
+     * @returns the factors, whose product is the closest matrix of that rank in the Frobenius norm
+     */
+    LowRankFactors TruncatedSVD(const Math::Matrix &matrix, std::size_t rank);
+}
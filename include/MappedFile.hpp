@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+/**
+ * A read-only memory mapping of a whole file
+ *
+ * Pages are loaded on first access and shared through the page cache with every other process mapping the same file
+ */
+class MappedFile
+{
+public:
+    MappedFile(const std::string &pathname);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const;
+    std::size_t size() const;
+
+    /**
+     * Hints that the mapping will be read front to back, so the kernel reads ahead aggressively
+     */
+    void AdviseSequential() const;
+
+    /**
+     * Whether integers and doubles are stored little-endian, as the files written to be mapped store them
+     */
+    static bool IsLittleEndian();
+
+    /**
+     * Writes zeros up to the next multiple of an alignment, so what is written next is aligned once the file is mapped
+     */
+    static void WritePadding(std::ostream &file, std::size_t alignment);
+
+private:
+    const char *mapping;
+    std::size_t mappingSize;
+
+#ifdef _WIN32
+    void *fileHandle;
+    void *mappingHandle;
+#endif
+};
@@ -2,26 +2,81 @@
 #include <cmath>
 #include <vector>
 
-#include "ThreadPool.hpp"
+#include "Threadpool.hpp"
 
 namespace Math
 {
     struct Vector;
 
+    /**
+     * Allocates the values of a matrix, counting the allocation when the library is built with `NN_PROFILE`
+     * @param bytes size of the allocation in bytes
+     */
+    void *AllocateStorage(std::size_t bytes);
+
+    /**
+     * Frees values allocated by `AllocateStorage`
+     * @param bytes size the values were allocated with
+     */
+    void FreeStorage(void *pointer, std::size_t bytes);
+
+    /**
+     * Allocator of matrix values, every matrix allocation going through `AllocateStorage`
+     */
+    template <typename T>
+    struct StorageAllocator
+    {
+        using value_type = T;
+
+        StorageAllocator() = default;
+
+        template <typename U>
+        StorageAllocator(const StorageAllocator<U> &) {}
+
+        T *allocate(std::size_t count)
+        {
+            return static_cast<T *>(AllocateStorage(count * sizeof(T)));
+        }
+
+        void deallocate(T *pointer, std::size_t count)
+        {
+            FreeStorage(pointer, count * sizeof(T));
+        }
+    };
+
+    template <typename T, typename U>
+    bool operator==(const StorageAllocator<T> &, const StorageAllocator<U> &)
+    {
+        return true;
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const StorageAllocator<T> &, const StorageAllocator<U> &)
+    {
+        return false;
+    }
+
     struct Matrix
     {
     protected:
-        std::vector<double> values;
+        using Storage = std::vector<double, StorageAllocator<double>>;
+
+        Storage values;
         static ThreadPool threadPool;
 
+    public:
         /**
-         * Uses threadpool to optimize matrix calculations
+         * Uses threadpool to optimize matrix calculations, and any other work split in independent rows
+         *
+         * Its tasks never wait on anything, so it is shared by every caller, including tasks of other pools
          * @param fn fn(start, end): where start and end are row numbers of the matrix
          * @param total number of row calculations required
+         * @param bytesPerRow bytes touched per row, so the region of each task is placed on the roofline
+         * @param flopsPerRow floating point operations per row
+         * @param granularity every chunk but the last starts and ends on a multiple of it
          */
-        static void UseThreadPool(std::function<void(unsigned int start, unsigned int end)> fn, int total);
+        static void UseThreadPool(std::function<void(unsigned int start, unsigned int end)> fn, int total, double bytesPerRow = 0, double flopsPerRow = 0, int granularity = 1);
 
-    public:
         using matrix = std::vector<std::vector<double>>;
         std::size_t rows;
         std::size_t cols;
@@ -68,6 +123,19 @@ namespace Math
         double at(std::size_t row, std::size_t col) const;
         double &at(std::size_t row, std::size_t col);
 
+        /**
+         * Pointer to the row-major values of the matrix
+         */
+        double *data();
+        const double *data() const;
+
+        /**
+         * Changes the dimensions of the matrix, reusing its allocated memory when it is large enough
+         * 
+         * Values are unspecified after resizing
+         */
+        void Resize(std::size_t p_rows, std::size_t p_cols);
+
         operator std::vector<double>() const;
         operator double() const;
 
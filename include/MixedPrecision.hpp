@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+
+namespace NeuralNetwork
+{
+    /**
+     * Precision of the matrix products of training, the parameters themselves always being kept and updated in double
+     */
+    enum class Precision
+    {
+        Double,
+        Float,      // Single precision operands and sums
+        BFloat16    // Operands rounded to bfloat16, 8 bits of mantissa, with single precision sums
+    };
+
+    /**
+     * Describes how the model is trained in mixed precision
+     *
+     * The products of the forward and backward passes of dense layers run on single precision copies of the weights and activations,
+     * while the optimizer updates master weights kept in double, so small updates still accumulate over thousands of epochs.
+     * Factorized layers, and first layers trained from sparse batches, stay in double
+     */
+    struct MixedPrecisionOptions
+    {
+        Precision precision = Precision::Double;
+
+        /**
+         * Multiplies the cost before backpropagation, and divides the gradients by it again before updating, so small gradients
+         * are not flushed to zero by the lower precision
+         */
+        double lossScale = 1;
+
+        /**
+         * Halves the loss scale whenever the gradients of any layer overflow, skipping the update of every layer for that step,
+         * and doubles it again after `lossScaleInterval` steps without overflowing
+         */
+        bool dynamicLossScale = false;
+        std::size_t lossScaleInterval = 2000;
+    };
+
+    /**
+     * Converts a row-major matrix to single precision for low precision products
+     * @param precision `BFloat16` rounds the values to the nearest bfloat16, `Float` to the nearest float
+     * @param transpose writes the transpose of the matrix, cols x rows
+     */
+    void ToLowPrecision(const double *source, std::size_t rows, std::size_t cols, Precision precision, bool transpose, float *destination);
+
+    /**
+     * Computes `output = a * b + bias` with single precision products and sums, writing the results in double
+     *
+     * The left matrix is read through strides, so it can be read transposed without copying it
+     * @param a rows x inner matrix, whose element (i, k) is at `a[i * aRowStride + k * aColStride]`
+     * @param b row-major inner x cols matrix
+     * @param bias bias of each row of the output, or nullptr for none
+     * @param output row-major rows x cols matrix
+     */
+    void LowPrecisionProduct(const float *a, std::size_t aRowStride, std::size_t aColStride, const float *b, std::size_t rows, std::size_t inner, std::size_t cols, const double *bias, double *output);
+}
@@ -1,15 +1,75 @@
 #pragma once
+#include <functional>
+#include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "BatchLoader.hpp"
 #include "CostFn.hpp"
 #include "Data.hpp"
+#include "DataStream.hpp"
+#include "Dataset.hpp"
+#include "Evaluator.hpp"
+#include "InferenceModel.hpp"
 #include "Layer.hpp"
+#include "LowRank.hpp"
 #include "Matrix.hpp"
+#include "MixedPrecision.hpp"
+#include "Optimizer.hpp"
+#include "Pruning.hpp"
+#include "QuantizedModel.hpp"
+#include "Schedule.hpp"
+#include "SparseMatrix.hpp"
+#include "Threadpool.hpp"
 
 namespace NeuralNetwork
 {
+    /**
+     * Describes how the model is evaluated after every epoch of training
+     */
+    struct EvaluationOptions
+    {
+        /**
+         * Evaluates a snapshot of the weights on a lower-priority thread while the next epoch trains
+         */
+        bool asynchronous = false;
+
+        /**
+         * Evaluates a fixed random sample of this many training instances instead of the whole training set (0 for every instance)
+         */
+        std::size_t trainingSampleSize = 0;
+
+        /**
+         * Receives the results of every epoch, called on the evaluation thread when asynchronous (empty to print the results)
+         */
+        std::function<void(const EvaluationResult &)> callback;
+    };
+
+    /**
+     * Describes when training stops before its last epoch, once a metric has stopped improving
+     */
+    struct EarlyStoppingOptions
+    {
+        bool enabled = false;
+        Metric metric = Metric::ValidationCost;
+
+        /**
+         * Number of epochs without improvement after which training stops
+         */
+        int patience = 10;
+
+        /**
+         * Smallest change of the metric counted as an improvement
+         */
+        double minDelta = 0;
+
+        /**
+         * Restores the weights of the best epoch once training ends, whether it stopped early or not
+         */
+        bool restoreBestWeights = true;
+    };
+
     class MultilayerPerceptron
     {
     public:
@@ -19,43 +79,181 @@ namespace NeuralNetwork
 
         void AddLayer(Layer layer);
         void SetCostFunction(CostFn::CostFn* costFn);
+        void SetEvaluationOptions(EvaluationOptions options);
+
+        /**
+         * Sets the optimizer updating the parameters while training, plain gradient descent by default
+         *
+         * The model takes ownership of the optimizer. Its state is kept between calls to `Train`, and saved in checkpoints
+         */
+        void SetOptimizer(Optimizer::Optimizer *optimizer);
+
+        /**
+         * Sets the schedule choosing the learning rate of every epoch from the learning rate passed to `Train`, constant by default
+         *
+         * The model takes ownership of the schedule
+         */
+        void SetLearningRateSchedule(Schedule::Schedule *schedule);
+
+        /**
+         * Stops training once a metric has not improved for a number of epochs, disabled by default
+         *
+         * With asynchronous evaluation the results of an epoch arrive once the next epoch has trained, so training stops an epoch later
+         */
+        void SetEarlyStopping(EarlyStoppingOptions options);
+
+        /**
+         * Trains the dense layers with lower precision products and double master weights, in double by default
+         * @param options precision of the products and scaling of the cost
+         */
+        void SetMixedPrecision(MixedPrecisionOptions options);
+
+        /**
+         * Number of layers, including the input layer
+         */
+        std::size_t layerCount() const;
+
+        /**
+         * Gathers the training batches of datasets as sparse parameters, so the first layer is trained in time proportional to their nonzero values
+         *
+         * Worthwhile when most parameters are zero once normalized, such as one-hot or bag-of-words features. Streams are always trained dense
+         */
+        void SetSparseBatches(bool sparse);
         
         /**
          * Trains the model on a set of data
          * @param trainingSet a vector of singular instances of data used to train the model
          * @param testingSet a vector of singular instances of data used to test the model
          * @param epochs number of epochs for gradient descent
-         * @param learningRate learning rate for gradient descent and backpropagation in this training session
+         * @param learningRate learning rate for gradient descent and backpropagation in this training session, scaled every epoch by the learning rate schedule
+         * @param batchSize the size of each training batch
+         * @param prefetchCount number of batches prepared on a background thread ahead of the one being trained on
+         */
+        void Train(std::vector<Data> &trainingSet, std::vector<Data> &testingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 0, int prefetchCount = 4);
+        void Train(std::vector<Data> &trainingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 0, int prefetchCount = 4);
+
+        /**
+         * Trains the model on a contiguous dataset
+         * @param trainingSet dataset used to train the model
+         * @param testingSet dataset used to test the model
+         * @param epochs number of epochs for gradient descent
+         * @param learningRate learning rate for gradient descent and backpropagation in this training session, scaled every epoch by the learning rate schedule
          * @param batchSize the size of each training batch
-         * @returns a matrix describing the derivative each neuron value in the previous layer relative to the cost
+         * @param prefetchCount number of batches prepared on a background thread ahead of the one being trained on
+         */
+        void Train(const Dataset &trainingSet, const Dataset &testingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 0, int prefetchCount = 4);
+        void Train(const Dataset &trainingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 0, int prefetchCount = 4);
+
+        /**
+         * Trains the model on streams of data, so neither set has to fit in memory
+         *
+         * The training set is read in its order every epoch, wrap it in a `ShuffleBuffer` to shuffle it.
+         * It is evaluated through a reopened stream, since the training stream is being read by the batch loader
+         * @param trainingSet stream used to train the model
+         * @param testingSet stream used to test the model
+         * @param epochs number of epochs for gradient descent
+         * @param learningRate learning rate for gradient descent and backpropagation in this training session, scaled every epoch by the learning rate schedule
+         * @param batchSize the size of each training batch, must be positive
+         * @param prefetchCount number of batches prepared on a background thread ahead of the one being trained on
          */
-        void Train(std::vector<Data> &trainingSet, std::vector<Data> &testingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 0);
-        void Train(std::vector<Data> &trainingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 0);
+        void Train(DataStream &trainingSet, DataStream &testingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 32, int prefetchCount = 4);
+        void Train(DataStream &trainingSet, int epochs = 20, double learningRate = 0.01, int batchSize = 32, int prefetchCount = 4);
+
+        /**
+         * Writes the layer sizes, activation functions, cost function, weights and biases to a binary checkpoint
+         *
+         * The file holds a versioned header and a table of sections, the weights and biases being 64 byte aligned within a page-aligned section.
+         * Sections unknown to a reader are skipped. The state of the optimizer is stored alongside the parameters for resuming training
+         * @param pathname path of the file to write
+         */
+        void Save(const std::string &pathname) const;
+
+        /**
+         * Replaces the layers and cost function of the model with those of a checkpoint written by `Save`
+         *
+         * The file is memory-mapped and its parameters copied straight into the layers, without parsing.
+         * Optimizer state is restored when it was saved by an optimizer of the same type as the model's, so set the optimizer first
+         * @param pathname path of the file to read
+         */
+        void Load(const std::string &pathname);
+
+        /**
+         * Prunes the weights of every layer, keeping the removed weights at zero while training further to fine-tune the model
+         *
+         * Checkpoints store the zeroed weights but not which were removed, so a loaded model is pruned again before fine-tuning
+         * @param options pattern and amount of pruning
+         */
+        void Prune(const PruningOptions &options);
+
+        /**
+         * Replaces the weights of a layer by the product of two factors of the given rank, keeping their largest singular values
+         *
+         * The layer then runs as two smaller products, and keeps training through its factors. Layers can also be trained factorized
+         * from the start, by adding them with a rank
+         * @param layer index of the layer, 1 for the first layer after the input layer
+         * @param rank rank of the weights, at most the smaller dimension of the weights
+         * @returns the factors, along with every singular value of the weights to judge how much of them the rank keeps
+         */
+        LowRankFactors Factorize(std::size_t layer, std::size_t rank);
+
+        /**
+         * Compiles the trained model into an immutable inference model, which only predicts
+         * @param maxBatchSize number of instances the inference model's buffers hold at once
+         * @param maxSparseDensity layers with at most this fraction of nonzero weights are stored and multiplied as sparse matrices
+         */
+        InferenceModel Compile(std::size_t maxBatchSize = 64, double maxSparseDensity = InferenceModel::DEFAULT_SPARSE_DENSITY) const;
+
+        /**
+         * Quantizes the trained model into an immutable model with 8 bit weights and activations, which only predicts
+         * @param calibrationSet stream sampled for the range of the activations of every layer, normally part of the training set
+         * @param calibrationSize number of instances sampled from the stream
+         * @param maxBatchSize number of instances the quantized model's buffers hold at once
+         */
+        QuantizedModel Quantize(DataStream &calibrationSet, std::size_t calibrationSize = 1024, std::size_t maxBatchSize = 64) const;
 
     private:
         std::vector<Layer> layers;
         CostFn::CostFn* costFn;
+        Optimizer::Optimizer *optimizer;
+        Schedule::Schedule *schedule;
+        EvaluationOptions evaluationOptions;
+        EarlyStoppingOptions earlyStopping;
+        MixedPrecisionOptions mixedPrecision;
+        double lossScale = 1;                   // Current loss scale, changed by dynamic loss scaling
+        std::size_t stepsSinceOverflow = 0;
+        bool sparseBatches = false;
+        const Math::SparseMatrix *sparseInput = nullptr;   // Sparse parameters of the loaded batch, in place of the values of the input layer
+
+        /**
+         * Trains the model, shared by every overload of `Train`
+         * @param loader loader preparing the training batches
+         * @param trainingSet stream of the training set, evaluated after every epoch
+         * @param testingSet stream used to test the model, or nullptr
+         * @param learningRate base learning rate of the schedule
+         */
+        void RunTraining(BatchLoader &loader, DataStream &trainingSet, DataStream *testingSet, int epochs, double learningRate);
 
         /**
          * Loads an instance of data into the first layer of the matrix
+         *
+         * Sparse batches are kept aside for the first hidden layer, and must outlive the run of the model
          * @param input an instance of data, can be multiple columns of different instances
          */
         void LoadDataInstance(Data &input);
 
         /**
-         * Partitions training data into batches
-         * @param data a vector of singular instances of data
-         * @param batchSize the size of each training batch (0 for no batching)
-         * @returns a vector of batched training examples
+         * Evaluates the model on a stream, one chunk at a time so memory use does not depend on the size of the stream
+         * @param data stream to evaluate, rewound before reading
+         * @return a tuple describing accuracy and cost, averaged over every instance
          */
-        std::vector<Data> BatchData(std::vector<Data> &data, int batchSize = 0);
+        std::tuple<double, double> TestData(DataStream &data);
 
         /**
-         * Takes a vector of data values and uses it to evaluate the model
-         * @param data a vector of singular instances of data
-         * @return a tuple describing accuracy and cost
+         * Evaluates a set of layers on the training and testing sets, reporting the results through the evaluation callback
+         * @param snapshot layers to evaluate, either the model's own or a copy taken for asynchronous evaluation
+         * @returns the results of the epoch
          */
-        std::tuple<double, double> TestData(Data &data);
+        EvaluationResult Evaluate(const std::vector<Layer> &snapshot, int epoch, DataStream &trainingSet, DataStream *testingSet);
 
         /**
          * Calculates the layer values with data loaded into the first layer
@@ -65,20 +263,17 @@ namespace NeuralNetwork
         void RunModel();
 
         /**
-         * Does gradient descent on single batch of data, updates the parameters of the output layer
+         * Does gradient descent on single batch of data, updating the parameters of every layer
+         *
+         * The backward pass runs as a task graph, so the update of a layer overlaps with propagating gradients to the layers before it
          * @param batch an instance of data, can be multiple columns of different instances
          * @param learningRate learning rate for this particular instance of gradient descent
-         * @returns a matrix describing the derivative each neuron value in the previous layer relative to the cost
          */
-        Math::Matrix GradientDescent(Data &batch, double learningRate);
+        void GradientDescent(Data &batch, double learningRate);
 
         /**
-         * Does gradient descent on single batch of data, updates the parameters of the output layer
-         * @param changes a matrix describing the derivative each neuron value in the current layer relative to the cost
-         * @param layerIndex a the index of the layer to perform backpropagation on
-         * @param learningRate learning rate for this particular instance of backpropagation
-         * @returns a matrix describing the derivative each neuron value in the previous layer relative to the cost
+         * Threadpool running the backward pass task graph, separate from the matrix threadpool its tasks wait on
          */
-        Math::Matrix Backpropagate(Math::Matrix &changes, std::size_t layerIndex, double learningRate);
+        static ThreadPool backpropagationPool;
     };
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "AlignedBuffer.hpp"
+
+namespace Optimizer
+{
+    /**
+     * Identifies an optimizer in saved optimizer state, values must stay stable across versions
+     */
+    enum class Id : std::uint8_t
+    {
+        SGD = 0,
+        Momentum = 1,
+        Nesterov = 2,
+        Adam = 3,
+        AdamW = 4
+    };
+
+    /**
+     * Updates parameters in place from the gradients of the cost
+     *
+     * Every update is a single fused pass over a block of parameters, vectorized and split across a threadpool when the block is large.
+     * Blocks are identified by a slot chosen by the caller, their moments kept in aligned buffers allocated on the first update of the slot,
+     * and reused until the size of the block changes. Updates of different slots may run at once
+     */
+    class Optimizer
+    {
+    public:
+        virtual ~Optimizer();
+
+        /**
+         * Updates a block of parameters, `parameters -= learningRate * step(gradients)`
+         * @param slot identifies the state of the block
+         * @param parameters parameters to update
+         * @param gradients gradient of the cost with respect to each parameter
+         * @param count number of parameters in the block
+         * @param learningRate learning rate of this update
+         * @param mask when given, parameters where it is 0 are left unchanged and their moments are not accumulated, such as pruned weights
+         * @param decay whether weight decay applies to the block, biases are normally left undecayed
+         */
+        void Update(std::size_t slot, double *parameters, const double *gradients, std::size_t count, double learningRate, const double *mask = nullptr, bool decay = true);
+
+        /**
+         * Drops the state of every slot, so training starts over from zero moments
+         */
+        void Reset();
+
+        /**
+         * Serializes the state of every slot, with aligned moments so it can be restored from a memory mapping without parsing
+         */
+        std::vector<char> SaveState() const;
+
+        /**
+         * Restores state written by `SaveState`, replacing the state of every slot
+         * @returns false, leaving the state untouched, when the state was saved by a different type of optimizer
+         */
+        bool LoadState(const void *data, std::size_t size);
+
+        virtual Id id() const = 0;
+
+        /**
+         * Number of values of state per parameter
+         */
+        virtual std::size_t momentCount() const = 0;
+
+    protected:
+        /**
+         * Arguments of a fused update over a range of a block
+         */
+        struct UpdateArgs
+        {
+            double *parameters;
+            const double *gradients;
+            const double *mask;
+            double *moments[2];
+            double learningRate;
+            std::size_t steps;          // Updates of the slot so far, including this one
+            bool decay;
+        };
+
+        /**
+         * Updates the parameters of a range of a block, the moments already being allocated
+         */
+        virtual void Run(const UpdateArgs &args, std::size_t start, std::size_t end) const = 0;
+
+    private:
+        struct State
+        {
+            std::size_t count = 0;
+            std::size_t steps = 0;
+            std::unique_ptr<AlignedBuffer> moments[2];
+        };
+
+        std::mutex stateMutex;                      // Guards the slot table, not the states themselves
+        std::vector<std::unique_ptr<State>> states; // Indexed by slot
+
+        /**
+         * State of a slot, allocated when missing or sized for a different block
+         */
+        State &Slot(std::size_t slot, std::size_t count);
+    };
+
+    /**
+     * Plain gradient descent, without state
+     */
+    class SGD : public Optimizer
+    {
+    public:
+        Id id() const override;
+        std::size_t momentCount() const override;
+
+    protected:
+        void Run(const UpdateArgs &args, std::size_t start, std::size_t end) const override;
+    };
+
+    /**
+     * Gradient descent with heavy ball momentum, `velocity = momentum * velocity + gradient`
+     */
+    class Momentum : public Optimizer
+    {
+    public:
+        Momentum(double momentum = 0.9);
+
+        Id id() const override;
+        std::size_t momentCount() const override;
+
+    protected:
+        double momentum;
+
+        void Run(const UpdateArgs &args, std::size_t start, std::size_t end) const override;
+    };
+
+    /**
+     * Gradient descent with Nesterov momentum, stepping by the gradient plus the updated velocity
+     */
+    class Nesterov : public Momentum
+    {
+    public:
+        Nesterov(double momentum = 0.9);
+
+        Id id() const override;
+
+    protected:
+        void Run(const UpdateArgs &args, std::size_t start, std::size_t end) const override;
+    };
+
+    /**
+     * Adam, scaling each step by bias-corrected running averages of the gradients and of their squares
+     */
+    class Adam : public Optimizer
+    {
+    public:
+        /**
+         * @param beta1 decay of the average of the gradients
+         * @param beta2 decay of the average of the squared gradients
+         * @param epsilon added to the root of the squared average, bounding the step of parameters with vanishing gradients
+         */
+        Adam(double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8);
+
+        Id id() const override;
+        std::size_t momentCount() const override;
+
+    protected:
+        double beta1;
+        double beta2;
+        double epsilon;
+        double weightDecay;     // Decoupled from the gradients, 0 for Adam
+
+        void Run(const UpdateArgs &args, std::size_t start, std::size_t end) const override;
+    };
+
+    /**
+     * Adam with decoupled weight decay, shrinking parameters by `learningRate * weightDecay` in the same pass as the step
+     */
+    class AdamW : public Adam
+    {
+    public:
+        AdamW(double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-8, double weightDecay = 0.01);
+
+        Id id() const override;
+    };
+}
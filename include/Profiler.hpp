@@ -0,0 +1,281 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef NN_PROFILE
+#define NN_PROFILE_CONCAT_INNER(a, b) a##b
+#define NN_PROFILE_CONCAT(a, b) NN_PROFILE_CONCAT_INNER(a, b)
+
+/**
+ * Times the rest of the enclosing scope as a region, counting the bytes it touches and the floating point operations it does
+ *
+ * The region is registered once per call site, and the arguments are only evaluated when `NN_PROFILE` is defined
+ */
+#define NN_PROFILE_SCOPE(name, bytes, flops) \
+    static const std::size_t NN_PROFILE_CONCAT(profileRegion, __LINE__) = Profiler::Register(name); \
+    Profiler::Scope NN_PROFILE_CONCAT(profileScope, __LINE__)(NN_PROFILE_CONCAT(profileRegion, __LINE__), (bytes), (flops))
+
+/**
+ * Attributes the allocations of the rest of the enclosing scope to a training phase, including those of tasks it queues on threadpools
+ * @param name string literal naming the phase
+ */
+#define NN_PROFILE_PHASE(name) Profiler::Phase NN_PROFILE_CONCAT(profilePhase, __LINE__)(name)
+
+/**
+ * Closes the allocation totals of an epoch at the end of the enclosing scope
+ */
+#define NN_PROFILE_EPOCH(epoch) Profiler::Epoch NN_PROFILE_CONCAT(profileEpoch, __LINE__)(epoch)
+
+#define NN_PROFILE_ALLOCATION(bytes) Profiler::RecordAllocation(bytes)
+#define NN_PROFILE_DEALLOCATION(bytes) Profiler::RecordDeallocation(bytes)
+#else
+#define NN_PROFILE_SCOPE(name, bytes, flops) do {} while (false)
+#define NN_PROFILE_PHASE(name) do {} while (false)
+#define NN_PROFILE_EPOCH(epoch) do {} while (false)
+#define NN_PROFILE_ALLOCATION(bytes) do {} while (false)
+#define NN_PROFILE_DEALLOCATION(bytes) do {} while (false)
+#endif
+
+/**
+ * Scoped timers around the hot paths of training and evaluation, compiled in by defining `NN_PROFILE`
+ *
+ * Every thread records its scopes into its own log without locking, a lock only being taken the first time a thread or a call site
+ * records anything. Logs are merged when exported, so exports must not run while instrumented code does.
+ * Allocations of matrix storage are counted as well, by phase and by the region they are made in
+ */
+namespace Profiler
+{
+    /**
+     * Hardware events counted by `EnableCounters`, in the order they are read
+     */
+    enum class Counter
+    {
+        Cycles,
+        Instructions,
+        L1DataMisses,
+        LastLevelCacheMisses,
+        BranchMisses
+    };
+
+    const std::size_t COUNTER_COUNT = 5;
+
+    /**
+     * Totals of a region over every thread
+     */
+    struct RegionSummary
+    {
+        std::string name;
+        std::uint64_t calls;
+        double seconds;             // Including the regions nested in it
+        double selfSeconds;         // Excluding the regions nested in it
+        std::uint64_t bytes;
+        std::uint64_t flops;
+
+        /**
+         * Hardware events of the calls that were counted, including the regions nested in them, indexed by `Counter`
+         */
+        std::uint64_t counters[COUNTER_COUNT];
+        std::uint64_t countedCalls;
+
+        /**
+         * Tasks queued to thread pools from inside the region, its work then being spread over the threads of the pools
+         */
+        std::uint64_t queuedTasks;
+    };
+
+    /**
+     * Allocations of matrix storage made in a phase from a region, the innermost region open on the allocating thread
+     */
+    struct AllocationSummary
+    {
+        std::string phase;          // Empty for allocations outside every phase
+        std::string site;           // Empty for allocations outside every region
+        std::uint64_t allocations;
+        std::uint64_t bytes;
+        std::uint64_t peakLiveBytes;    // Most matrix storage of the whole process alive when the site allocated
+    };
+
+    /**
+     * Allocations of matrix storage made on every thread during an epoch
+     */
+    struct EpochAllocations
+    {
+        int epoch;
+        std::uint64_t allocations;
+        std::uint64_t bytes;
+        std::uint64_t peakLiveBytes;
+    };
+
+    /**
+     * Peak arithmetic throughput and memory bandwidth, bounding what a region can achieve
+     */
+    struct Roofline
+    {
+        double gflops;                          // Of a single thread
+        double gigabytesPerSecond;              // Of a single thread
+        std::size_t threads;
+        double parallelGflops;                  // Of `threads` threads running at once
+        double parallelGigabytesPerSecond;      // Of `threads` threads running at once
+    };
+
+    /**
+     * Registers a named region
+     * @returns the id of the region, the same for every registration of a name
+     */
+    std::size_t Register(const char *name);
+
+    /**
+     * Records the time from its construction to its destruction as a call of a region
+     */
+    class Scope
+    {
+    public:
+        Scope(std::size_t region, std::uint64_t bytes, std::uint64_t flops);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        std::size_t region;
+        std::uint64_t bytes;
+        std::uint64_t flops;
+        std::int64_t start;
+        bool counted;
+        std::uint64_t startCounters[COUNTER_COUNT];
+    };
+
+    /**
+     * Sets the phase of the calling thread from its construction to its destruction, restoring the phase before it
+     */
+    class Phase
+    {
+    public:
+        Phase(const char *name);
+        ~Phase();
+
+        Phase(const Phase &) = delete;
+        Phase &operator=(const Phase &) = delete;
+
+        /**
+         * Phase of the calling thread, or nullptr outside every phase
+         */
+        static const char *Current();
+
+    private:
+        const char *previous;
+    };
+
+    /**
+     * Closes the allocation totals of an epoch when destroyed, whichever way the epoch ends
+     */
+    class Epoch
+    {
+    public:
+        Epoch(int epoch);
+        ~Epoch();
+
+        Epoch(const Epoch &) = delete;
+        Epoch &operator=(const Epoch &) = delete;
+
+    private:
+        int epoch;
+    };
+
+    /**
+     * Counts an allocation of matrix storage, attributing it to the phase and innermost region of the calling thread
+     */
+    void RecordAllocation(std::size_t bytes);
+
+    /**
+     * Counts the release of matrix storage, which only lowers the live bytes so it is safe from any thread at any time
+     */
+    void RecordDeallocation(std::size_t bytes);
+
+    /**
+     * Bytes of matrix storage currently allocated
+     */
+    std::uint64_t LiveBytes();
+
+    /**
+     * Whether scopes are recorded, that is whether the library was built with `NN_PROFILE`
+     */
+    bool Enabled();
+
+    /**
+     * Merges the totals of every thread, regions with the most time spent in themselves first
+     */
+    std::vector<RegionSummary> Summarize();
+
+    /**
+     * Prints the totals of every region as a table, with the bandwidth and arithmetic throughput of regions that count them
+     */
+    void PrintSummary(std::ostream &out);
+
+    /**
+     * Merges the allocations of every thread by phase and site, sites allocating the most bytes first
+     */
+    std::vector<AllocationSummary> SummarizeAllocations();
+
+    /**
+     * Allocations of every epoch closed so far, in the order they were closed
+     */
+    std::vector<EpochAllocations> AllocationsByEpoch();
+
+    /**
+     * Prints the allocations of every epoch, then of every phase and site
+     */
+    void PrintAllocationSummary(std::ostream &out);
+
+    /**
+     * Writes every recorded call as Chrome `trace_event` JSON, viewable in chrome://tracing or Perfetto
+     *
+     * Each thread keeps its first `MAX_TRACE_EVENTS` calls, later calls only counting towards the totals
+     * @param pathname path of the file to write
+     */
+    void WriteTrace(const std::string &pathname);
+
+    /**
+     * Counts hardware events through Linux `perf_event_open` around every region recorded from now on, on every thread
+     *
+     * Each thread opens its own group of counters for its user space events the first time it records a region once enabled.
+     * Reading them costs two system calls per call of a region, so regions of a few microseconds are slowed noticeably.
+     * Events the processor or the virtual machine does not count read as 0
+     * @returns false when counters cannot be opened, outside Linux or when `perf_event_paranoid` forbids it
+     */
+    bool EnableCounters();
+
+    /**
+     * Marks the innermost region open on the calling thread as spreading its work over pool threads, called by `ThreadPool::QueueTask`
+     */
+    void RecordQueuedTask();
+
+    /**
+     * Measures the roofline of a single thread and of several threads at once, with a loop of independent multiply-adds and a triad
+     * over buffers larger than the caches
+     *
+     * Takes a fraction of a second per measurement, and is only as vectorized as the flags the library is built with allow
+     * @param threads threads running at once, as many as the thread pools use for the roofline of the regions queuing tasks to them
+     */
+    Roofline MeasureRoofline(std::size_t threads = 1);
+
+    /**
+     * Prints the instructions per cycle, misses per thousand instructions and throughput of every region with counted calls
+     *
+     * The arithmetic intensity of a region places it on the roofline: below the ridge point it is bound by memory, and above it by compute.
+     * The last column is the fraction of the bound the region achieves, above 100% for memory-bound regions whose data stays in cache.
+     * Regions queuing tasks to thread pools are timed on the queuing thread while every thread works, so they are held to the roofline
+     * of all threads, while other regions, including the tasks themselves, run on a single thread and are held to its roofline
+     */
+    void PrintCounterSummary(std::ostream &out, const Roofline &roofline);
+
+    /**
+     * Discards every recorded call and allocation, keeping the registered regions and the live bytes
+     */
+    void Reset();
+
+    const std::size_t MAX_TRACE_EVENTS = 1 << 20;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+
+#include "Matrix.hpp"
+
+namespace NeuralNetwork
+{
+    /**
+     * Describes which weights of a layer are removed by pruning
+     */
+    struct PruningOptions
+    {
+        enum class Pattern
+        {
+            Magnitude,  // The smallest weights of the layer, wherever they are
+            NM,         // All but the `n` largest of every `m` consecutive weights of a row
+            Block       // The blocks of `blockRows` by `blockCols` weights of smallest total magnitude
+        };
+
+        Pattern pattern = Pattern::Magnitude;
+
+        /**
+         * Fraction of the weights, or of the blocks, removed by `Magnitude` and `Block` pruning
+         */
+        double sparsity = 0.5;
+
+        std::size_t n = 2;
+        std::size_t m = 4;
+
+        std::size_t blockRows = 4;
+        std::size_t blockCols = 4;
+    };
+
+    /**
+     * Chooses the weights kept by pruning
+     * @param weights weights of a layer, one row per neuron
+     * @param options pattern and amount of pruning
+     * @returns a matrix of the size of the weights, 1 for each weight kept and 0 for each weight removed
+     */
+    Math::Matrix PruningMask(const Math::Matrix &weights, const PruningOptions &options);
+}
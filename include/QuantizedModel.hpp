@@ -0,0 +1,115 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "AlignedBuffer.hpp"
+#include "Layer.hpp"
+
+namespace NeuralNetwork
+{
+    /**
+     * An immutable copy of a trained model with 8 bit integer weights and activations, only able to predict
+     *
+     * Each row of weights is scaled symmetrically into [-127, 127], and the activations feeding each layer are scaled into [0, 127]
+     * with a zero point, from ranges calibrated on sample inputs. Keeping activations within 7 bits lets the AVX2 `maddubs` kernel
+     * sum pairs of products without saturating, so every kernel computes the same exact 32 bit integer products.
+     * Dequantization, bias, activation and quantization for the next layer are applied in the pass that writes each row block
+     */
+    class QuantizedModel
+    {
+    public:
+        /**
+         * Number of rows in a packed weight block, one 32 bit lane each in a SIMD register
+         */
+        static const std::size_t ROW_BLOCK = 8;
+
+        /**
+         * Number of consecutive inputs whose products are summed into a lane at once
+         */
+        static const std::size_t INPUT_GROUP = 4;
+
+        /**
+         * @param layers layers of a trained model, the input layer first
+         * @param calibration sample inputs used to find the range of every layer's activations, one instance after another
+         * @param calibrationCount number of sample inputs
+         * @param maxBatchSize number of instances each buffer holds, larger predictions are run in batches of this size
+         */
+        QuantizedModel(const std::vector<Layer> &layers, const float *calibration, std::size_t calibrationCount, std::size_t maxBatchSize = 64);
+
+        /**
+         * Predicts the outputs of instances, safe to call from many threads at once
+         * @param input parameters of each instance, one instance after another
+         * @param count number of instances
+         * @param output written with the output of each instance, one instance after another
+         */
+        void Predict(const float *input, std::size_t count, float *output) const;
+
+        std::size_t inputSize() const;
+        std::size_t outputSize() const;
+        std::size_t maxBatchSize() const;
+
+        /**
+         * @returns size in bytes of the quantized weights of every layer
+         */
+        std::size_t weightSize() const;
+
+    private:
+        /**
+         * Affine mapping of real values onto 7 bit integers, `real = scale * (quantized - zeroPoint)`
+         */
+        struct Quantization
+        {
+            float scale;
+            std::int32_t zeroPoint;
+        };
+
+        struct QuantizedLayer
+        {
+            std::size_t inputCount;                 // Padded to a whole number of row blocks, matching the outputs of the layer before
+            std::size_t outputCount;
+            std::size_t paddedOutputCount;          // Rounded up to a whole number of row blocks
+            ActivationFn::Id activation;
+            Quantization output;                    // Quantization of the outputs, unused by the last layer
+
+            std::unique_ptr<AlignedBuffer> weights; // Per row block and group of inputs, INPUT_GROUP weights of each row in turn
+            std::unique_ptr<AlignedBuffer> scales;  // Per row, the input scale times the weight scale
+            std::unique_ptr<AlignedBuffer> bias;    // Per row, the bias less the contribution of the input zero point
+        };
+
+        /**
+         * Ping-pong activation buffers for a whole batch, and the single precision outputs of the last layer
+         */
+        struct Workspace
+        {
+            AlignedBuffer front;
+            AlignedBuffer back;
+            AlignedBuffer output;
+
+            Workspace(std::size_t size, std::size_t outputSize);
+        };
+
+        struct WorkspacePool
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<Workspace>> available;
+        };
+
+        std::vector<QuantizedLayer> layers;
+        std::size_t inputCount;
+        std::size_t paddedInputCount;
+        Quantization input;
+        std::size_t batchSize;
+        std::size_t workspaceSize;                  // In bytes, for each of the two activation buffers
+
+        std::unique_ptr<WorkspacePool> workspaces;
+
+        /**
+         * Runs a batch of at most `batchSize` instances through every layer
+         */
+        void PredictBatch(const float *input, std::size_t count, float *output, Workspace &workspace) const;
+    };
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <memory>
+
+#include "Evaluator.hpp"
+
+namespace Schedule
+{
+    /**
+     * Chooses the learning rate of every epoch of training, from the learning rate passed to `Train`
+     *
+     * Schedules are reset at the start of every call to `Train`, so epochs count from 0 in each training session
+     */
+    class Schedule
+    {
+    public:
+        virtual ~Schedule();
+
+        /**
+         * @param epoch epoch about to be trained
+         * @param baseRate learning rate of the training session
+         * @returns the learning rate of the epoch
+         */
+        virtual double Rate(int epoch, double baseRate) = 0;
+
+        /**
+         * Receives the results of every evaluated epoch, in order, before the rate of a later epoch is asked for
+         *
+         * With asynchronous evaluation the results of an epoch arrive once the next epoch has trained, so they decide the rate of the epoch after it
+         */
+        virtual void Observe(const NeuralNetwork::EvaluationResult &results);
+
+        /**
+         * Forgets what was observed in a previous training session
+         */
+        virtual void Reset();
+
+        /**
+         * Whether the schedule follows a validation metric, so training without a testing set is refused before it starts
+         */
+        virtual bool needsTestingSet() const;
+    };
+
+    /**
+     * The same learning rate every epoch
+     */
+    class Constant : public Schedule
+    {
+    public:
+        double Rate(int epoch, double baseRate) override;
+    };
+
+    /**
+     * Multiplies the learning rate by `gamma` every `stepSize` epochs
+     */
+    class Step : public Schedule
+    {
+    public:
+        Step(int stepSize, double gamma = 0.1);
+
+        double Rate(int epoch, double baseRate) override;
+
+    private:
+        int stepSize;
+        double gamma;
+    };
+
+    /**
+     * Anneals the learning rate along half a cosine, from the base rate down to `minFactor` times it over `period` epochs, then holds it there
+     */
+    class Cosine : public Schedule
+    {
+    public:
+        Cosine(int period, double minFactor = 0);
+
+        double Rate(int epoch, double baseRate) override;
+
+    private:
+        int period;
+        double minFactor;
+    };
+
+    /**
+     * Raises the learning rate linearly over the first epochs, then follows another schedule counting epochs from the end of the warmup
+     *
+     * Keeps the first updates small while the moments of adaptive optimizers and the early gradients are still unreliable
+     */
+    class Warmup : public Schedule
+    {
+    public:
+        /**
+         * @param epochs number of epochs of warmup, the first training at `baseRate / epochs`
+         * @param after schedule followed after the warmup, which the warmup takes ownership of (nullptr for a constant rate)
+         */
+        Warmup(int epochs, Schedule *after = nullptr);
+
+        double Rate(int epoch, double baseRate) override;
+        void Observe(const NeuralNetwork::EvaluationResult &results) override;
+        void Reset() override;
+        bool needsTestingSet() const override;
+
+    private:
+        int epochs;
+        std::unique_ptr<Schedule> after;
+    };
+
+    /**
+     * Multiplies the learning rate by `factor` whenever a metric has not improved for `patience` epochs
+     */
+    class ReduceOnPlateau : public Schedule
+    {
+    public:
+        /**
+         * @param metric metric followed, a validation metric needing a testing set
+         * @param factor multiplies the learning rate on every plateau
+         * @param patience number of epochs without improvement making a plateau
+         * @param minDelta smallest change of the metric counted as an improvement
+         * @param minFactor the learning rate is never reduced below this times the base rate
+         */
+        ReduceOnPlateau(NeuralNetwork::Metric metric = NeuralNetwork::Metric::ValidationCost, double factor = 0.1, int patience = 10, double minDelta = 1e-4, double minFactor = 0);
+
+        double Rate(int epoch, double baseRate) override;
+        void Observe(const NeuralNetwork::EvaluationResult &results) override;
+        void Reset() override;
+        bool needsTestingSet() const override;
+
+    private:
+        NeuralNetwork::MetricMonitor monitor;
+        double factor;
+        int patience;
+        double minFactor;
+
+        double scale = 1;
+        int lastReduction = -1;     // Epoch whose results last reduced the rate, patience counting again from it
+    };
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Data.hpp"
+#include "DataStream.hpp"
+
+/**
+ * Shuffles a stream through a buffer of instances, drawing each instance at random from the buffer and refilling it from the stream
+ *
+ * Instances are only shuffled within a window of the buffer's capacity, so the memory used is bounded however long the stream is
+ */
+class ShuffleBuffer : public DataStream
+{
+public:
+    /**
+     * @param source stream to shuffle, must outlive the buffer
+     * @param capacity number of instances held in the buffer
+     */
+    ShuffleBuffer(DataStream &source, std::size_t capacity = 1 << 16);
+
+    std::size_t parameterSize() const override;
+    std::size_t labelSize() const override;
+
+    std::size_t Read(std::size_t count, Data &batch) override;
+    bool AtEnd() override;
+    void Reset() override;
+
+    /**
+     * Reopens the source stream, without shuffling it
+     */
+    std::unique_ptr<DataStream> Reopen() const override;
+
+private:
+    DataStream &source;
+    std::size_t capacity;
+
+    std::vector<double> buffer;     // Parameters then labels of each buffered instance, one instance after another
+    std::size_t bufferedCount;
+
+    Data staging;                   // Chunk read from the source, not yet moved into the buffer
+    std::size_t stagingPosition;
+
+    std::vector<double> instances;  // Instances drawn by the current read
+    std::default_random_engine rng;
+
+    /**
+     * Moves the next instance of the source into a row of the buffer
+     * @returns false when the source is at its end
+     */
+    bool Pull(double *row);
+};
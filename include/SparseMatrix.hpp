@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Matrix.hpp"
+
+namespace Math
+{
+    /**
+     * A matrix in compressed sparse rows, storing only its nonzero values
+     *
+     * Batches of sparse parameters hold one row per instance, the transpose of the layout of a dense batch,
+     * so the nonzero parameters of each instance are consecutive
+     */
+    struct SparseMatrix
+    {
+        std::size_t rows;
+        std::size_t cols;
+
+        /**
+         * Index of the first nonzero value of each row, followed by the number of nonzero values
+         */
+        std::vector<std::size_t> rowOffsets;
+        std::vector<std::uint32_t> columns;
+        std::vector<double> values;
+
+        SparseMatrix();
+
+        /**
+         * A matrix of zeros
+         */
+        SparseMatrix(std::size_t p_rows, std::size_t p_cols);
+
+        /**
+         * Compresses the transpose of a dense matrix, such as the parameters of a dense batch
+         */
+        static SparseMatrix FromTranspose(const Matrix &matrix);
+
+        std::size_t nonzeroCount() const;
+
+        /**
+         * Multiplies a dense matrix by the transpose of this matrix, in time proportional to the nonzero values
+         * @param left matrix with as many columns as this matrix, such as the weights of a layer
+         * @returns `left * transpose(this)`
+         */
+        Matrix TransposedProduct(const Matrix &left) const;
+
+        /**
+         * Adds the product of a dense matrix and this matrix to another, only touching the columns of the result where this matrix has nonzero values
+         * @param left matrix with as many columns as this matrix has rows, such as the gradients of a layer
+         * @param mult multiplier of the product
+         * @param result matrix added to, `result += mult * left * this`
+         * @param mask when given, multiplies each product added to the result, so masked values stay unchanged
+         */
+        void AddProduct(const Matrix &left, double mult, Matrix &result, const Matrix *mask = nullptr) const;
+    };
+}
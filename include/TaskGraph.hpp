@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Threadpool.hpp"
+
+/**
+ * A set of tasks with dependencies between them, executed on a threadpool
+ *
+ * A task is queued as soon as every task it depends on has finished, so independent branches of the graph run concurrently
+*/
+class TaskGraph {
+    using Task = std::function<void()>;
+
+    public:
+        using TaskId = std::size_t;
+
+        /**
+         * Adds a task to the graph
+         * @param task function to run
+         * @param dependencies tasks that must finish before this task starts, must already be in the graph
+         * @returns id of the task, used to declare dependencies of later tasks
+        */
+        TaskId AddTask(const Task& task, const std::vector<TaskId>& dependencies = {});
+
+        /**
+         * Runs every task in the graph and waits until they are all finished
+         *
+         * Tasks must not wait on `pool` themselves, as that can deadlock the pool
+         * @param pool threadpool to run tasks on
+        */
+        void Run(ThreadPool& pool);
+
+        std::size_t size();
+
+    private:
+        struct Node {
+            Task task;
+            std::vector<TaskId> successors;
+            std::size_t dependencyCount;
+        };
+
+        void Queue(ThreadPool& pool, TaskId id);
+
+        std::vector<Node> nodes;
+
+        std::unique_ptr<std::atomic<std::size_t>[]> remaining;  // Unfinished dependencies of each task during a run
+        std::size_t finishedCount = 0;
+        std::exception_ptr error;                                // First exception thrown by a task, rethrown by Run
+
+        std::mutex run_mutex;
+        std::condition_variable run_condition;
+};
@@ -1,4 +1,5 @@
 #include <cmath>
+#include <stdexcept>
 
 #include "ActivationFn.hpp"
 
@@ -20,6 +21,7 @@ namespace ActivationFn
     double ActivationFn::fn(double x) { return x; };
     double ActivationFn::dx(double x) { return 1; };
     ActivationFn* ActivationFn::clone() { return new ActivationFn(); };
+    Id ActivationFn::id() const { return Id::Identity; };
 
     double ReLU::fn(double x)
     {
@@ -32,6 +34,7 @@ namespace ActivationFn
     };
     
     ActivationFn* ReLU::clone() { return new ReLU(); };
+    Id ReLU::id() const { return Id::ReLU; };
 
     double LeakyReLU::fn(double x)
     {
@@ -44,6 +47,7 @@ namespace ActivationFn
     };
     
     ActivationFn* LeakyReLU::clone() { return new LeakyReLU(); };
+    Id LeakyReLU::id() const { return Id::LeakyReLU; };
 
     double Tanh::fn(double x)
     {
@@ -56,6 +60,7 @@ namespace ActivationFn
     };
     
     ActivationFn* Tanh::clone() { return new Tanh(); };
+    Id Tanh::id() const { return Id::Tanh; };
 
     double LogisticSigmoid::fn(double x)
     {
@@ -71,6 +76,7 @@ namespace ActivationFn
     }; 
     
     ActivationFn* LogisticSigmoid::clone() { return new LogisticSigmoid(); };
+    Id LogisticSigmoid::id() const { return Id::LogisticSigmoid; };
 
     double Linear::fn(double x)
     {
@@ -83,4 +89,53 @@ namespace ActivationFn
     };
     
     ActivationFn* Linear::clone() { return new Linear(); };
+    Id Linear::id() const { return Id::Linear; };
+
+    ActivationFn* Create(Id id)
+    {
+        switch (id) {
+        case Id::None:
+            return nullptr;
+        case Id::Identity:
+            return new ActivationFn();
+        case Id::ReLU:
+            return new ReLU();
+        case Id::LeakyReLU:
+            return new LeakyReLU();
+        case Id::Tanh:
+            return new Tanh();
+        case Id::LogisticSigmoid:
+            return new LogisticSigmoid();
+        case Id::Linear:
+            return new Linear();
+        }
+
+        throw std::invalid_argument("unknown activation function");
+    };
+
+    void Apply(Id id, float *values, std::size_t count)
+    {
+        switch (id) {
+        case Id::None:
+        case Id::Identity:
+        case Id::Linear:
+            break;
+        case Id::ReLU:
+            for (std::size_t i = 0; i < count; i++)
+                values[i] = values[i] > 0 ? values[i] : 0;
+            break;
+        case Id::LeakyReLU:
+            for (std::size_t i = 0; i < count; i++)
+                values[i] = values[i] > 0 ? values[i] : values[i] * 0.1f;
+            break;
+        case Id::Tanh:
+            for (std::size_t i = 0; i < count; i++)
+                values[i] = std::tanh(values[i]);
+            break;
+        case Id::LogisticSigmoid:
+            for (std::size_t i = 0; i < count; i++)
+                values[i] = 1 / (1 + std::exp(-values[i]));
+            break;
+        }
+    };
 }
@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "AlignedBuffer.hpp"
+
+AlignedBuffer::AlignedBuffer(std::size_t size, std::size_t alignment)
+    : bufferSize(size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        throw std::invalid_argument("alignment must be a power of two");
+
+    // Over-allocates by the alignment so the aligned start always fits, as C++14 has no aligned allocation
+    allocation = std::malloc(size + alignment);
+
+    if (!allocation)
+        throw std::bad_alloc();
+
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(allocation);
+    aligned = reinterpret_cast<void *>((address + alignment - 1) & ~(std::uintptr_t)(alignment - 1));
+
+    std::memset(aligned, 0, size);
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+    std::free(allocation);
+}
+
+void *AlignedBuffer::data()
+{
+    return aligned;
+}
+
+const void *AlignedBuffer::data() const
+{
+    return aligned;
+}
+
+std::size_t AlignedBuffer::size() const
+{
+    return bufferSize;
+}
+
+std::size_t AlignedBuffer::AlignUp(std::size_t size, std::size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
@@ -0,0 +1,118 @@
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "BackgroundWorker.hpp"
+#include "Profiler.hpp"
+
+namespace
+{
+    /**
+     * Lowers the scheduling priority of the calling thread, where the platform allows it per thread
+     */
+    void LowerThreadPriority()
+    {
+#ifdef _WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+        // Linux applies nice values to single threads
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+#endif
+    }
+}
+
+BackgroundWorker::BackgroundWorker()
+{
+    worker = std::thread(&BackgroundWorker::WorkerLoop, this);
+}
+
+BackgroundWorker::~BackgroundWorker()
+{
+    {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        job_condition.wait(lock, [this] { return !job; });
+        should_terminate = true;
+    }
+
+    job_condition.notify_all();
+    worker.join();
+}
+
+void BackgroundWorker::Submit(const Job &p_job)
+{
+    {
+        std::unique_lock<std::mutex> lock(job_mutex);
+        job_condition.wait(lock, [this] { return !job; });
+
+        if (error) {
+            std::exception_ptr jobError = error;
+            error = nullptr;
+            std::rethrow_exception(jobError);
+        }
+
+        job = p_job;
+    }
+
+    job_condition.notify_all();
+}
+
+void BackgroundWorker::Wait()
+{
+    NN_PROFILE_SCOPE("BackgroundWorker wait", 0, 0);
+
+    std::unique_lock<std::mutex> lock(job_mutex);
+    job_condition.wait(lock, [this] { return !job; });
+
+    if (error) {
+        std::exception_ptr jobError = error;
+        error = nullptr;
+        std::rethrow_exception(jobError);
+    }
+}
+
+void BackgroundWorker::WorkerLoop()
+{
+    LowerThreadPriority();
+
+    while (true) {
+        Job current;
+
+        {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            job_condition.wait(lock, [this] { return job || should_terminate; });
+
+            if (should_terminate)
+                return;
+
+            current = job;
+        }
+
+        // The job stays set while it runs, so waiting callers see it as unfinished
+        std::exception_ptr jobError;
+
+        try
+        {
+            current();
+        }
+        catch (...)
+        {
+            jobError = std::current_exception();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(job_mutex);
+            error = jobError;
+            job = nullptr;
+        }
+
+        job_condition.notify_all();
+    }
+}
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#include "BatchLoader.hpp"
+#include "Data.hpp"
+#include "DataStream.hpp"
+#include "Dataset.hpp"
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+#include "SparseMatrix.hpp"
+
+BatchLoader::BatchLoader(const Dataset &data, std::size_t p_batchSize, std::size_t prefetchCount, bool p_shuffle, bool p_sparse)
+    : instanceCount(data.size()), batchSize(p_batchSize), shuffle(p_shuffle), sparse(p_sparse)
+{
+    gatherer = [&data](const std::uint32_t *batchIndices, std::size_t count, Data &batch) {
+        data.Gather(batchIndices, count, batch);
+    };
+
+    Start(data.parameterSize(), data.labelSize(), prefetchCount);
+}
+
+BatchLoader::BatchLoader(Gatherer p_gatherer, std::size_t p_instanceCount, std::size_t parameterSize, std::size_t labelSize, std::size_t p_batchSize, std::size_t prefetchCount, bool p_shuffle)
+    : gatherer(p_gatherer), instanceCount(p_instanceCount), batchSize(p_batchSize), shuffle(p_shuffle)
+{
+    if (instanceCount == 0)
+        throw std::invalid_argument("data source cannot be empty");
+
+    Start(parameterSize, labelSize, prefetchCount);
+}
+
+BatchLoader::BatchLoader(DataStream &stream, std::size_t p_batchSize, std::size_t prefetchCount)
+    : instanceCount(0), batchSize(p_batchSize), shuffle(false)
+{
+    if (batchSize == 0)
+        throw std::invalid_argument("streams must be batched with a positive batch size");
+
+    // The stream is rewound once it ends, so the loader carries on into the next epoch
+    producer = [this, &stream](Data &batch) {
+        if (stream.Read(batchSize, batch) == 0)
+            throw std::runtime_error("data stream is empty");
+
+        if (!stream.AtEnd())
+            return false;
+
+        stream.Reset();
+        return true;
+    };
+
+    Start(stream.parameterSize(), stream.labelSize(), prefetchCount);
+}
+
+BatchLoader::~BatchLoader()
+{
+    {
+        std::unique_lock<std::mutex> lock(ring_mutex);
+        should_terminate = true;
+    }
+
+    ring_condition.notify_all();
+    loader.join();
+}
+
+void BatchLoader::Start(std::size_t parameterSize, std::size_t labelSize, std::size_t prefetchCount)
+{
+    if (gatherer) {
+        if (batchSize == 0 || batchSize > instanceCount)
+            batchSize = instanceCount;
+
+        indices = std::vector<std::uint32_t>(instanceCount);
+        std::iota(indices.begin(), indices.end(), 0);
+        rng.seed(std::chrono::system_clock::now().time_since_epoch().count());
+
+        producer = [this](Data &batch) { return GatherNext(batch); };
+    }
+
+    // One more slot than prefetched, since the consumer holds on to the batch it is training on
+    for (std::size_t i = 0; i < prefetchCount + 1; i++) {
+        if (sparse)
+            slots.push_back(Data(Math::SparseMatrix(batchSize, parameterSize), Math::Matrix(labelSize, batchSize)));
+        else
+            slots.push_back(Data(Math::Matrix(parameterSize, batchSize), Math::Matrix(labelSize, batchSize)));
+    }
+
+    slotEndsEpoch = std::vector<char>(slots.size(), false);
+    loader = std::thread(&BatchLoader::LoaderLoop, this);
+}
+
+bool BatchLoader::GatherNext(Data &batch)
+{
+    NN_PROFILE_SCOPE("BatchLoader::GatherNext", 0, 0);
+    NN_PROFILE_PHASE("batching");
+
+    if (nextBatch == 0 && shuffle)
+        std::shuffle(indices.begin(), indices.end(), rng);
+
+    std::size_t start = nextBatch * batchSize;
+    std::size_t count = std::min(batchSize, instanceCount - start);
+
+    // Sparse parameters are rebuilt by every gather, so only dense parameters are resized
+    if (batch.dataInstanceCount != count) {
+        if (!batch.sparse)
+            batch.parameters.Resize(batch.parameterSize, count);
+
+        batch.label.Resize(batch.labelSize, count);
+        batch.dataInstanceCount = count;
+    }
+
+    gatherer(indices.data() + start, count, batch);
+
+    nextBatch = (nextBatch + 1) % BatchCount();
+    return nextBatch == 0;
+}
+
+void BatchLoader::LoaderLoop()
+{
+    try
+    {
+        while (true) {
+            std::size_t slot;
+
+            {
+                std::unique_lock<std::mutex> lock(ring_mutex);
+
+                // Every slot except the one held by the consumer can be written
+                ring_condition.wait(lock, [this] {
+                    return should_terminate || producedCount + 1 < consumedCount + slots.size();
+                });
+
+                if (should_terminate)
+                    return;
+
+                slot = producedCount % slots.size();
+            }
+
+            // The slot is not visible to the consumer until producedCount is incremented, so it is filled without the lock
+            slotEndsEpoch[slot] = producer(slots[slot]);
+
+            {
+                std::unique_lock<std::mutex> lock(ring_mutex);
+                producedCount++;
+            }
+
+            ring_condition.notify_all();
+        }
+    }
+    catch (...)
+    {
+        {
+            std::unique_lock<std::mutex> lock(ring_mutex);
+            error = std::current_exception();
+        }
+
+        ring_condition.notify_all();
+    }
+}
+
+Data &BatchLoader::Next()
+{
+    NN_PROFILE_SCOPE("BatchLoader::Next wait", 0, 0);
+
+    std::unique_lock<std::mutex> lock(ring_mutex);
+
+    // Incrementing consumedCount releases the previous batch back to the loader
+    consumedCount++;
+    ring_condition.notify_all();
+
+    ring_condition.wait(lock, [this] {
+        return producedCount >= consumedCount || error;
+    });
+
+    if (producedCount < consumedCount)
+        std::rethrow_exception(error);
+
+    const std::size_t slot = (consumedCount - 1) % slots.size();
+    endOfEpoch = slotEndsEpoch[slot];
+
+    return slots[slot];
+}
+
+bool BatchLoader::EndOfEpoch() const
+{
+    return endOfEpoch;
+}
+
+std::size_t BatchLoader::BatchCount() const
+{
+    if (!gatherer)
+        return 0;
+
+    return std::ceil(instanceCount / (double) batchSize);
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "BatchScheduler.hpp"
+
+namespace NeuralNetwork
+{
+    const std::size_t BatchScheduler::LATENCY_WINDOW;
+
+    BatchScheduler::BatchScheduler(const InferenceModel &model, std::size_t maxBatchSize, std::chrono::microseconds maxDelay)
+        : model(model), batchSize(maxBatchSize == 0 ? model.maxBatchSize() : maxBatchSize), maxDelay(maxDelay)
+    {
+        if (maxDelay.count() < 0)
+            throw std::invalid_argument("maximum delay must not be negative");
+
+        pending.reserve(batchSize);
+        inputs.resize(batchSize * model.inputSize());
+        outputs.resize(batchSize * model.outputSize());
+        latencies.resize(LATENCY_WINDOW);
+        metricsStart = std::chrono::steady_clock::now();
+
+        dispatcher = std::thread(&BatchScheduler::DispatchLoop, this);
+    }
+
+    BatchScheduler::~BatchScheduler()
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            should_terminate = true;
+        }
+
+        queue_condition.notify_all();
+        dispatcher.join();
+    }
+
+    void BatchScheduler::Predict(const float *input, float *output)
+    {
+        Request request;
+        request.input = input;
+        request.output = output;
+        request.arrival = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(queue_mutex);
+
+        if (should_terminate)
+            throw std::runtime_error("batch scheduler is stopping");
+
+        pending.push_back(&request);
+
+        // The dispatcher only needs waking for the first request of a batch, or when the batch fills up
+        if (pending.size() == 1 || pending.size() == batchSize)
+            queue_condition.notify_all();
+
+        request.condition.wait(lock, [&request] { return request.done; });
+
+        if (request.error)
+            std::rethrow_exception(request.error);
+    }
+
+    SchedulerMetrics BatchScheduler::Metrics(bool reset)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        auto now = std::chrono::steady_clock::now();
+
+        SchedulerMetrics metrics;
+        metrics.requests = requestCount;
+        metrics.batches = batchCount;
+        metrics.averageBatchSize = batchCount == 0 ? 0 : (double) requestCount / batchCount;
+        metrics.throughput = requestCount / std::max(std::chrono::duration<double>(now - metricsStart).count(), 1e-9);
+        metrics.meanLatency = latencyCount == 0 ? 0 : latencyTotal / latencyCount;
+
+        std::vector<double> window(latencies.begin(), latencies.begin() + std::min(latencyCount, LATENCY_WINDOW));
+        std::sort(window.begin(), window.end());
+
+        auto percentile = [&window](double p) {
+            return window.empty() ? 0 : window[std::min(window.size() - 1, (std::size_t) (p * window.size()))];
+        };
+
+        metrics.p50Latency = percentile(0.5);
+        metrics.p99Latency = percentile(0.99);
+        metrics.maxLatency = window.empty() ? 0 : window.back();
+
+        if (reset) {
+            requestCount = 0;
+            batchCount = 0;
+            latencyCount = 0;
+            latencyTotal = 0;
+            metricsStart = now;
+        }
+
+        return metrics;
+    }
+
+    void BatchScheduler::DispatchLoop()
+    {
+        std::vector<Request *> batch;
+        batch.reserve(batchSize);
+
+        const std::size_t inputSize = model.inputSize();
+        const std::size_t outputSize = model.outputSize();
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_condition.wait(lock, [this] { return !pending.empty() || should_terminate; });
+
+                if (pending.empty())
+                    return;
+
+                // Give other requests until the deadline of the oldest one to join its batch, unless stopping
+                auto deadline = pending.front()->arrival + maxDelay;
+                queue_condition.wait_until(lock, deadline, [this] { return pending.size() >= batchSize || should_terminate; });
+
+                std::size_t count = std::min(pending.size(), batchSize);
+                batch.assign(pending.begin(), pending.begin() + count);
+                pending.erase(pending.begin(), pending.begin() + count);
+            }
+
+            // Requests are only read and written outside the lock, as their callers are blocked until they are done
+            std::exception_ptr error;
+
+            try
+            {
+                for (std::size_t i = 0; i < batch.size(); i++) {
+                    std::memcpy(&inputs[i * inputSize], batch[i]->input, inputSize * sizeof(float));
+                }
+
+                model.Predict(inputs.data(), batch.size(), outputs.data());
+
+                for (std::size_t i = 0; i < batch.size(); i++) {
+                    std::memcpy(batch[i]->output, &outputs[i * outputSize], outputSize * sizeof(float));
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            auto now = std::chrono::steady_clock::now();
+
+            for (Request *request : batch) {
+                double latency = std::chrono::duration<double, std::micro>(now - request->arrival).count();
+                latencies[latencyCount % LATENCY_WINDOW] = latency;
+                latencyCount++;
+                latencyTotal += latency;
+
+                request->error = error;
+                request->done = true;
+                request->condition.notify_one();
+            }
+
+            requestCount += batch.size();
+            batchCount++;
+        }
+    }
+}
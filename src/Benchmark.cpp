@@ -0,0 +1,572 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "Data.hpp"
+#include "Dataset.hpp"
+#include "DatasetStream.hpp"
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+
+namespace Benchmark
+{
+    namespace
+    {
+        /**
+         * Allocations of matrix storage made so far, or -1 when they are not counted
+         */
+        double TotalAllocations()
+        {
+            if (!Profiler::Enabled())
+                return -1;
+
+            double total = 0;
+
+            for (const Profiler::AllocationSummary &summary : Profiler::SummarizeAllocations()) {
+                total += summary.allocations;
+            }
+
+            return total;
+        }
+
+        void WriteEscaped(std::ostream &out, const std::string &text)
+        {
+            for (char c : text) {
+                if (c == '"' || c == '\\')
+                    out << '\\';
+
+                out << c;
+            }
+        }
+
+        /**
+         * Reads the subset of JSON written by `WriteResults`, skipping values it does not know
+         */
+        class Reader
+        {
+        public:
+            Reader(const std::string &p_text, const std::string &p_pathname)
+                :text(p_text), pathname(p_pathname) {}
+
+            std::vector<Result> ReadResults()
+            {
+                std::vector<Result> results;
+
+                ReadObject([&](const std::string &key) {
+                    if (key != "results") {
+                        SkipValue();
+                        return;
+                    }
+
+                    ReadArray([&] { results.push_back(ReadResult()); });
+                });
+
+                SkipSpace();
+
+                if (position != text.size())
+                    Fail("trailing characters");
+
+                return results;
+            }
+
+        private:
+            const std::string &text;
+            const std::string &pathname;
+            std::size_t position = 0;
+
+            [[noreturn]] void Fail(const std::string &reason)
+            {
+                throw std::runtime_error("malformed benchmark results in \"" + pathname + "\" at offset " + std::to_string(position) + ": " + reason);
+            }
+
+            void SkipSpace()
+            {
+                while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) {
+                    position++;
+                }
+            }
+
+            char Peek()
+            {
+                SkipSpace();
+
+                if (position == text.size())
+                    Fail("unexpected end");
+
+                return text[position];
+            }
+
+            void Expect(char c)
+            {
+                if (Peek() != c)
+                    Fail(std::string("expected '") + c + "'");
+
+                position++;
+            }
+
+            std::string ReadString()
+            {
+                Expect('"');
+                std::string value;
+
+                while (position < text.size() && text[position] != '"') {
+                    // only the escapes `WriteEscaped` produces are expected, any other escaped character is taken as it is
+                    if (text[position] == '\\')
+                        position++;
+
+                    if (position < text.size())
+                        value += text[position++];
+                }
+
+                Expect('"');
+                return value;
+            }
+
+            double ReadNumber()
+            {
+                SkipSpace();
+                const char *start = text.c_str() + position;
+                char *end;
+                const double value = std::strtod(start, &end);
+
+                if (end == start)
+                    Fail("expected a number");
+
+                position += end - start;
+                return value;
+            }
+
+            void ReadObject(const std::function<void(const std::string &)> &member)
+            {
+                Expect('{');
+
+                if (Peek() == '}') {
+                    position++;
+                    return;
+                }
+
+                while (true) {
+                    const std::string key = ReadString();
+                    Expect(':');
+                    member(key);
+
+                    if (Peek() == '}') {
+                        position++;
+                        return;
+                    }
+
+                    Expect(',');
+                }
+            }
+
+            void ReadArray(const std::function<void()> &element)
+            {
+                Expect('[');
+
+                if (Peek() == ']') {
+                    position++;
+                    return;
+                }
+
+                while (true) {
+                    element();
+
+                    if (Peek() == ']') {
+                        position++;
+                        return;
+                    }
+
+                    Expect(',');
+                }
+            }
+
+            void SkipValue()
+            {
+                const char c = Peek();
+
+                if (c == '{')
+                    ReadObject([this](const std::string &) { SkipValue(); });
+                else if (c == '[')
+                    ReadArray([this] { SkipValue(); });
+                else if (c == '"')
+                    ReadString();
+                else if (text.compare(position, 4, "true") == 0 || text.compare(position, 4, "null") == 0)
+                    position += 4;
+                else if (text.compare(position, 5, "false") == 0)
+                    position += 5;
+                else
+                    ReadNumber();
+            }
+
+            Result ReadResult()
+            {
+                Result result = {"", 0, 0, 0, 0, 0, 0, -1, 0};
+
+                ReadObject([&](const std::string &key) {
+                    if (key == "name")
+                        result.name = ReadString();
+                    else if (key == "median")
+                        result.median = ReadNumber();
+                    else if (key == "min")
+                        result.min = ReadNumber();
+                    else if (key == "max")
+                        result.max = ReadNumber();
+                    else if (key == "samples")
+                        result.samples = (std::size_t) ReadNumber();
+                    else if (key == "bytes")
+                        result.bytes = ReadNumber();
+                    else if (key == "flops")
+                        result.flops = ReadNumber();
+                    else if (key == "allocations")
+                        result.allocations = ReadNumber();
+                    else if (key == "threshold")
+                        result.threshold = ReadNumber();
+                    else
+                        SkipValue();
+                });
+
+                if (result.name.empty())
+                    Fail("result without a name");
+
+                return result;
+            }
+        };
+    }
+
+    Options ParseOptions(int argc, char **argv, std::vector<std::string> &positional)
+    {
+        Options options;
+
+        for (int i = 1; i < argc; i++) {
+            const std::string argument = argv[i];
+
+            if (argument.compare(0, 2, "--") != 0) {
+                positional.push_back(argument);
+                continue;
+            }
+
+            if (i + 1 == argc)
+                throw std::invalid_argument("missing value of " + argument);
+
+            const std::string value = argv[++i];
+
+            if (argument == "--filter")
+                options.filter = value;
+            else if (argument == "--json")
+                options.jsonPath = value;
+            else if (argument == "--baseline")
+                options.baselinePath = value;
+            else if (argument == "--threshold")
+                options.threshold = std::stod(value);
+            else if (argument == "--min-time")
+                options.minSeconds = std::stod(value);
+            else if (argument == "--samples")
+                options.samples = std::stoul(value);
+            else if (argument == "--compare") {
+                if (value != "all" && value != "allocations")
+                    throw std::invalid_argument("unknown comparison " + value);
+
+                options.timesCompared = value == "all";
+            }
+            else
+                throw std::invalid_argument("unknown option " + argument);
+        }
+
+        if (options.threshold < 0)
+            throw std::invalid_argument("the regression threshold cannot be negative");
+
+        if (options.samples < 1)
+            throw std::invalid_argument("benchmarks need at least one sample");
+
+        return options;
+    }
+
+    Suite::Suite(const std::string &p_name, const Options &p_options)
+        :name(p_name), options(p_options) {}
+
+    bool Suite::Selected(const std::string &benchmark) const
+    {
+        return benchmark.find(options.filter) != std::string::npos;
+    }
+
+    void Suite::SetThreshold(double p_threshold)
+    {
+        if (p_threshold < 0)
+            throw std::invalid_argument("the regression threshold cannot be negative");
+
+        threshold = p_threshold;
+    }
+
+    void Suite::Run(const std::string &benchmark, const std::function<void()> &fn, double bytes, double flops)
+    {
+        if (!Selected(benchmark))
+            return;
+
+        auto time = [&fn](std::size_t iterations) {
+            auto start = std::chrono::steady_clock::now();
+
+            for (std::size_t i = 0; i < iterations; i++) {
+                fn();
+            }
+
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        // the first call warms caches and lazily started threads, and the count of calls per sample is grown until a sample is long enough
+        const double sampleSeconds = options.minSeconds / options.samples;
+        std::size_t iterations = 1;
+        double seconds = time(iterations);
+
+        while (seconds < sampleSeconds) {
+            const double growth = seconds > 0 ? std::min(10.0, 1.2 * sampleSeconds / seconds) : 10.0;
+            iterations = std::max(iterations + 1, (std::size_t) (iterations * growth));
+            seconds = time(iterations);
+        }
+
+        std::vector<double> nanoseconds(options.samples);
+        const double allocationsBefore = TotalAllocations();
+
+        for (double &sample : nanoseconds) {
+            sample = time(iterations) * 1e9 / iterations;
+        }
+
+        const double allocationsAfter = TotalAllocations();
+        const double allocations = allocationsBefore < 0 ? -1 : (allocationsAfter - allocationsBefore) / (options.samples * iterations);
+
+        Add(benchmark, nanoseconds, bytes, flops, allocations);
+    }
+
+    void Suite::Add(const std::string &benchmark, std::vector<double> nanoseconds, double bytes, double flops, double allocations)
+    {
+        if (nanoseconds.empty())
+            throw std::invalid_argument("benchmark " + benchmark + " has no samples");
+
+        std::sort(nanoseconds.begin(), nanoseconds.end());
+
+        const std::size_t middle = nanoseconds.size() / 2;
+        const double median = nanoseconds.size() % 2 ? nanoseconds[middle] : (nanoseconds[middle - 1] + nanoseconds[middle]) / 2;
+
+        suiteResults.push_back({benchmark, median, nanoseconds.front(), nanoseconds.back(), nanoseconds.size(), bytes, flops, allocations, threshold});
+    }
+
+    int Suite::Finish(std::ostream &out)
+    {
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+
+        out << std::left << std::setw(48) << name << std::right << std::setw(14) << "median us" << std::setw(14) << "min us"
+            << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s" << std::setw(10) << "allocs" << std::endl;
+
+        out << std::fixed;
+
+        for (const Result &result : suiteResults) {
+            out << std::left << std::setw(48) << result.name << std::right << std::setprecision(3)
+                << std::setw(14) << result.median * 1e-3 << std::setw(14) << result.min * 1e-3 << std::setprecision(2);
+
+            // throughput over the median, as the comparison uses
+            out << std::setw(10);
+
+            if (result.bytes > 0)
+                out << result.bytes / result.median;
+            else
+                out << "";
+
+            out << std::setw(10);
+
+            if (result.flops > 0)
+                out << result.flops / result.median;
+            else
+                out << "";
+
+            out << std::setw(10);
+
+            if (result.allocations >= 0)
+                out << result.allocations;
+            else
+                out << "";
+
+            out << std::endl;
+        }
+
+        out.flags(flags);
+        out.precision(precision);
+
+        if (!options.jsonPath.empty())
+            WriteResults(name, suiteResults, options.jsonPath);
+
+        if (options.baselinePath.empty())
+            return 0;
+
+        return Compare(ReadResults(options.baselinePath), suiteResults, options.threshold, out, options.timesCompared) ? 1 : 0;
+    }
+
+    const std::vector<Result> &Suite::results() const
+    {
+        return suiteResults;
+    }
+
+    void WriteResults(const std::string &suite, const std::vector<Result> &results, const std::string &pathname)
+    {
+        std::ofstream file(pathname, std::ios::trunc);
+
+        if (!file.is_open())
+            throw std::runtime_error("error opening benchmark results at \"" + pathname + "\"");
+
+        file << std::setprecision(9);
+        file << "{" << std::endl << "    \"suite\": \"";
+        WriteEscaped(file, suite);
+        file << "\"," << std::endl << "    \"results\": [";
+
+        for (std::size_t i = 0; i < results.size(); i++) {
+            const Result &result = results[i];
+
+            file << (i ? "," : "") << std::endl << "        {\"name\": \"";
+            WriteEscaped(file, result.name);
+            file << "\", \"median\": " << result.median << ", \"min\": " << result.min << ", \"max\": " << result.max << ", \"samples\": " << result.samples
+                 << ", \"bytes\": " << result.bytes << ", \"flops\": " << result.flops << ", \"allocations\": " << result.allocations;
+
+            if (result.threshold > 0)
+                file << ", \"threshold\": " << result.threshold;
+
+            file << "}";
+        }
+
+        file << std::endl << "    ]" << std::endl << "}" << std::endl;
+
+        if (!file)
+            throw std::runtime_error("error writing benchmark results at \"" + pathname + "\"");
+    }
+
+    std::vector<Result> ReadResults(const std::string &pathname)
+    {
+        std::ifstream file(pathname);
+
+        if (!file.is_open())
+            throw std::runtime_error("error opening benchmark results at \"" + pathname + "\"");
+
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        const std::string text = buffer.str();
+
+        return Reader(text, pathname).ReadResults();
+    }
+
+    std::size_t Compare(const std::vector<Result> &baseline, const std::vector<Result> &results, double threshold, std::ostream &out, bool timesCompared)
+    {
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+        std::size_t regressions = 0;
+
+        out << std::left << std::setw(48) << "compared with baseline" << std::right << std::setw(14) << "baseline us" << std::setw(14) << "median us"
+            << std::setw(10) << "change" << "  status" << std::endl;
+
+        out << std::fixed;
+
+        for (const Result &result : results) {
+            std::vector<Result>::const_iterator base = std::find_if(baseline.begin(), baseline.end(), [&](const Result &b) { return b.name == result.name; });
+
+            out << std::left << std::setw(48) << result.name << std::right << std::setprecision(3);
+
+            if (base == baseline.end()) {
+                out << std::setw(14) << "" << std::setw(14) << result.median * 1e-3 << std::setw(10) << "" << "  new" << std::endl;
+                continue;
+            }
+
+            const double change = result.median / base->median - 1;
+            const double tolerated = base->threshold > 0 ? base->threshold : threshold;
+            const bool slower = timesCompared && change > tolerated;
+            const bool moreAllocations = base->allocations >= 0 && result.allocations > base->allocations;
+
+            out << std::setw(14) << base->median * 1e-3 << std::setw(14) << result.median * 1e-3
+                << std::setprecision(1) << std::setw(9) << change * 100 << "%  ";
+
+            if (slower || moreAllocations) {
+                regressions++;
+                out << (slower ? "regressed" : "") << (slower && moreAllocations ? ", " : "");
+
+                if (moreAllocations)
+                    out << "allocations " << std::setprecision(2) << base->allocations << " -> " << result.allocations;
+            }
+            else if (timesCompared && change < -tolerated)
+                out << "improved";
+            else
+                out << "ok";
+
+            out << std::endl;
+        }
+
+        // benchmarks filtered out of a run are counted without failing it
+        const std::size_t notRun = std::count_if(baseline.begin(), baseline.end(), [&](const Result &base) {
+            return std::none_of(results.begin(), results.end(), [&](const Result &r) { return r.name == base.name; });
+        });
+
+        if (notRun)
+            out << notRun << " benchmarks of the baseline were not run" << std::endl;
+
+        out << regressions << " of " << results.size() << " benchmarks regressed" << std::endl;
+
+        out.flags(flags);
+        out.precision(precision);
+
+        return regressions;
+    }
+
+    double Median(const std::function<void()> &fn, std::size_t iterations)
+    {
+        for (std::size_t i = 0; i < iterations / 10 + 1; i++) {
+            fn();
+        }
+
+        std::vector<double> times(iterations);
+
+        for (std::size_t i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            times[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        std::sort(times.begin(), times.end());
+        return times[iterations / 2];
+    }
+
+    Instances ReadInstances(const Dataset &dataset)
+    {
+        const std::size_t inputSize = dataset.parameterSize();
+        const std::size_t labelSize = dataset.labelSize();
+
+        Instances instances;
+        instances.count = dataset.size();
+        instances.inputSize = inputSize;
+        instances.inputs.resize(instances.count * inputSize);
+        instances.classes.reserve(instances.count);
+
+        DatasetStream stream(dataset);
+        Data chunk(Math::Matrix(inputSize, 1024), Math::Matrix(labelSize, 1024));
+        std::vector<double> label(labelSize);
+
+        // batches are feature-major, each instance being a column
+        for (std::size_t read = 0; std::size_t chunkCount = stream.Read(1024, chunk); read += chunkCount) {
+            for (std::size_t k = 0; k < chunkCount; k++) {
+                for (std::size_t j = 0; j < inputSize; j++) {
+                    instances.inputs[(read + k) * inputSize + j] = chunk.parameters.data()[j * chunkCount + k];
+                }
+
+                for (std::size_t j = 0; j < labelSize; j++) {
+                    label[j] = chunk.label.data()[j * chunkCount + k];
+                }
+
+                instances.classes.push_back(labelSize == 1 ? (std::size_t) label[0] : std::max_element(label.begin(), label.end()) - label.begin());
+            }
+        }
+
+        return instances;
+    }
+}
@@ -1,5 +1,6 @@
 #include <cmath>
 #include <iostream>
+#include <stdexcept>
 
 #include "CostFn.hpp"
 #include "Data.hpp"
@@ -47,7 +48,7 @@ namespace CostFn
             bool truthy = true;
 
             for (unsigned int i = 0; i < pred.rows; i++) {
-                truthy = truthy && abs(pred[i][j] - label[i][j]) < 0.01;
+                truthy = truthy && abs(pred.at(i, j) - label.at(i, j)) < 0.01;
             }
 
             if (truthy)
@@ -59,11 +60,47 @@ namespace CostFn
         return (double) correct / (correct + incorrect);
     };
 
+    double CostFn::cost(const Math::Matrix &pred, const Math::Matrix &label)
+    {
+        if (pred.rows != label.rows || pred.cols != label.cols)
+            throw std::invalid_argument("predictions and labels are not of the same size");
+
+        const double *predValues = pred.data();
+        const double *labelValues = label.data();
+        double total = 0;
+
+        for (unsigned int i = 0; i < pred.rows * pred.cols; i++) {
+            total += fn(predValues[i], labelValues[i]);
+        }
+
+        return total;
+    };
+
     Data CostFn::transformLabels(const Data &data, const NeuralNetwork::Layer &outputLayer)
     {
         return data;
     };
 
+    Id CostFn::id() const
+    {
+        return Id::Default;
+    };
+
+    double L2::fn(double value, double target)
+    {
+        return (value - target) * (value - target);
+    };
+
+    double L2::dx(double value, double target)
+    {
+        return 2 * (value - target);
+    };
+
+    Id L2::id() const
+    {
+        return Id::L2;
+    };
+
     double CrossEntropy::fn(double value, double target)
     {
         if (-std::log(1 - value) > 100)
@@ -93,7 +130,7 @@ namespace CostFn
             bool truthy = true;
 
             for (unsigned int i = 0; i < pred.rows; i++) {
-                truthy = truthy && round(pred[i][j]) == label[i][j];
+                truthy = truthy && round(pred.at(i, j)) == label.at(i, j);
             }
 
             if (truthy)
@@ -105,6 +142,11 @@ namespace CostFn
         return (double) correct / (correct + incorrect);
     };
 
+    Id CrossEntropy::id() const
+    {
+        return Id::CrossEntropy;
+    };
+
     Data SparseCategoricalCrossEntropy::transformLabels(const Data &data, const NeuralNetwork::Layer &outputLayer)
     {
         if (data.label.rows != 1)
@@ -122,9 +164,29 @@ namespace CostFn
             label.at(data.label[0][i], i) = 1;
         }
 
+        if (data.sparse)
+            return Data(data.sparseParameters, label);
+
         return Data(data.parameters, label);
     };
 
+    double SparseCategoricalCrossEntropy::cost(const Math::Matrix &pred, const Math::Matrix &label)
+    {
+        if (label.rows != 1 || label.cols != pred.cols)
+            throw std::invalid_argument("data must have scalar label");
+
+        double total = 0;
+
+        // equivalent to the cost against one-hot labels, without building them
+        for (unsigned int j = 0; j < pred.cols; j++) {
+            for (unsigned int i = 0; i < pred.rows; i++) {
+                total += fn(pred.at(i, j), i == label.at(0, j) ? 1 : 0);
+            }
+        }
+
+        return total;
+    };
+
     double SparseCategoricalCrossEntropy::evaluate(const Math::Matrix &pred, const Math::Matrix &label)
     {
         int correct = 0;
@@ -134,13 +196,13 @@ namespace CostFn
             int maxIndex = 0;
 
             for (unsigned int i = 1; i < pred.rows; i++) {
-                if (pred[i][j] > pred[maxIndex][j])
+                if (pred.at(i, j) > pred.at(maxIndex, j))
                 {
                     maxIndex = i;
                 }
             }
 
-            if (maxIndex == label[0][j])
+            if (maxIndex == label.at(0, j))
                 correct++;
             else
                 incorrect++;
@@ -148,5 +210,25 @@ namespace CostFn
 
         return (double) correct / (correct + incorrect);
     };
-}
 
+    Id SparseCategoricalCrossEntropy::id() const
+    {
+        return Id::SparseCategoricalCrossEntropy;
+    };
+
+    CostFn* Create(Id id)
+    {
+        switch (id) {
+        case Id::Default:
+            return new CostFn();
+        case Id::L2:
+            return new L2();
+        case Id::CrossEntropy:
+            return new CrossEntropy();
+        case Id::SparseCategoricalCrossEntropy:
+            return new SparseCategoricalCrossEntropy();
+        }
+
+        throw std::invalid_argument("unknown cost function");
+    };
+}
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CsvReader.hpp"
+#include "Dataset.hpp"
+#include "MappedFile.hpp"
+#include "TaskGraph.hpp"
+#include "Threadpool.hpp"
+
+namespace
+{
+    // Chunks are at least this large, so small files are not split into more tasks than they are worth
+    const std::size_t MIN_CHUNK_SIZE = 1 << 16;
+
+    // Powers of ten exactly representable as doubles
+    const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    inline bool IsDigit(char c)
+    {
+        return (unsigned char)(c - '0') < 10;
+    }
+
+    inline bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    /**
+     * Finds the start of the line after the cursor
+     */
+    inline const char *NextLine(const char *cursor, const char *end)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+        return newline ? newline + 1 : end;
+    }
+
+    /**
+     * Whether the line at the cursor is empty, such lines are skipped rather than read as rows
+     */
+    inline bool IsEmptyLine(const char *cursor, const char *end)
+    {
+        return cursor < end && (*cursor == '\n' || (*cursor == '\r' && (cursor + 1 == end || cursor[1] == '\n')));
+    }
+
+    /**
+     * Parses a decimal number, falling back to strtod only when the fast path cannot be exact
+     * @param cursor start of the number, leading and trailing blanks are skipped
+     * @param end end of the text
+     * @param value parsed number
+     * @returns the first character after the number
+     */
+    const char *ParseNumber(const char *cursor, const char *end, double &value)
+    {
+        while (cursor < end && IsBlank(*cursor))
+            cursor++;
+
+        const char *start = cursor;
+        bool negative = false;
+
+        if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+            negative = *cursor == '-';
+            cursor++;
+        }
+
+        std::uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+
+        while (cursor < end && IsDigit(*cursor)) {
+            mantissa = mantissa * 10 + (*cursor - '0');
+            digits++;
+            cursor++;
+        }
+
+        if (cursor < end && *cursor == '.') {
+            cursor++;
+
+            while (cursor < end && IsDigit(*cursor)) {
+                mantissa = mantissa * 10 + (*cursor - '0');
+                digits++;
+                exponent--;
+                cursor++;
+            }
+        }
+
+        if (digits == 0)
+            throw std::invalid_argument("expected a number");
+
+        if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+            cursor++;
+            bool negativeExponent = false;
+
+            if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+                negativeExponent = *cursor == '-';
+                cursor++;
+            }
+
+            if (cursor >= end || !IsDigit(*cursor))
+                throw std::invalid_argument("expected an exponent");
+
+            int exponentValue = 0;
+
+            while (cursor < end && IsDigit(*cursor)) {
+                exponentValue = std::min(exponentValue * 10 + (*cursor - '0'), 100000);
+                cursor++;
+            }
+
+            exponent += negativeExponent ? -exponentValue : exponentValue;
+        }
+
+        // Exact when the mantissa fits a double and the power of ten is exact, which covers nearly all csv data
+        if (digits <= 15 && exponent >= -22 && exponent <= 22) {
+            value = exponent < 0 ? mantissa / POWERS_OF_TEN[-exponent] : mantissa * POWERS_OF_TEN[exponent];
+        }
+        else {
+            std::string token(start, cursor);
+            value = std::strtod(token.c_str(), nullptr);
+            negative = false;
+        }
+
+        if (negative)
+            value = -value;
+
+        while (cursor < end && IsBlank(*cursor))
+            cursor++;
+
+        return cursor;
+    }
+}
+
+CsvReader::CsvReader(CsvOptions p_options)
+    : options(p_options), columnCount(0), parameterCount(0)
+{
+    if (options.labelColumns.empty())
+        throw std::invalid_argument("csv must have at least one label column");
+
+    if (options.delimiter == '\n' || options.delimiter == '\r' || options.delimiter == '.' || options.delimiter == '-' || IsDigit(options.delimiter))
+        throw std::invalid_argument("invalid csv delimiter");
+}
+
+void CsvReader::SetColumnCount(std::size_t count)
+{
+    columnCount = count;
+    parameterSlots = std::vector<std::int32_t>(count, -1);
+    labelSlots = std::vector<std::int32_t>(count, -1);
+
+    for (std::size_t i = 0; i < options.labelColumns.size(); i++) {
+        if (options.labelColumns[i] >= count)
+            throw std::invalid_argument("label column out of range");
+
+        labelSlots[options.labelColumns[i]] = i;
+    }
+
+    if (options.parameterColumns.empty()) {
+        parameterCount = 0;
+
+        for (std::size_t column = 0; column < count; column++) {
+            if (labelSlots[column] < 0)
+                parameterSlots[column] = parameterCount++;
+        }
+    }
+    else {
+        for (std::size_t i = 0; i < options.parameterColumns.size(); i++) {
+            if (options.parameterColumns[i] >= count)
+                throw std::invalid_argument("parameter column out of range");
+
+            parameterSlots[options.parameterColumns[i]] = i;
+        }
+
+        parameterCount = options.parameterColumns.size();
+    }
+
+    if (parameterCount == 0)
+        throw std::invalid_argument("csv must have at least one parameter column");
+}
+
+std::size_t CsvReader::CountColumns(const char *cursor, const char *end) const
+{
+    const char *lineEnd = NextLine(cursor, end);
+    return std::count(cursor, lineEnd, options.delimiter) + 1;
+}
+
+const char *CsvReader::SkipHeader(const char *begin, const char *end) const
+{
+    return options.hasHeader ? NextLine(begin, end) : begin;
+}
+
+const char *CsvReader::ParseRow(const char *cursor, const char *end, double *parameters, double *labels) const
+{
+    for (std::size_t column = 0; column < columnCount; column++) {
+        if (column > 0) {
+            if (cursor >= end || *cursor != options.delimiter)
+                throw std::invalid_argument("row has fewer columns than expected");
+
+            cursor++;
+        }
+
+        const std::int32_t parameterSlot = parameterSlots[column];
+        const std::int32_t labelSlot = labelSlots[column];
+
+        // Unused columns are skipped without parsing
+        if (parameterSlot < 0 && labelSlot < 0) {
+            while (cursor < end && *cursor != options.delimiter && *cursor != '\n' && *cursor != '\r')
+                cursor++;
+
+            continue;
+        }
+
+        double value;
+        cursor = ParseNumber(cursor, end, value);
+
+        if (parameterSlot >= 0)
+            parameters[parameterSlot] = value * options.scale + options.offset;
+
+        if (labelSlot >= 0)
+            labels[labelSlot] = value;
+    }
+
+    if (cursor < end && *cursor == '\r')
+        cursor++;
+
+    if (cursor < end && *cursor != '\n')
+        throw std::invalid_argument("row has more columns than expected");
+
+    return cursor < end ? cursor + 1 : end;
+}
+
+Dataset CsvReader::Read(const std::string &pathname) const
+{
+    MappedFile file(pathname);
+    file.AdviseSequential();
+
+    try
+    {
+        return Parse(file.data(), file.data() + file.size());
+    }
+    catch (const std::invalid_argument &error)
+    {
+        throw std::invalid_argument("error reading csv at \"" + pathname + "\": " + error.what());
+    }
+}
+
+Dataset CsvReader::Parse(const char *begin, const char *end) const
+{
+    const char *dataBegin = SkipHeader(begin, end);
+
+    while (IsEmptyLine(dataBegin, end))
+        dataBegin = NextLine(dataBegin, end);
+
+    if (dataBegin >= end)
+        throw std::invalid_argument("csv has no rows");
+
+    CsvReader reader = *this;
+    reader.SetColumnCount(CountColumns(dataBegin, end));
+
+    ThreadPool pool;
+
+    // Chunk boundaries are moved forward to the start of a line, so every row belongs to exactly one chunk
+    const std::size_t length = end - dataBegin;
+    const std::size_t chunkCount = std::max<std::size_t>(1, std::min(pool.poolSize() * 4, length / MIN_CHUNK_SIZE));
+    std::vector<const char *> boundaries = {dataBegin};
+
+    for (std::size_t i = 1; i < chunkCount; i++) {
+        const char *boundary = std::max(boundaries.back(), dataBegin + length * i / chunkCount);
+
+        if (boundary != dataBegin && boundary[-1] != '\n')
+            boundary = NextLine(boundary, end);
+
+        boundaries.push_back(boundary);
+    }
+
+    boundaries.push_back(end);
+
+    // First pass counts the rows of each chunk to know where each chunk is written
+    std::vector<std::size_t> rowCounts(chunkCount, 0);
+    TaskGraph countGraph;
+
+    for (std::size_t i = 0; i < chunkCount; i++) {
+        countGraph.AddTask([&, i] {
+            std::size_t count = 0;
+
+            for (const char *cursor = boundaries[i]; cursor < boundaries[i + 1]; cursor = NextLine(cursor, boundaries[i + 1])) {
+                if (!IsEmptyLine(cursor, boundaries[i + 1]))
+                    count++;
+            }
+
+            rowCounts[i] = count;
+        });
+    }
+
+    countGraph.Run(pool);
+
+    std::vector<std::size_t> firstRows(chunkCount, 0);
+    std::size_t totalRows = 0;
+
+    for (std::size_t i = 0; i < chunkCount; i++) {
+        firstRows[i] = totalRows;
+        totalRows += rowCounts[i];
+    }
+
+    if (options.maxRows && totalRows > options.maxRows)
+        totalRows = options.maxRows;
+
+    Dataset dataset(totalRows, reader.parameterSize(), reader.labelSize());
+
+    // Second pass parses every chunk straight into the dataset storage
+    TaskGraph parseGraph;
+
+    for (std::size_t i = 0; i < chunkCount && firstRows[i] < totalRows; i++) {
+        parseGraph.AddTask([&, i] {
+            std::size_t row = firstRows[i];
+            const std::size_t lastRow = std::min(firstRows[i] + rowCounts[i], totalRows);
+            const char *cursor = boundaries[i];
+
+            try
+            {
+                while (row < lastRow) {
+                    if (IsEmptyLine(cursor, boundaries[i + 1])) {
+                        cursor = NextLine(cursor, boundaries[i + 1]);
+                        continue;
+                    }
+
+                    cursor = reader.ParseRow(cursor, boundaries[i + 1], dataset.Parameters(row), dataset.Labels(row));
+                    row++;
+                }
+            }
+            catch (const std::invalid_argument &error)
+            {
+                throw std::invalid_argument("row " + std::to_string(row + 1) + ": " + error.what());
+            }
+        });
+    }
+
+    parseGraph.Run(pool);
+
+    return dataset;
+}
+
+std::size_t CsvReader::parameterSize() const
+{
+    return parameterCount;
+}
+
+std::size_t CsvReader::labelSize() const
+{
+    return options.labelColumns.size();
+}
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CsvReader.hpp"
+#include "CsvStream.hpp"
+#include "Data.hpp"
+
+CsvStream::CsvStream(const std::string &p_pathname, CsvOptions p_options, std::size_t bufferSize)
+    : pathname(p_pathname), options(p_options), reader(p_options), buffer(std::max<std::size_t>(bufferSize, 1 << 12))
+{
+    Reset();
+
+    const char *lineEnd = NextLine();
+
+    if (!lineEnd)
+        throw std::invalid_argument("error reading csv at \"" + pathname + "\": csv has no rows");
+
+    reader.SetColumnCount(reader.CountColumns(buffer.data() + bufferStart, lineEnd));
+}
+
+std::size_t CsvStream::parameterSize() const
+{
+    return reader.parameterSize();
+}
+
+std::size_t CsvStream::labelSize() const
+{
+    return reader.labelSize();
+}
+
+void CsvStream::Reset()
+{
+    file.close();
+    file.clear();
+    file.open(pathname, std::ios::binary);
+
+    if (!file.is_open())
+        throw std::runtime_error("error opening file at \"" + pathname + "\"");
+
+    bufferStart = 0;
+    bufferEnd = 0;
+    fileEnded = false;
+    rowCount = 0;
+
+    if (options.hasHeader) {
+        const char *lineEnd = NextLine();
+
+        if (lineEnd)
+            bufferStart = lineEnd - buffer.data();
+    }
+}
+
+const char *CsvStream::NextLine()
+{
+    while (true) {
+        // Empty lines are skipped rather than read as rows
+        while (bufferStart < bufferEnd && (buffer[bufferStart] == '\n' || buffer[bufferStart] == '\r')) {
+            if (buffer[bufferStart] == '\r' && bufferStart + 1 == bufferEnd && !fileEnded)
+                break;
+
+            bufferStart++;
+        }
+
+        const char *begin = buffer.data() + bufferStart;
+        const char *newline = static_cast<const char *>(std::memchr(begin, '\n', bufferEnd - bufferStart));
+
+        if (newline)
+            return newline + 1;
+
+        if (fileEnded)
+            return bufferStart < bufferEnd ? buffer.data() + bufferEnd : nullptr;
+
+        // Moves the partial line to the front of the buffer, growing it when the line fills the whole buffer
+        std::memmove(buffer.data(), begin, bufferEnd - bufferStart);
+        bufferEnd -= bufferStart;
+        bufferStart = 0;
+
+        if (bufferEnd == buffer.size())
+            buffer.resize(buffer.size() * 2);
+
+        file.read(buffer.data() + bufferEnd, buffer.size() - bufferEnd);
+        bufferEnd += file.gcount();
+
+        if (file.eof())
+            fileEnded = true;
+        else if (!file)
+            throw std::runtime_error("error reading csv at \"" + pathname + "\"");
+    }
+}
+
+std::size_t CsvStream::Read(std::size_t count, Data &batch)
+{
+    const std::size_t instanceSize = reader.parameterSize() + reader.labelSize();
+
+    if (options.maxRows)
+        count = std::min(count, options.maxRows - std::min(rowCount, options.maxRows));
+
+    if (instances.size() < count * instanceSize)
+        instances.resize(count * instanceSize);
+
+    std::size_t read = 0;
+
+    for (; read < count; read++) {
+        const char *lineEnd = NextLine();
+
+        if (!lineEnd)
+            break;
+
+        double *instance = instances.data() + read * instanceSize;
+
+        try
+        {
+            const char *next = reader.ParseRow(buffer.data() + bufferStart, lineEnd, instance, instance + reader.parameterSize());
+            bufferStart = next - buffer.data();
+        }
+        catch (const std::invalid_argument &error)
+        {
+            throw std::invalid_argument("error reading csv at \"" + pathname + "\": row " + std::to_string(rowCount + 1) + ": " + error.what());
+        }
+
+        rowCount++;
+    }
+
+    if (read)
+        WriteBatch(instances.data(), read, batch);
+
+    return read;
+}
+
+bool CsvStream::AtEnd()
+{
+    return (options.maxRows && rowCount >= options.maxRows) || !NextLine();
+}
+
+std::unique_ptr<DataStream> CsvStream::Reopen() const
+{
+    return std::unique_ptr<DataStream>(new CsvStream(pathname, options, buffer.size()));
+}
@@ -1,34 +1,45 @@
 #include <vector>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <chrono>
 #include <random>
 #include <algorithm>
 
 #include "Data.hpp"
+#include "Dataset.hpp"
 #include "Matrix.hpp"
+#include "Profiler.hpp"
 #include "Vector.hpp"
 
 Data::Data(std::vector<double> p_parameters, double p_label)
-    : parameters(Math::Vector(p_parameters)), label(Math::Vector(1, p_label, false)), parameterSize(p_parameters.size()), labelSize(1), dataInstanceCount(1) {}
+    : parameters(Math::Vector(p_parameters)), label(Math::Vector(1, p_label, false)), sparse(false), parameterSize(p_parameters.size()), labelSize(1), dataInstanceCount(1) {}
 
 Data::Data(std::vector<double> p_parameters, std::vector<double> p_label)
-    : parameters(Math::Vector(p_parameters)), label(Math::Vector(p_label)), parameterSize(p_parameters.size()), labelSize(p_label.size()), dataInstanceCount(1) {}
+    : parameters(Math::Vector(p_parameters)), label(Math::Vector(p_label)), sparse(false), parameterSize(p_parameters.size()), labelSize(p_label.size()), dataInstanceCount(1) {}
 
 Data::Data(Math::Matrix p_parameters, Math::Matrix p_labels)
-    : parameters(p_parameters), label(p_labels), parameterSize(p_parameters.cols), labelSize(p_labels.rows), dataInstanceCount(p_parameters.cols)
+    : parameters(p_parameters), label(p_labels), sparse(false), parameterSize(p_parameters.rows), labelSize(p_labels.rows), dataInstanceCount(p_parameters.cols)
 {
     if (parameters.cols != p_labels.cols)
         throw std::invalid_argument("number of labels does match number of rows");   
 };
 
-Data::Data(std::vector<Data> data)
-    : parameters(Math::Matrix(1, 1)), label(Math::Vector(1)), parameterSize(data[0].parameters.rows), labelSize(data[0].label.rows), dataInstanceCount(data.size())
+Data::Data(Math::SparseMatrix p_parameters, Math::Matrix p_labels)
+    : parameters(Math::Matrix(1, 1)), label(p_labels), sparseParameters(p_parameters), sparse(true), parameterSize(p_parameters.cols), labelSize(p_labels.rows), dataInstanceCount(p_parameters.rows)
 {
+    if (p_parameters.rows != p_labels.cols)
+        throw std::invalid_argument("number of labels does match number of rows");
+};
+
+Data::Data(const std::vector<Data> &data)
+    : parameters(Math::Matrix(1, 1)), label(Math::Vector(1)), sparse(false), parameterSize(data[0].parameters.rows), labelSize(data[0].label.rows), dataInstanceCount(data.size())
+{
+    NN_PROFILE_SCOPE("Data::Data (batch)", 0, 0);
+
     if (data.size() == 0)
         throw std::invalid_argument("data vector cannot be empty");
 
-    for (auto entry : data) {
+    for (const auto &entry : data) {
         if (entry.parameters.rows != parameterSize)
             throw std::invalid_argument("data sizes do not match");
 
@@ -96,44 +107,5 @@ Data::TrainTestPartition Data::LoadMNIST(std::size_t maxDataSize)
 
 std::vector<Data> Data::ReadMNISTFile(std::string pathname, std::size_t maxDataSize)
 {
-    std::ifstream file(pathname);
-
-    if (!file.is_open())
-        throw std::runtime_error("error opening MNIST csv at \"" + pathname + "\"");
-
-    std::string line;
-    std::vector<Data> data;
-
-    // throw out first line since they are just csv titles
-    std::getline(file, line);
-
-    while (std::getline(file, line)) {
-        std::vector<double> params;
-        size_t pos = 0;
-        std::string token;
-
-        while ((pos = line.find(',')) != std::string::npos) {
-            token = line.substr(0, pos);
-            params.push_back(std::stoi(token));
-            line.erase(0, pos + 1);
-        }
-
-        params.push_back(std::stoi(line));
-
-        int label = params[0];
-        params.erase(params.begin());
-
-        for (double &num : params) {
-            num /= 255;
-        }
-
-        data.push_back(Data(params, label));
-
-        if (data.size() >= maxDataSize)
-            break;
-    }
-
-    file.close();
-
-    return data;
+    return Dataset::ReadMNISTFile(pathname, maxDataSize).ToVector();
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include <stdexcept>
+
+#include "DataStream.hpp"
+#include "Data.hpp"
+#include "Matrix.hpp"
+
+void DataStream::WriteBatch(const double *instances, std::size_t count, Data &batch) const
+{
+    const std::size_t parameters = parameterSize();
+    const std::size_t labels = labelSize();
+
+    if (batch.parameterSize != parameters || batch.labelSize != labels)
+        throw std::invalid_argument("batch dimensions do not match the stream");
+
+    if (batch.dataInstanceCount != count) {
+        batch.parameters.Resize(parameters, count);
+        batch.label.Resize(labels, count);
+        batch.dataInstanceCount = count;
+    }
+
+    double *parameterValues = batch.parameters.data();
+    double *labelValues = batch.label.data();
+
+    for (std::size_t k = 0; k < count; k++) {
+        const double *instance = instances + k * (parameters + labels);
+
+        for (std::size_t j = 0; j < parameters; j++) {
+            parameterValues[j * count + k] = instance[j];
+        }
+
+        for (std::size_t j = 0; j < labels; j++) {
+            labelValues[j * count + k] = instance[parameters + j];
+        }
+    }
+}
@@ -0,0 +1,858 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "AlignedBuffer.hpp"
+#include "CsvReader.hpp"
+#include "Data.hpp"
+#include "Dataset.hpp"
+#include "MappedFile.hpp"
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+
+namespace
+{
+    // Instances gathered per pass, each pass writes a contiguous run of every row of the batch
+    const std::size_t GATHER_TILE = 16;
+
+    /**
+     * Gathers rows of a sample-major block of doubles into the columns of a row-major batch, without conversion
+     * @param source start of the sample-major block
+     * @param stride distance between consecutive rows of the block
+     * @param rows rows of the block to gather, at most `GATHER_TILE`
+     * @param tile number of rows to gather
+     * @param width number of values in each row
+     * @param destination first column to write into
+     * @param destinationStride distance between consecutive rows of the batch
+     * @param indexable whether every offset into the block fits a 32 bit gather index
+     */
+    void GatherTile(const double *source, std::size_t stride, const std::uint32_t *rows, std::size_t tile, std::size_t width, double *destination, std::size_t destinationStride, bool indexable)
+    {
+#ifdef __AVX2__
+        if (tile == GATHER_TILE && indexable) {
+            __m128i offsets[GATHER_TILE / 4];
+
+            for (std::size_t g = 0; g < GATHER_TILE / 4; g++) {
+                offsets[g] = _mm_setr_epi32(rows[4 * g] * stride, rows[4 * g + 1] * stride, rows[4 * g + 2] * stride, rows[4 * g + 3] * stride);
+            }
+
+            for (std::size_t j = 0; j < width; j++) {
+                double *out = destination + j * destinationStride;
+
+                for (std::size_t g = 0; g < GATHER_TILE / 4; g++) {
+                    _mm256_storeu_pd(out + 4 * g, _mm256_i32gather_pd(source + j, offsets[g], sizeof(double)));
+                }
+            }
+
+            return;
+        }
+#endif
+        const double *rowPointers[GATHER_TILE];
+
+        for (std::size_t k = 0; k < tile; k++) {
+            rowPointers[k] = source + rows[k] * stride;
+        }
+
+        for (std::size_t j = 0; j < width; j++) {
+            double *out = destination + j * destinationStride;
+
+            for (std::size_t k = 0; k < tile; k++) {
+                out[k] = rowPointers[k][j];
+            }
+        }
+    }
+
+    /**
+     * Gathers rows of a sample-major block into the columns of a row-major batch, converting each value to `value * scale + offset`
+     */
+    template <typename T>
+    void GatherTile(const T *source, std::size_t stride, const std::uint32_t *rows, std::size_t tile, std::size_t width, double *destination, std::size_t destinationStride, double scale, double offset)
+    {
+        const T *rowPointers[GATHER_TILE];
+
+        for (std::size_t k = 0; k < tile; k++) {
+            rowPointers[k] = source + rows[k] * stride;
+        }
+
+        for (std::size_t j = 0; j < width; j++) {
+            double *out = destination + j * destinationStride;
+
+            for (std::size_t k = 0; k < tile; k++) {
+                out[k] = rowPointers[k][j] * scale + offset;
+            }
+        }
+    }
+
+    /**
+     * Gathers rows of a sample-major block into the columns of a row-major batch, dequantizing each value to `value * scales[j] + offsets[j]`
+     */
+    template <typename T>
+    void GatherTile(const T *source, std::size_t stride, const std::uint32_t *rows, std::size_t tile, std::size_t width, double *destination, std::size_t destinationStride, const double *scales, const double *offsets)
+    {
+        const T *rowPointers[GATHER_TILE];
+
+        for (std::size_t k = 0; k < tile; k++) {
+            rowPointers[k] = source + rows[k] * stride;
+        }
+
+        for (std::size_t j = 0; j < width; j++) {
+            double *out = destination + j * destinationStride;
+            const double scale = scales[j];
+            const double offset = offsets[j];
+
+            for (std::size_t k = 0; k < tile; k++) {
+                out[k] = rowPointers[k][j] * scale + offset;
+            }
+        }
+    }
+
+    /**
+     * Gathers a tile from a block of a given stored type
+     */
+    template <typename T>
+    void GatherTile(const unsigned char *source, std::size_t stride, const std::uint32_t *rows, std::size_t tile, std::size_t width, double *destination, std::size_t destinationStride, double scale, double offset, const double *scales, const double *offsets)
+    {
+        if (scales)
+            GatherTile(reinterpret_cast<const T *>(source), stride, rows, tile, width, destination, destinationStride, scales, offsets);
+        else
+            GatherTile(reinterpret_cast<const T *>(source), stride, rows, tile, width, destination, destinationStride, scale, offset);
+    }
+
+    /**
+     * Gathers a tile from a block of any stored type
+     * @param scales per-value scales, or nullptr to use `scale` and `offset` for every value
+     * @param offsets per-value offsets
+     */
+    void GatherTile(Dataset::DType type, const unsigned char *source, std::size_t stride, const std::uint32_t *rows, std::size_t tile, std::size_t width, double *destination, std::size_t destinationStride, double scale, double offset, const double *scales, const double *offsets, bool indexable)
+    {
+        switch (type) {
+        case Dataset::DType::Float64:
+            if (!scales && scale == 1 && offset == 0)
+                GatherTile(reinterpret_cast<const double *>(source), stride, rows, tile, width, destination, destinationStride, indexable);
+            else
+                GatherTile<double>(source, stride, rows, tile, width, destination, destinationStride, scale, offset, scales, offsets);
+            break;
+        case Dataset::DType::UInt8:
+            GatherTile<std::uint8_t>(source, stride, rows, tile, width, destination, destinationStride, scale, offset, scales, offsets);
+            break;
+        case Dataset::DType::UInt16:
+            GatherTile<std::uint16_t>(source, stride, rows, tile, width, destination, destinationStride, scale, offset, scales, offsets);
+            break;
+        }
+    }
+
+    /**
+     * Quantizes a row-major batch into consecutive sample-major rows of a dataset
+     */
+    template <typename T>
+    void QuantizeBatch(const Math::Matrix &parameters, Dataset &quantized, std::size_t start, const std::vector<double> &scales, const std::vector<double> &offsets, double levels)
+    {
+        const double *values = parameters.data();
+
+        for (std::size_t k = 0; k < parameters.cols; k++) {
+            T *row = static_cast<T *>(quantized.ParameterData(start + k));
+
+            for (std::size_t j = 0; j < parameters.rows; j++) {
+                double level = std::round((values[j * parameters.cols + k] - offsets[j]) / scales[j]);
+                row[j] = static_cast<T>(std::min(std::max(level, 0.0), levels));
+            }
+        }
+    }
+
+    /**
+     * Dimensions of an IDX file and where its values start
+     */
+    struct IdxHeader
+    {
+        std::vector<std::size_t> dimensions;
+        std::size_t dataOffset;
+    };
+
+    IdxHeader ReadIdxHeader(const MappedFile &file, const std::string &pathname)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(file.data());
+
+        if (file.size() < 4 || bytes[0] != 0 || bytes[1] != 0)
+            throw std::runtime_error("\"" + pathname + "\" is not an IDX file");
+
+        if (bytes[2] != 0x08)
+            throw std::runtime_error("only unsigned byte IDX files are supported, \"" + pathname + "\" is not one");
+
+        IdxHeader header;
+        header.dataOffset = 4 + 4 * bytes[3];
+
+        if (bytes[3] == 0 || file.size() < header.dataOffset)
+            throw std::runtime_error("IDX file at \"" + pathname + "\" has an invalid header");
+
+        std::size_t valueCount = 1;
+
+        // dimensions are stored as big endian 32 bit integers
+        for (std::size_t i = 0; i < bytes[3]; i++) {
+            const unsigned char *dimension = bytes + 4 + 4 * i;
+            header.dimensions.push_back(((std::size_t)dimension[0] << 24) | (dimension[1] << 16) | (dimension[2] << 8) | dimension[3]);
+            valueCount *= header.dimensions.back();
+        }
+
+        if (file.size() < header.dataOffset + valueCount)
+            throw std::runtime_error("IDX file at \"" + pathname + "\" is truncated");
+
+        return header;
+    }
+
+    /**
+     * Keeps both mappings of an IDX dataset alive
+     */
+    struct IdxFiles
+    {
+        MappedFile images;
+        MappedFile labels;
+
+        IdxFiles(const std::string &imagesPathname, const std::string &labelsPathname)
+            : images(imagesPathname), labels(labelsPathname) {}
+    };
+
+    const char DATASET_FILE_MAGIC[8] = {'N', 'N', 'D', 'A', 'T', 'A', 'S', 'T'};
+    // Version 2 appended per-parameter normalization, version 1 files are still read
+    const std::uint32_t DATASET_FILE_VERSION = 2;
+    const std::uint32_t DATASET_FILE_VERSION_1_HEADER_SIZE = 88;
+
+    // Blocks start on page boundaries so the mapped storage is page aligned
+    const std::size_t DATASET_FILE_ALIGNMENT = 4096;
+
+    /**
+     * Header at the start of a binary dataset file, values are stored little endian
+     */
+    struct DatasetFileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t headerSize;
+        std::uint8_t parameterType;
+        std::uint8_t labelType;
+        std::uint8_t reserved[6];
+        std::uint64_t count;
+        std::uint64_t parameterSize;
+        std::uint64_t labelSize;
+        std::uint64_t parameterStride;  // In values, rows are padded so every instance starts 64 byte aligned
+        double scale;
+        double offset;
+        std::uint64_t parameterOffset;  // In bytes from the start of the file
+        std::uint64_t labelOffset;
+        std::uint64_t featureNormalizationOffset;   // Per-parameter scales then offsets, or 0 when normalization is scalar
+    };
+
+    bool FileExists(const std::string &pathname)
+    {
+        return std::ifstream(pathname).good();
+    }
+
+    /**
+     * Check that count * size values of elementSize bytes starting at offset lie within a file of fileSize bytes,
+     * dividing instead of multiplying so a crafted header can't wrap the byte count around
+     */
+    bool FitsInFile(std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::uint64_t elementSize, std::uint64_t fileSize)
+    {
+        if (offset > fileSize)
+            return false;
+
+        const std::uint64_t available = (fileSize - offset) / elementSize;
+
+        return size == 0 || count <= available / size;
+    }
+}
+
+Dataset::Dataset(std::size_t count, std::size_t p_parameterSize, std::size_t p_labelSize, DType parameterType, DType labelType)
+    : parameterCount(p_parameterSize), labelCount(p_labelSize), parameterDType(parameterType), labelDType(labelType)
+{
+    if (count < 1 || parameterCount < 1 || labelCount < 1)
+        throw std::invalid_argument("dataset dimensions must be positive");
+
+    Allocate(count);
+}
+
+Dataset::Dataset(const std::vector<Data> &data)
+    : parameterDType(DType::Float64), labelDType(DType::Float64)
+{
+    if (data.size() == 0)
+        throw std::invalid_argument("data vector cannot be empty");
+
+    parameterCount = data[0].parameters.rows;
+    labelCount = data[0].label.rows;
+
+    for (const auto &entry : data) {
+        if (entry.parameters.rows != parameterCount)
+            throw std::invalid_argument("data sizes do not match");
+
+        if (entry.label.rows != labelCount)
+            throw std::invalid_argument("label sizes do not match");
+
+        if (entry.parameters.cols != 1 || entry.label.cols != 1)
+            throw std::invalid_argument("only singular instances of data can be used to construct dataset");
+    }
+
+    Allocate(data.size());
+
+    for (std::size_t i = 0; i < data.size(); i++) {
+        std::memcpy(Parameters(i), data[i].parameters.data(), parameterCount * sizeof(double));
+        std::memcpy(Labels(i), data[i].label.data(), labelCount * sizeof(double));
+    }
+}
+
+Dataset Dataset::Wrap(std::shared_ptr<const void> owner, const void *parameters, const void *labels, std::size_t count, std::size_t p_parameterSize, std::size_t p_labelSize, DType parameterType, DType labelType, std::size_t p_parameterStride)
+{
+    if (count < 1 || p_parameterSize < 1 || p_labelSize < 1)
+        throw std::invalid_argument("dataset dimensions must be positive");
+
+    if (count > std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("dataset cannot hold more than 2^32 instances");
+
+    Dataset dataset;
+    dataset.parameterStorage = owner;
+    dataset.labelStorage = owner;
+    dataset.parameterData = static_cast<const unsigned char *>(parameters);
+    dataset.labelData = static_cast<const unsigned char *>(labels);
+    dataset.parameterCount = p_parameterSize;
+    dataset.labelCount = p_labelSize;
+    dataset.parameterDType = parameterType;
+    dataset.labelDType = labelType;
+    dataset.parameterStride = p_parameterStride ? p_parameterStride : p_parameterSize;
+    dataset.labelStride = p_labelSize;
+    dataset.storedCount = count;
+    dataset.indices = std::vector<std::uint32_t>(count);
+    std::iota(dataset.indices.begin(), dataset.indices.end(), 0);
+
+    return dataset;
+}
+
+void Dataset::Allocate(std::size_t count)
+{
+    if (count > std::numeric_limits<std::uint32_t>::max())
+        throw std::invalid_argument("dataset cannot hold more than 2^32 instances");
+
+    const std::size_t alignment = 64;
+
+    parameterStride = AlignedBuffer::AlignUp(parameterCount * SizeOf(parameterDType), alignment) / SizeOf(parameterDType);
+    labelStride = labelCount;
+    storedCount = count;
+
+    std::size_t parameterBytes = count * parameterStride * SizeOf(parameterDType);
+    std::size_t labelBytes = AlignedBuffer::AlignUp(count * labelStride * SizeOf(labelDType), alignment);
+
+    std::shared_ptr<AlignedBuffer> buffer = std::make_shared<AlignedBuffer>(parameterBytes + labelBytes, alignment);
+    parameterStorage = buffer;
+    labelStorage = buffer;
+    parameterData = static_cast<const unsigned char *>(buffer->data());
+    labelData = parameterData + parameterBytes;
+
+    indices = std::vector<std::uint32_t>(count);
+    std::iota(indices.begin(), indices.end(), 0);
+}
+
+std::size_t Dataset::size() const
+{
+    return indices.size();
+}
+
+std::size_t Dataset::parameterSize() const
+{
+    return parameterCount;
+}
+
+std::size_t Dataset::labelSize() const
+{
+    return labelCount;
+}
+
+Dataset::DType Dataset::parameterType() const
+{
+    return parameterDType;
+}
+
+Dataset::DType Dataset::labelType() const
+{
+    return labelDType;
+}
+
+std::size_t Dataset::SizeOf(DType type)
+{
+    switch (type) {
+    case DType::Float64:
+        return sizeof(double);
+    case DType::UInt8:
+        return sizeof(std::uint8_t);
+    case DType::UInt16:
+        return sizeof(std::uint16_t);
+    }
+
+    throw std::invalid_argument("unknown dataset type");
+}
+
+double *Dataset::Parameters(std::size_t i)
+{
+    if (parameterDType != DType::Float64)
+        throw std::runtime_error("dataset parameters are not stored as doubles");
+
+    return static_cast<double *>(ParameterData(i));
+}
+
+const double *Dataset::Parameters(std::size_t i) const
+{
+    if (parameterDType != DType::Float64)
+        throw std::runtime_error("dataset parameters are not stored as doubles");
+
+    return static_cast<const double *>(ParameterData(i));
+}
+
+double *Dataset::Labels(std::size_t i)
+{
+    if (labelDType != DType::Float64)
+        throw std::runtime_error("dataset labels are not stored as doubles");
+
+    return static_cast<double *>(LabelData(i));
+}
+
+const double *Dataset::Labels(std::size_t i) const
+{
+    if (labelDType != DType::Float64)
+        throw std::runtime_error("dataset labels are not stored as doubles");
+
+    return static_cast<const double *>(LabelData(i));
+}
+
+void *Dataset::ParameterData(std::size_t i)
+{
+    return const_cast<unsigned char *>(parameterData + indices[i] * parameterStride * SizeOf(parameterDType));
+}
+
+const void *Dataset::ParameterData(std::size_t i) const
+{
+    return parameterData + indices[i] * parameterStride * SizeOf(parameterDType);
+}
+
+void *Dataset::LabelData(std::size_t i)
+{
+    return const_cast<unsigned char *>(labelData + indices[i] * labelStride * SizeOf(labelDType));
+}
+
+const void *Dataset::LabelData(std::size_t i) const
+{
+    return labelData + indices[i] * labelStride * SizeOf(labelDType);
+}
+
+void Dataset::SetNormalization(double p_scale, double p_offset)
+{
+    scale = p_scale;
+    offset = p_offset;
+    featureScales.clear();
+    featureOffsets.clear();
+}
+
+void Dataset::SetNormalization(const std::vector<double> &scales, const std::vector<double> &offsets)
+{
+    if (scales.size() != parameterCount || offsets.size() != parameterCount)
+        throw std::invalid_argument("number of scales and offsets does not match parameter size");
+
+    scale = 1;
+    offset = 0;
+    featureScales = scales;
+    featureOffsets = offsets;
+}
+
+Dataset Dataset::Quantize(DType type) const
+{
+    if (type == DType::Float64)
+        throw std::invalid_argument("datasets can only be quantized to integer types");
+
+    const double levels = type == DType::UInt8 ? 255 : 65535;
+    const std::size_t chunkSize = 1024;
+
+    Data chunk(Math::Matrix(parameterCount, std::min(chunkSize, size())), Math::Matrix(labelCount, std::min(chunkSize, size())));
+
+    // Gathers consecutive chunks of instances, already converted through the current normalization
+    auto loadChunk = [&](std::size_t start) {
+        std::size_t count = std::min(chunkSize, size() - start);
+
+        if (chunk.dataInstanceCount != count) {
+            chunk.parameters.Resize(parameterCount, count);
+            chunk.label.Resize(labelCount, count);
+            chunk.dataInstanceCount = count;
+        }
+
+        Batch(start, count, chunk);
+    };
+
+    std::vector<double> minimums(parameterCount, std::numeric_limits<double>::infinity());
+    std::vector<double> maximums(parameterCount, -std::numeric_limits<double>::infinity());
+
+    for (std::size_t start = 0; start < size(); start += chunkSize) {
+        loadChunk(start);
+
+        for (std::size_t j = 0; j < parameterCount; j++) {
+            const double *row = chunk.parameters.data() + j * chunk.dataInstanceCount;
+            const auto range = std::minmax_element(row, row + chunk.dataInstanceCount);
+
+            minimums[j] = std::min(minimums[j], *range.first);
+            maximums[j] = std::max(maximums[j], *range.second);
+        }
+    }
+
+    // Each parameter's range is spread over every level of the type, constant parameters only using the first level
+    std::vector<double> scales(parameterCount);
+    std::vector<double> offsets = minimums;
+
+    for (std::size_t j = 0; j < parameterCount; j++) {
+        scales[j] = maximums[j] > minimums[j] ? (maximums[j] - minimums[j]) / levels : 1;
+    }
+
+    Dataset quantized(size(), parameterCount, labelCount, type, labelDType);
+
+    for (std::size_t start = 0; start < size(); start += chunkSize) {
+        loadChunk(start);
+
+        if (type == DType::UInt8)
+            QuantizeBatch<std::uint8_t>(chunk.parameters, quantized, start, scales, offsets, levels);
+        else
+            QuantizeBatch<std::uint16_t>(chunk.parameters, quantized, start, scales, offsets, levels);
+
+        for (std::size_t k = 0; k < chunk.dataInstanceCount; k++) {
+            std::memcpy(quantized.LabelData(start + k), LabelData(start + k), labelCount * SizeOf(labelDType));
+        }
+    }
+
+    quantized.SetNormalization(scales, offsets);
+
+    return quantized;
+}
+
+void Dataset::Shuffle()
+{
+    std::default_random_engine rng(std::chrono::system_clock::now().time_since_epoch().count());
+    std::shuffle(indices.begin(), indices.end(), rng);
+}
+
+Dataset::TrainTestPartition Dataset::Partition(double trainingDataRatio) const
+{
+    if (trainingDataRatio < 0 || trainingDataRatio > 1)
+        throw std::invalid_argument("size of partition must be between 0 and 1");
+
+    if ((std::size_t)(size() * trainingDataRatio) < 1 || (std::size_t)(size() * (1 - trainingDataRatio)) < 1)
+        throw std::invalid_argument("partition must not return lists of size 0");
+
+    std::size_t bound = size() * trainingDataRatio;
+
+    Dataset shuffled = *this;
+    shuffled.Shuffle();
+
+    return TrainTestPartition(shuffled.Subset(0, bound), shuffled.Subset(bound, size() - bound));
+}
+
+Dataset Dataset::Subset(std::size_t start, std::size_t count) const
+{
+    if (count < 1 || start + count > size())
+        throw std::invalid_argument("subset out of range");
+
+    Dataset subset = *this;
+    subset.indices = std::vector<std::uint32_t>(indices.begin() + start, indices.begin() + start + count);
+
+    return subset;
+}
+
+void Dataset::Gather(const std::uint32_t *positions, std::size_t count, Data &batch) const
+{
+    if (batch.sparse)
+        return GatherSparse(positions, count, batch);
+
+    NN_PROFILE_SCOPE("Dataset::Gather", count * (parameterCount * (SizeOf(parameterDType) + sizeof(double)) + labelCount * (SizeOf(labelDType) + sizeof(double))), 0);
+
+    if (batch.parameters.rows != parameterCount || batch.label.rows != labelCount || batch.parameters.cols != count || batch.label.cols != count)
+        throw std::invalid_argument("batch dimensions do not match gathered instances");
+
+    const bool indexable = storedCount * std::max(parameterStride, labelStride) <= (std::size_t) std::numeric_limits<std::int32_t>::max();
+
+    const double *scales = featureScales.empty() ? nullptr : featureScales.data();
+    const double *offsets = featureOffsets.empty() ? nullptr : featureOffsets.data();
+
+    std::uint32_t rows[GATHER_TILE];
+
+    for (std::size_t start = 0; start < count; start += GATHER_TILE) {
+        std::size_t tile = std::min(GATHER_TILE, count - start);
+
+        for (std::size_t k = 0; k < tile; k++) {
+            if (positions[start + k] >= indices.size())
+                throw std::invalid_argument("index out of range");
+
+            rows[k] = indices[positions[start + k]];
+        }
+
+        GatherTile(parameterDType, parameterData, parameterStride, rows, tile, parameterCount, batch.parameters.data() + start, count, scale, offset, scales, offsets, indexable);
+        GatherTile(labelDType, labelData, labelStride, rows, tile, labelCount, batch.label.data() + start, count, 1, 0, nullptr, nullptr, indexable);
+    }
+}
+
+void Dataset::GatherSparse(const std::uint32_t *positions, std::size_t count, Data &batch) const
+{
+    NN_PROFILE_SCOPE("Dataset::GatherSparse", 0, 0);
+
+    if (batch.label.rows != labelCount || batch.label.cols != count)
+        throw std::invalid_argument("batch dimensions do not match gathered instances");
+
+    const bool indexable = storedCount * std::max(parameterStride, labelStride) <= (std::size_t) std::numeric_limits<std::int32_t>::max();
+
+    const double *scales = featureScales.empty() ? nullptr : featureScales.data();
+    const double *offsets = featureOffsets.empty() ? nullptr : featureOffsets.data();
+
+    Math::SparseMatrix &parameters = batch.sparseParameters;
+    parameters.rows = count;
+    parameters.cols = parameterCount;
+    parameters.rowOffsets.assign(count + 1, 0);
+    parameters.columns.clear();
+    parameters.values.clear();
+
+    // Tiles are gathered densely as usual, then compressed, so zeros are dropped after normalization
+    std::vector<double> tileParameters(parameterCount * GATHER_TILE);
+    std::uint32_t rows[GATHER_TILE];
+
+    for (std::size_t start = 0; start < count; start += GATHER_TILE) {
+        std::size_t tile = std::min(GATHER_TILE, count - start);
+
+        for (std::size_t k = 0; k < tile; k++) {
+            if (positions[start + k] >= indices.size())
+                throw std::invalid_argument("index out of range");
+
+            rows[k] = indices[positions[start + k]];
+        }
+
+        GatherTile(parameterDType, parameterData, parameterStride, rows, tile, parameterCount, tileParameters.data(), tile, scale, offset, scales, offsets, indexable);
+        GatherTile(labelDType, labelData, labelStride, rows, tile, labelCount, batch.label.data() + start, count, 1, 0, nullptr, nullptr, indexable);
+
+        for (std::size_t k = 0; k < tile; k++) {
+            for (std::size_t j = 0; j < parameterCount; j++) {
+                double value = tileParameters[j * tile + k];
+
+                if (value == 0)
+                    continue;
+
+                parameters.columns.push_back(j);
+                parameters.values.push_back(value);
+            }
+
+            parameters.rowOffsets[start + k + 1] = parameters.values.size();
+        }
+    }
+}
+
+void Dataset::Batch(std::size_t start, std::size_t count, Data &batch) const
+{
+    if (start + count > size())
+        throw std::invalid_argument("batch out of range");
+
+    std::vector<std::uint32_t> positions(count);
+    std::iota(positions.begin(), positions.end(), start);
+
+    Gather(positions.data(), count, batch);
+}
+
+Data Dataset::Batch(std::size_t start, std::size_t count) const
+{
+    Data batch(Math::Matrix(parameterCount, count), Math::Matrix(labelCount, count));
+    Batch(start, count, batch);
+
+    return batch;
+}
+
+std::vector<Data> Dataset::ToVector() const
+{
+    std::vector<Data> data;
+    data.reserve(size());
+
+    for (std::size_t i = 0; i < size(); i++) {
+        data.push_back(Batch(i, 1));
+    }
+
+    return data;
+}
+
+Dataset::TrainTestPartition Dataset::LoadMNIST(std::size_t maxDataSize)
+{
+    std::cout << "Loading MNIST..." << std::endl;
+
+    // reads from root folder, preferring the original IDX files which need no parsing
+    const std::string directory = "data/MNIST/";
+    Dataset trainingSet = Dataset();
+    Dataset testingSet = Dataset();
+
+    if (FileExists(directory + "train-images-idx3-ubyte") && FileExists(directory + "t10k-images-idx3-ubyte")) {
+        trainingSet = ReadIDX(directory + "train-images-idx3-ubyte", directory + "train-labels-idx1-ubyte");
+        testingSet = ReadIDX(directory + "t10k-images-idx3-ubyte", directory + "t10k-labels-idx1-ubyte");
+
+        trainingSet.SetNormalization(1 / 255.0);
+        testingSet.SetNormalization(1 / 255.0);
+
+        if (maxDataSize) {
+            trainingSet = trainingSet.Subset(0, std::min(maxDataSize, trainingSet.size()));
+            testingSet = testingSet.Subset(0, std::min(maxDataSize, testingSet.size()));
+        }
+    }
+    else {
+        trainingSet = ReadMNISTFile(directory + "mnist_train.csv", maxDataSize);
+        testingSet = ReadMNISTFile(directory + "mnist_test.csv", maxDataSize);
+    }
+
+    std::cout << "Loaded MNIST!" << std::endl;
+
+    return TrainTestPartition(trainingSet, testingSet);
+}
+
+Dataset Dataset::ReadMNISTFile(const std::string &pathname, std::size_t maxDataSize)
+{
+    CsvOptions options;
+    options.labelColumns = {0};
+    options.scale = 1 / 255.0;
+    options.maxRows = maxDataSize;
+
+    return CsvReader(options).Read(pathname);
+}
+
+Dataset Dataset::ReadIDX(const std::string &imagesPathname, const std::string &labelsPathname)
+{
+    std::shared_ptr<IdxFiles> files = std::make_shared<IdxFiles>(imagesPathname, labelsPathname);
+
+    IdxHeader images = ReadIdxHeader(files->images, imagesPathname);
+    IdxHeader labels = ReadIdxHeader(files->labels, labelsPathname);
+
+    if (images.dimensions[0] != labels.dimensions[0])
+        throw std::runtime_error("IDX files \"" + imagesPathname + "\" and \"" + labelsPathname + "\" have different numbers of instances");
+
+    std::size_t parameterSize = 1;
+    std::size_t labelSize = 1;
+
+    for (std::size_t i = 1; i < images.dimensions.size(); i++) {
+        parameterSize *= images.dimensions[i];
+    }
+
+    for (std::size_t i = 1; i < labels.dimensions.size(); i++) {
+        labelSize *= labels.dimensions[i];
+    }
+
+    files->images.AdviseSequential();
+
+    return Wrap(files, files->images.data() + images.dataOffset, files->labels.data() + labels.dataOffset, images.dimensions[0], parameterSize, labelSize, DType::UInt8, DType::UInt8);
+}
+
+void Dataset::Save(const std::string &pathname) const
+{
+    if (!MappedFile::IsLittleEndian())
+        throw std::runtime_error("binary datasets can only be written on little endian machines");
+
+    std::ofstream file(pathname, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open())
+        throw std::runtime_error("error opening dataset file at \"" + pathname + "\"");
+
+    const std::size_t parameterBytes = parameterCount * SizeOf(parameterDType);
+    const std::size_t labelBytes = labelCount * SizeOf(labelDType);
+    const std::size_t rowBytes = AlignedBuffer::AlignUp(parameterBytes);
+
+    DatasetFileHeader header = {};
+    std::memcpy(header.magic, DATASET_FILE_MAGIC, sizeof(header.magic));
+    header.version = DATASET_FILE_VERSION;
+    header.headerSize = sizeof(DatasetFileHeader);
+    header.parameterType = static_cast<std::uint8_t>(parameterDType);
+    header.labelType = static_cast<std::uint8_t>(labelDType);
+    header.count = size();
+    header.parameterSize = parameterCount;
+    header.labelSize = labelCount;
+    header.parameterStride = rowBytes / SizeOf(parameterDType);
+    header.scale = scale;
+    header.offset = offset;
+    header.parameterOffset = AlignedBuffer::AlignUp(sizeof(DatasetFileHeader), DATASET_FILE_ALIGNMENT);
+    header.labelOffset = AlignedBuffer::AlignUp(header.parameterOffset + size() * rowBytes, DATASET_FILE_ALIGNMENT);
+
+    if (!featureScales.empty())
+        header.featureNormalizationOffset = AlignedBuffer::AlignUp(header.labelOffset + size() * labelBytes, 64);
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    MappedFile::WritePadding(file, DATASET_FILE_ALIGNMENT);
+
+    // Written in dataset order, so a shuffled or partitioned dataset is saved as it is seen
+    for (std::size_t i = 0; i < size(); i++) {
+        file.write(static_cast<const char *>(ParameterData(i)), parameterBytes);
+        MappedFile::WritePadding(file, 64);
+    }
+
+    MappedFile::WritePadding(file, DATASET_FILE_ALIGNMENT);
+
+    for (std::size_t i = 0; i < size(); i++) {
+        file.write(static_cast<const char *>(LabelData(i)), labelBytes);
+    }
+
+    if (header.featureNormalizationOffset) {
+        MappedFile::WritePadding(file, 64);
+        file.write(reinterpret_cast<const char *>(featureScales.data()), parameterCount * sizeof(double));
+        file.write(reinterpret_cast<const char *>(featureOffsets.data()), parameterCount * sizeof(double));
+    }
+
+    if (!file)
+        throw std::runtime_error("error writing dataset file at \"" + pathname + "\"");
+}
+
+Dataset Dataset::Load(const std::string &pathname)
+{
+    if (!MappedFile::IsLittleEndian())
+        throw std::runtime_error("binary datasets can only be read on little endian machines");
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(pathname);
+
+    if (file->size() < DATASET_FILE_VERSION_1_HEADER_SIZE || std::memcmp(file->data(), DATASET_FILE_MAGIC, sizeof(DATASET_FILE_MAGIC)) != 0)
+        throw std::runtime_error("\"" + pathname + "\" is not a dataset file");
+
+    // Fields missing from older headers are left zeroed
+    DatasetFileHeader header = {};
+    std::memcpy(&header, file->data(), DATASET_FILE_VERSION_1_HEADER_SIZE);
+
+    const bool supported = (header.version == 1 && header.headerSize == DATASET_FILE_VERSION_1_HEADER_SIZE)
+        || (header.version == DATASET_FILE_VERSION && header.headerSize == sizeof(DatasetFileHeader) && file->size() >= sizeof(DatasetFileHeader));
+
+    if (!supported)
+        throw std::runtime_error("dataset file at \"" + pathname + "\" has unsupported version " + std::to_string(header.version));
+
+    std::memcpy(&header, file->data(), header.headerSize);
+
+    if (header.parameterType > static_cast<std::uint8_t>(DType::UInt16) || header.labelType > static_cast<std::uint8_t>(DType::UInt16))
+        throw std::runtime_error("dataset file at \"" + pathname + "\" has an unknown value type");
+
+    const DType parameterType = static_cast<DType>(header.parameterType);
+    const DType labelType = static_cast<DType>(header.labelType);
+
+    if (header.parameterStride < header.parameterSize
+        || !FitsInFile(header.parameterOffset, header.count, header.parameterStride, SizeOf(parameterType), file->size())
+        || !FitsInFile(header.labelOffset, header.count, header.labelSize, SizeOf(labelType), file->size())
+        || (header.featureNormalizationOffset && !FitsInFile(header.featureNormalizationOffset, 2, header.parameterSize, sizeof(double), file->size())))
+        throw std::runtime_error("dataset file at \"" + pathname + "\" is truncated");
+
+    Dataset dataset = Wrap(file, file->data() + header.parameterOffset, file->data() + header.labelOffset, header.count, header.parameterSize, header.labelSize, parameterType, labelType, header.parameterStride);
+
+    if (header.featureNormalizationOffset) {
+        std::vector<double> scales(header.parameterSize);
+        std::vector<double> offsets(header.parameterSize);
+        std::memcpy(scales.data(), file->data() + header.featureNormalizationOffset, scales.size() * sizeof(double));
+        std::memcpy(offsets.data(), file->data() + header.featureNormalizationOffset + scales.size() * sizeof(double), offsets.size() * sizeof(double));
+        dataset.SetNormalization(scales, offsets);
+    }
+    else {
+        dataset.SetNormalization(header.scale, header.offset);
+    }
+
+    return dataset;
+}
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include "Data.hpp"
+#include "DatasetStream.hpp"
+#include "Dataset.hpp"
+#include "Matrix.hpp"
+
+DatasetStream::DatasetStream(const Dataset &p_data)
+    : data(p_data), position(0) {}
+
+std::size_t DatasetStream::parameterSize() const
+{
+    return data.parameterSize();
+}
+
+std::size_t DatasetStream::labelSize() const
+{
+    return data.labelSize();
+}
+
+std::size_t DatasetStream::Read(std::size_t count, Data &batch)
+{
+    count = std::min(count, data.size() - position);
+
+    if (count == 0)
+        return 0;
+
+    if (batch.parameterSize != data.parameterSize() || batch.labelSize != data.labelSize())
+        throw std::invalid_argument("batch dimensions do not match the stream");
+
+    if (batch.dataInstanceCount != count) {
+        batch.parameters.Resize(data.parameterSize(), count);
+        batch.label.Resize(data.labelSize(), count);
+        batch.dataInstanceCount = count;
+    }
+
+    data.Batch(position, count, batch);
+    position += count;
+
+    return count;
+}
+
+bool DatasetStream::AtEnd()
+{
+    return position == data.size();
+}
+
+void DatasetStream::Reset()
+{
+    position = 0;
+}
+
+std::unique_ptr<DataStream> DatasetStream::Reopen() const
+{
+    return std::unique_ptr<DataStream>(new DatasetStream(data));
+}
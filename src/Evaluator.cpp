@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "ActivationFn.hpp"
+#include "CostFn.hpp"
+#include "Data.hpp"
+#include "DataStream.hpp"
+#include "Evaluator.hpp"
+#include "Layer.hpp"
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+
+namespace NeuralNetwork
+{
+    namespace
+    {
+        // Output rows computed together, so each row of the input is loaded once for all of them
+        const std::size_t ROW_BLOCK = 4;
+
+        /**
+         * Computes `output = weights * input + bias` without allocating, the matrices being row-major
+         * @param weights rows x inner weight matrix
+         * @param bias bias of each row, or nullptr for none
+         * @param input inner x cols input matrix
+         * @param output rows x cols output matrix
+         */
+        void AffineTransform(const double *weights, const double *bias, const double *input, double *output, std::size_t rows, std::size_t inner, std::size_t cols)
+        {
+            std::size_t i = 0;
+
+            for (; i + ROW_BLOCK <= rows; i += ROW_BLOCK) {
+                double *out[ROW_BLOCK];
+                const double *weightRows[ROW_BLOCK];
+
+                for (std::size_t r = 0; r < ROW_BLOCK; r++) {
+                    out[r] = output + (i + r) * cols;
+                    weightRows[r] = weights + (i + r) * inner;
+                    std::fill(out[r], out[r] + cols, bias ? bias[i + r] : 0);
+                }
+
+                for (std::size_t k = 0; k < inner; k++) {
+                    const double *in = input + k * cols;
+                    const double w0 = weightRows[0][k], w1 = weightRows[1][k], w2 = weightRows[2][k], w3 = weightRows[3][k];
+
+                    for (std::size_t j = 0; j < cols; j++) {
+                        const double x = in[j];
+                        out[0][j] += w0 * x;
+                        out[1][j] += w1 * x;
+                        out[2][j] += w2 * x;
+                        out[3][j] += w3 * x;
+                    }
+                }
+            }
+
+            for (; i < rows; i++) {
+                double *out = output + i * cols;
+                std::fill(out, out + cols, bias ? bias[i] : 0);
+
+                for (std::size_t k = 0; k < inner; k++) {
+                    const double *in = input + k * cols;
+                    const double w = weights[i * inner + k];
+
+                    for (std::size_t j = 0; j < cols; j++) {
+                        out[j] += w * in[j];
+                    }
+                }
+            }
+        }
+    }
+
+    double MetricValue(const EvaluationResult &results, Metric metric)
+    {
+        switch (metric) {
+        case Metric::Accuracy:
+            return results.accuracy;
+        case Metric::Cost:
+            return results.cost;
+        case Metric::ValidationAccuracy:
+            return results.validationAccuracy;
+        case Metric::ValidationCost:
+            return results.validationCost;
+        }
+
+        throw std::invalid_argument("unknown metric");
+    }
+
+    bool MetricIncreases(Metric metric)
+    {
+        return metric == Metric::Accuracy || metric == Metric::ValidationAccuracy;
+    }
+
+    bool IsValidationMetric(Metric metric)
+    {
+        return metric == Metric::ValidationAccuracy || metric == Metric::ValidationCost;
+    }
+
+    MetricMonitor::MetricMonitor(Metric p_metric, double p_minDelta)
+        :metric(p_metric), minDelta(p_minDelta)
+    {
+        if (minDelta < 0)
+            throw std::invalid_argument("the smallest improvement of a metric cannot be negative");
+    }
+
+    bool MetricMonitor::Observe(const EvaluationResult &results)
+    {
+        if (IsValidationMetric(metric) && !results.validated)
+            throw std::invalid_argument("validation metrics need a testing set");
+
+        const double value = MetricValue(results, metric);
+        latest = results.epoch;
+
+        const bool improved = bestAt < 0 || (MetricIncreases(metric) ? value > best + minDelta : value < best - minDelta);
+
+        if (improved) {
+            best = value;
+            bestAt = results.epoch;
+        }
+
+        return improved;
+    }
+
+    void MetricMonitor::Reset()
+    {
+        best = 0;
+        bestAt = -1;
+        latest = -1;
+    }
+
+    int MetricMonitor::epochsSinceBest() const
+    {
+        return latest - bestAt;
+    }
+
+    int MetricMonitor::bestEpoch() const
+    {
+        return bestAt;
+    }
+
+    Metric MetricMonitor::followedMetric() const
+    {
+        return metric;
+    }
+
+    Evaluator::Evaluator(const std::vector<Layer> &p_layers, CostFn::CostFn &p_costFn, std::size_t p_chunkSize)
+        : layers(p_layers), costFn(p_costFn), chunkSize(p_chunkSize),
+          chunk(Math::Matrix(p_layers.empty() ? 1 : p_layers[0].neuronCount, std::max<std::size_t>(p_chunkSize, 1)), Math::Matrix(1, std::max<std::size_t>(p_chunkSize, 1)))
+    {
+        if (layers.size() < 2)
+            throw std::invalid_argument("neural network layers are not defined");
+
+        if (chunkSize == 0)
+            throw std::invalid_argument("chunk size must be positive");
+
+        for (std::size_t i = 1; i < layers.size(); i++) {
+            outputs.push_back(Math::Matrix(layers[i].neuronCount, chunkSize));
+            factorOutputs.push_back(Math::Matrix(std::max<std::size_t>(layers[i].rank, 1), chunkSize));
+        }
+    }
+
+    void Evaluator::Forward()
+    {
+        const std::size_t count = chunk.dataInstanceCount;
+        const double *input = chunk.parameters.data();
+
+        for (std::size_t i = 1; i < layers.size(); i++) {
+            const Layer &layer = layers[i];
+            Math::Matrix &output = outputs[i - 1];
+
+            if (output.cols != count)
+                output.Resize(layer.neuronCount, count);
+
+            if (layer.rank) {
+                Math::Matrix &factorOutput = factorOutputs[i - 1];
+
+                if (factorOutput.cols != count)
+                    factorOutput.Resize(layer.rank, count);
+
+                AffineTransform(layer.factorV.data(), nullptr, input, factorOutput.data(), layer.rank, layer.connectionCount, count);
+                AffineTransform(layer.factorU.data(), layer.biasVector.data(), factorOutput.data(), output.data(), layer.neuronCount, layer.rank, count);
+            }
+            else {
+                AffineTransform(layer.weightMatrix.data(), layer.biasVector.data(), input, output.data(), layer.neuronCount, layer.connectionCount, count);
+            }
+
+            if (layer.activationFn) {
+                double *values = output.data();
+
+                for (std::size_t j = 0; j < layer.neuronCount * count; j++) {
+                    values[j] = layer.activationFn->fn(values[j]);
+                }
+            }
+
+            input = output.data();
+        }
+    }
+
+    std::tuple<double, double> Evaluator::Evaluate(DataStream &data)
+    {
+        NN_PROFILE_SCOPE("Evaluator::Evaluate", 0, 0);
+
+        if (data.parameterSize() != layers[0].neuronCount)
+            throw std::invalid_argument("input dimensions do not match specified dimensions");
+
+        if (chunk.labelSize != data.labelSize()) {
+            chunk.label = Math::Matrix(data.labelSize(), chunkSize);
+            chunk.labelSize = data.labelSize();
+        }
+
+        double correct = 0;
+        double cost = 0;
+        std::size_t instanceCount = 0;
+
+        data.Reset();
+
+        while (std::size_t count = data.Read(chunkSize, chunk)) {
+            Forward();
+
+            // accuracy is a mean over the chunk, so it is weighted by the size of the chunk
+            correct += costFn.evaluate(outputs.back(), chunk.label) * count;
+            cost += costFn.cost(outputs.back(), chunk.label);
+            instanceCount += count;
+        }
+
+        if (instanceCount == 0)
+            throw std::invalid_argument("cannot evaluate an empty stream");
+
+        return std::tuple<double, double>(correct / instanceCount, cost / instanceCount);
+    }
+}
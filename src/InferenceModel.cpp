@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ActivationFn.hpp"
+#include "AlignedBuffer.hpp"
+#include "InferenceModel.hpp"
+#include "Layer.hpp"
+
+namespace NeuralNetwork
+{
+    namespace
+    {
+        // Instances computed together, so each weight block is loaded once for all of them
+        const std::size_t SAMPLE_BLOCK = 4;
+
+        // Row blocks accumulated together for a single instance, enough independent chains to hide the latency of an add
+        const std::size_t GEMV_BLOCKS = 4;
+
+        // Instances computed together by the sparse kernel, a register of floats holding one input of each
+        const std::size_t SPARSE_LANES = 8;
+
+        /**
+         * Computes one row block of a layer for `S` instances, `output = activation(weights * input + bias)`
+         * @param weights packed row block, `ROW_BLOCK` weights per input
+         * @param bias bias of each row of the block
+         * @param input first input instance
+         * @param inputStride distance between the inputs of consecutive instances
+         * @param inputCount number of inputs of each instance
+         * @param output first output of the block for the first instance
+         * @param outputStride distance between the outputs of consecutive instances
+         */
+        template <std::size_t S>
+        void ComputeBlock(const float *weights, const float *bias, const float *input, std::size_t inputStride, std::size_t inputCount, float *output, std::size_t outputStride, ActivationFn::Id activation)
+        {
+            const std::size_t B = InferenceModel::ROW_BLOCK;
+
+#if defined(__AVX2__) && defined(__FMA__)
+            __m256 accumulators[S];
+
+            for (std::size_t s = 0; s < S; s++) {
+                accumulators[s] = _mm256_load_ps(bias);
+            }
+
+            for (std::size_t k = 0; k < inputCount; k++) {
+                const __m256 weight = _mm256_load_ps(weights + k * B);
+
+                for (std::size_t s = 0; s < S; s++) {
+                    accumulators[s] = _mm256_fmadd_ps(_mm256_broadcast_ss(input + s * inputStride + k), weight, accumulators[s]);
+                }
+            }
+
+            for (std::size_t s = 0; s < S; s++) {
+                _mm256_store_ps(output + s * outputStride, accumulators[s]);
+            }
+#elif defined(__SSE2__)
+            // Every x86-64 target has SSE2, a row block spans two registers
+            __m128 low[S];
+            __m128 high[S];
+
+            for (std::size_t s = 0; s < S; s++) {
+                low[s] = _mm_load_ps(bias);
+                high[s] = _mm_load_ps(bias + 4);
+            }
+
+            for (std::size_t k = 0; k < inputCount; k++) {
+                const __m128 weightLow = _mm_load_ps(weights + k * B);
+                const __m128 weightHigh = _mm_load_ps(weights + k * B + 4);
+
+                for (std::size_t s = 0; s < S; s++) {
+                    const __m128 value = _mm_set1_ps(input[s * inputStride + k]);
+                    low[s] = _mm_add_ps(low[s], _mm_mul_ps(value, weightLow));
+                    high[s] = _mm_add_ps(high[s], _mm_mul_ps(value, weightHigh));
+                }
+            }
+
+            for (std::size_t s = 0; s < S; s++) {
+                _mm_store_ps(output + s * outputStride, low[s]);
+                _mm_store_ps(output + s * outputStride + 4, high[s]);
+            }
+#else
+            float accumulators[S][B];
+
+            for (std::size_t s = 0; s < S; s++) {
+                std::copy(bias, bias + B, accumulators[s]);
+            }
+
+            for (std::size_t k = 0; k < inputCount; k++) {
+                const float *weight = weights + k * B;
+
+                for (std::size_t s = 0; s < S; s++) {
+                    const float value = input[s * inputStride + k];
+
+                    for (std::size_t l = 0; l < B; l++) {
+                        accumulators[s][l] += value * weight[l];
+                    }
+                }
+            }
+
+            for (std::size_t s = 0; s < S; s++) {
+                std::copy(accumulators[s], accumulators[s] + B, output + s * outputStride);
+            }
+#endif
+
+            for (std::size_t s = 0; s < S; s++) {
+                ActivationFn::Apply(activation, output + s * outputStride, B);
+            }
+        }
+
+        /**
+         * Computes `R` consecutive row blocks of a layer for a single instance
+         *
+         * A single accumulator per block would wait on the latency of every add before the next,
+         * so several blocks are accumulated at once, each with its own independent chain
+         * @param weights first packed row block, `ROW_BLOCK` weights per input
+         * @param bias bias of each row of the blocks
+         * @param input inputs of the instance
+         * @param inputCount number of inputs
+         * @param output first output of the blocks
+         */
+        template <std::size_t R>
+        void ComputeRows(const float *weights, const float *bias, const float *input, std::size_t inputCount, float *output, ActivationFn::Id activation)
+        {
+            const std::size_t B = InferenceModel::ROW_BLOCK;
+            const std::size_t blockSize = B * inputCount;
+
+#if defined(__AVX2__) && defined(__FMA__)
+            __m256 accumulators[R];
+
+            for (std::size_t r = 0; r < R; r++) {
+                accumulators[r] = _mm256_load_ps(bias + r * B);
+            }
+
+            for (std::size_t k = 0; k < inputCount; k++) {
+                const __m256 value = _mm256_broadcast_ss(input + k);
+
+                for (std::size_t r = 0; r < R; r++) {
+                    accumulators[r] = _mm256_fmadd_ps(value, _mm256_load_ps(weights + r * blockSize + k * B), accumulators[r]);
+                }
+            }
+
+            for (std::size_t r = 0; r < R; r++) {
+                _mm256_store_ps(output + r * B, accumulators[r]);
+            }
+#elif defined(__SSE2__)
+            __m128 low[R];
+            __m128 high[R];
+
+            for (std::size_t r = 0; r < R; r++) {
+                low[r] = _mm_load_ps(bias + r * B);
+                high[r] = _mm_load_ps(bias + r * B + 4);
+            }
+
+            for (std::size_t k = 0; k < inputCount; k++) {
+                const __m128 value = _mm_set1_ps(input[k]);
+
+                for (std::size_t r = 0; r < R; r++) {
+                    const float *weight = weights + r * blockSize + k * B;
+                    low[r] = _mm_add_ps(low[r], _mm_mul_ps(value, _mm_load_ps(weight)));
+                    high[r] = _mm_add_ps(high[r], _mm_mul_ps(value, _mm_load_ps(weight + 4)));
+                }
+            }
+
+            for (std::size_t r = 0; r < R; r++) {
+                _mm_store_ps(output + r * B, low[r]);
+                _mm_store_ps(output + r * B + 4, high[r]);
+            }
+#else
+            float accumulators[R][B];
+
+            for (std::size_t r = 0; r < R; r++) {
+                std::copy(bias + r * B, bias + (r + 1) * B, accumulators[r]);
+            }
+
+            for (std::size_t k = 0; k < inputCount; k++) {
+                const float value = input[k];
+
+                for (std::size_t r = 0; r < R; r++) {
+                    const float *weight = weights + r * blockSize + k * B;
+
+                    for (std::size_t l = 0; l < B; l++) {
+                        accumulators[r][l] += value * weight[l];
+                    }
+                }
+            }
+
+            for (std::size_t r = 0; r < R; r++) {
+                std::copy(accumulators[r], accumulators[r] + B, output + r * B);
+            }
+#endif
+
+            ActivationFn::Apply(activation, output, R * B);
+        }
+
+        /**
+         * Computes every row of a sparse layer for a group of `SPARSE_LANES` instances, `output = weights * input + bias` before activation
+         * @param rowOffsets index of the first nonzero weight of each row, followed by the number of nonzero weights
+         * @param columns input of each nonzero weight
+         * @param weights nonzero weights, row after row
+         * @param rowCount number of rows
+         * @param input inputs of the group, the `SPARSE_LANES` instances of every input in turn
+         * @param output first output of the first instance of the group
+         * @param outputStride distance between the outputs of consecutive instances
+         * @param instances number of instances of the group written, the others are padding
+         */
+        void ComputeSparse(const std::uint32_t *rowOffsets, const std::uint32_t *columns, const float *weights, const float *bias, std::size_t rowCount, const float *input, float *output, std::size_t outputStride, std::size_t instances)
+        {
+            const std::size_t L = SPARSE_LANES;
+            alignas(32) float lanes[L];
+
+            for (std::size_t row = 0; row < rowCount; row++) {
+                std::uint32_t j = rowOffsets[row];
+                const std::uint32_t end = rowOffsets[row + 1];
+
+#if defined(__AVX2__) && defined(__FMA__)
+                // Two chains alternate between nonzero weights, so an add does not wait on the one before it
+                __m256 first = _mm256_set1_ps(bias[row]);
+                __m256 second = _mm256_setzero_ps();
+
+                for (; j + 2 <= end; j += 2) {
+                    first = _mm256_fmadd_ps(_mm256_set1_ps(weights[j]), _mm256_load_ps(input + columns[j] * L), first);
+                    second = _mm256_fmadd_ps(_mm256_set1_ps(weights[j + 1]), _mm256_load_ps(input + columns[j + 1] * L), second);
+                }
+
+                if (j < end)
+                    first = _mm256_fmadd_ps(_mm256_set1_ps(weights[j]), _mm256_load_ps(input + columns[j] * L), first);
+
+                _mm256_store_ps(lanes, _mm256_add_ps(first, second));
+#elif defined(__SSE2__)
+                __m128 low = _mm_set1_ps(bias[row]);
+                __m128 high = low;
+
+                for (; j < end; j++) {
+                    const __m128 weight = _mm_set1_ps(weights[j]);
+                    const float *value = input + columns[j] * L;
+                    low = _mm_add_ps(low, _mm_mul_ps(weight, _mm_load_ps(value)));
+                    high = _mm_add_ps(high, _mm_mul_ps(weight, _mm_load_ps(value + 4)));
+                }
+
+                _mm_store_ps(lanes, low);
+                _mm_store_ps(lanes + 4, high);
+#else
+                std::fill(lanes, lanes + L, bias[row]);
+
+                for (; j < end; j++) {
+                    const float *value = input + columns[j] * L;
+
+                    for (std::size_t l = 0; l < L; l++) {
+                        lanes[l] += weights[j] * value[l];
+                    }
+                }
+#endif
+
+                for (std::size_t t = 0; t < instances; t++) {
+                    output[t * outputStride + row] = lanes[t];
+                }
+            }
+        }
+
+        /**
+         * Computes every row of a sparse layer for a single instance, `output = weights * input + bias` before activation
+         */
+        void ComputeSparseRows(const std::uint32_t *rowOffsets, const std::uint32_t *columns, const float *weights, const float *bias, std::size_t rowCount, const float *input, float *output)
+        {
+            for (std::size_t row = 0; row < rowCount; row++) {
+                std::uint32_t j = rowOffsets[row];
+                const std::uint32_t end = rowOffsets[row + 1];
+                float sums[4] = {bias[row], 0, 0, 0};
+
+                // Inputs are gathered one at a time, four independent sums keep the adds from waiting on each other
+                for (; j + 4 <= end; j += 4) {
+                    for (std::size_t i = 0; i < 4; i++) {
+                        sums[i] += weights[j + i] * input[columns[j + i]];
+                    }
+                }
+
+                for (; j < end; j++) {
+                    sums[0] += weights[j] * input[columns[j]];
+                }
+
+                output[row] = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+            }
+        }
+    }
+
+    constexpr double InferenceModel::DEFAULT_SPARSE_DENSITY;
+    const std::size_t InferenceModel::ROW_BLOCK;
+
+    InferenceModel::Workspace::Workspace(std::size_t size, std::size_t transposedSize)
+        : front(size), back(size), transposed(transposedSize) {}
+
+    InferenceModel::PackedLayer InferenceModel::Pack(const double *source, const double *biasSource, std::size_t outputCount, std::size_t inputCount, ActivationFn::Id activation, double maxSparseDensity)
+    {
+        PackedLayer packed;
+
+        packed.inputCount = inputCount;
+        packed.outputCount = outputCount;
+        packed.paddedOutputCount = AlignedBuffer::AlignUp(outputCount, ROW_BLOCK);
+        packed.activation = activation;
+        packed.bias.reset(new AlignedBuffer(packed.paddedOutputCount * sizeof(float)));
+
+        // Rows past the end of the layer keep zero weights and bias, so padded outputs never read out of bounds
+        float *bias = static_cast<float *>(packed.bias->data());
+        const std::size_t weightCount = packed.outputCount * packed.inputCount;
+        const std::size_t nonzeroCount = weightCount - std::count(source, source + weightCount, 0.0);
+
+        for (std::size_t row = 0; row < packed.outputCount; row++) {
+            bias[row] = biasSource ? biasSource[row] : 0;
+        }
+
+        packed.sparse = maxSparseDensity > 0 && nonzeroCount <= maxSparseDensity * weightCount;
+
+        if (packed.sparse) {
+            packed.rowOffsets.reset(new AlignedBuffer((packed.paddedOutputCount + 1) * sizeof(std::uint32_t)));
+            packed.columns.reset(new AlignedBuffer(nonzeroCount * sizeof(std::uint32_t)));
+            packed.weights.reset(new AlignedBuffer(nonzeroCount * sizeof(float)));
+
+            std::uint32_t *rowOffsets = static_cast<std::uint32_t *>(packed.rowOffsets->data());
+            std::uint32_t *columns = static_cast<std::uint32_t *>(packed.columns->data());
+            float *weights = static_cast<float *>(packed.weights->data());
+            std::uint32_t nonzero = 0;
+
+            // Padded rows have no nonzero weights
+            for (std::size_t row = 0; row < packed.paddedOutputCount; row++) {
+                rowOffsets[row] = nonzero;
+
+                for (std::size_t k = 0; row < packed.outputCount && k < packed.inputCount; k++) {
+                    if (source[row * packed.inputCount + k] == 0)
+                        continue;
+
+                    columns[nonzero] = k;
+                    weights[nonzero] = source[row * packed.inputCount + k];
+                    nonzero++;
+                }
+            }
+
+            rowOffsets[packed.paddedOutputCount] = nonzero;
+        }
+        else {
+            packed.weights.reset(new AlignedBuffer(packed.paddedOutputCount * packed.inputCount * sizeof(float)));
+            float *weights = static_cast<float *>(packed.weights->data());
+
+            for (std::size_t row = 0; row < packed.outputCount; row++) {
+                float *block = weights + row / ROW_BLOCK * ROW_BLOCK * packed.inputCount;
+
+                for (std::size_t k = 0; k < packed.inputCount; k++) {
+                    block[k * ROW_BLOCK + row % ROW_BLOCK] = source[row * packed.inputCount + k];
+                }
+            }
+        }
+
+        return packed;
+
+    }
+
+    InferenceModel::InferenceModel(const std::vector<Layer> &p_layers, std::size_t maxBatchSize, double maxSparseDensity)
+        : batchSize(maxBatchSize), workspaces(new WorkspacePool())
+    {
+        if (p_layers.size() < 2)
+            throw std::invalid_argument("neural network layers are not defined");
+
+        if (batchSize == 0)
+            throw std::invalid_argument("batch size must be positive");
+
+        inputCount = p_layers[0].neuronCount;
+
+        for (std::size_t i = 1; i < p_layers.size(); i++) {
+            const Layer &layer = p_layers[i];
+            const ActivationFn::Id activation = layer.activationFn ? layer.activationFn->id() : ActivationFn::Id::None;
+
+            // A factorized layer runs as two layers, the first multiplying by the second factor without bias or activation
+            if (layer.rank) {
+                layers.push_back(Pack(layer.factorV.data(), nullptr, layer.rank, layer.connectionCount, ActivationFn::Id::None, maxSparseDensity));
+                layers.push_back(Pack(layer.factorU.data(), layer.biasVector.data(), layer.neuronCount, layer.rank, activation, maxSparseDensity));
+            }
+            else {
+                layers.push_back(Pack(layer.weightMatrix.data(), layer.biasVector.data(), layer.neuronCount, layer.connectionCount, activation, maxSparseDensity));
+            }
+        }
+
+        std::size_t widest = 0;
+        std::size_t widestSparseInput = 0;
+
+        for (const PackedLayer &packed : layers) {
+            widest = std::max(widest, packed.paddedOutputCount);
+
+            if (packed.sparse)
+                widestSparseInput = std::max(widestSparseInput, packed.inputCount);
+        }
+
+        workspaceSize = batchSize * widest * sizeof(float);
+        transposedSize = AlignedBuffer::AlignUp(batchSize, SPARSE_LANES) * widestSparseInput * sizeof(float);
+    }
+
+    void InferenceModel::PredictBatch(const float *input, std::size_t count, float *output, Workspace &workspace) const
+    {
+        float *buffers[2] = {static_cast<float *>(workspace.front.data()), static_cast<float *>(workspace.back.data())};
+        const float *layerInput = input;
+        std::size_t inputStride = inputCount;
+
+        for (std::size_t i = 0; i < layers.size(); i++) {
+            const PackedLayer &layer = layers[i];
+            float *layerOutput = buffers[i % 2];
+            const float *weights = static_cast<const float *>(layer.weights->data());
+            const float *bias = static_cast<const float *>(layer.bias->data());
+
+            if (layer.sparse) {
+                // Each nonzero weight multiplies the same input of a group of instances, so the input is regrouped by instance
+                float *transposed = static_cast<float *>(workspace.transposed.data());
+
+                for (std::size_t group = 0; group < count; group += SPARSE_LANES) {
+                    float *groupInput = transposed + group * layer.inputCount;
+                    const std::size_t instances = std::min(SPARSE_LANES, count - group);
+
+                    for (std::size_t k = 0; k < layer.inputCount; k++) {
+                        for (std::size_t t = 0; t < SPARSE_LANES; t++) {
+                            groupInput[k * SPARSE_LANES + t] = t < instances ? layerInput[(group + t) * inputStride + k] : 0;
+                        }
+                    }
+
+                    ComputeSparse(static_cast<const std::uint32_t *>(layer.rowOffsets->data()), static_cast<const std::uint32_t *>(layer.columns->data()), weights, bias, layer.paddedOutputCount, groupInput, layerOutput + group * layer.paddedOutputCount, layer.paddedOutputCount, instances);
+                }
+
+                ActivationFn::Apply(layer.activation, layerOutput, count * layer.paddedOutputCount);
+
+                layerInput = layerOutput;
+                inputStride = layer.paddedOutputCount;
+                continue;
+            }
+
+            // A weight block stays in cache while every instance of the batch passes through it
+            for (std::size_t row = 0; row < layer.paddedOutputCount; row += ROW_BLOCK) {
+                const float *block = weights + row * layer.inputCount;
+
+                std::size_t s = 0;
+
+                for (; s + SAMPLE_BLOCK <= count; s += SAMPLE_BLOCK) {
+                    ComputeBlock<SAMPLE_BLOCK>(block, bias + row, layerInput + s * inputStride, inputStride, layer.inputCount, layerOutput + s * layer.paddedOutputCount + row, layer.paddedOutputCount, layer.activation);
+                }
+
+                for (; s < count; s++) {
+                    ComputeBlock<1>(block, bias + row, layerInput + s * inputStride, inputStride, layer.inputCount, layerOutput + s * layer.paddedOutputCount + row, layer.paddedOutputCount, layer.activation);
+                }
+            }
+
+            layerInput = layerOutput;
+            inputStride = layer.paddedOutputCount;
+        }
+
+        const std::size_t outputCount = layers.back().outputCount;
+
+        for (std::size_t s = 0; s < count; s++) {
+            std::memcpy(output + s * outputCount, layerInput + s * inputStride, outputCount * sizeof(float));
+        }
+    }
+
+    void InferenceModel::Predict(const float *input, std::size_t count, float *output) const
+    {
+        if (count == 1)
+            return Predict(input, output);
+
+        std::unique_ptr<Workspace> workspace;
+
+        {
+            std::unique_lock<std::mutex> lock(workspaces->mutex);
+
+            if (!workspaces->available.empty()) {
+                workspace = std::move(workspaces->available.back());
+                workspaces->available.pop_back();
+            }
+        }
+
+        if (!workspace)
+            workspace.reset(new Workspace(workspaceSize, transposedSize));
+
+        for (std::size_t start = 0; start < count; start += batchSize) {
+            std::size_t batch = std::min(batchSize, count - start);
+            PredictBatch(input + start * inputCount, batch, output + start * outputSize(), *workspace);
+        }
+
+        std::unique_lock<std::mutex> lock(workspaces->mutex);
+        workspaces->available.push_back(std::move(workspace));
+    }
+
+    void InferenceModel::Predict(const float *input, float *output) const
+    {
+        // Shared by every model predicting on this thread, grown to the largest of them
+        thread_local std::unique_ptr<AlignedBuffer> buffer;
+        const std::size_t bufferSize = 2 * workspaceSize / batchSize;
+
+        if (!buffer || buffer->size() < bufferSize)
+            buffer.reset(new AlignedBuffer(bufferSize));
+
+        float *buffers[2] = {static_cast<float *>(buffer->data()), static_cast<float *>(buffer->data()) + bufferSize / sizeof(float) / 2};
+        const float *layerInput = input;
+
+        for (std::size_t i = 0; i < layers.size(); i++) {
+            const PackedLayer &layer = layers[i];
+            float *layerOutput = buffers[i % 2];
+            const float *weights = static_cast<const float *>(layer.weights->data());
+            const float *bias = static_cast<const float *>(layer.bias->data());
+
+            if (layer.sparse) {
+                ComputeSparseRows(static_cast<const std::uint32_t *>(layer.rowOffsets->data()), static_cast<const std::uint32_t *>(layer.columns->data()), weights, bias, layer.paddedOutputCount, layerInput, layerOutput);
+                ActivationFn::Apply(layer.activation, layerOutput, layer.paddedOutputCount);
+
+                layerInput = layerOutput;
+                continue;
+            }
+
+            const std::size_t blockCount = layer.paddedOutputCount / ROW_BLOCK;
+            const std::size_t blockSize = ROW_BLOCK * layer.inputCount;
+
+            std::size_t block = 0;
+
+            for (; block + GEMV_BLOCKS <= blockCount; block += GEMV_BLOCKS) {
+                ComputeRows<GEMV_BLOCKS>(weights + block * blockSize, bias + block * ROW_BLOCK, layerInput, layer.inputCount, layerOutput + block * ROW_BLOCK, layer.activation);
+            }
+
+            for (; block < blockCount; block++) {
+                ComputeRows<1>(weights + block * blockSize, bias + block * ROW_BLOCK, layerInput, layer.inputCount, layerOutput + block * ROW_BLOCK, layer.activation);
+            }
+
+            layerInput = layerOutput;
+        }
+
+        std::memcpy(output, layerInput, layers.back().outputCount * sizeof(float));
+    }
+
+    std::size_t InferenceModel::inputSize() const
+    {
+        return inputCount;
+    }
+
+    std::size_t InferenceModel::outputSize() const
+    {
+        return layers.back().outputCount;
+    }
+
+    std::size_t InferenceModel::maxBatchSize() const
+    {
+        return batchSize;
+    }
+
+    std::size_t InferenceModel::sparseLayerCount() const
+    {
+        return std::count_if(layers.begin(), layers.end(), [](const PackedLayer &layer) { return layer.sparse; });
+    }
+}
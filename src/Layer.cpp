@@ -3,24 +3,39 @@
 #include <string>
 #include <random>
 #include <chrono>
+#include <cmath>
 #include <functional>
+#include <stdexcept>
 
 #include "ActivationFn.hpp"
 #include "Layer.hpp"
+#include "LowRank.hpp"
 #include "Matrix.hpp"
+#include "MixedPrecision.hpp"
 #include "Neuron.hpp"
+#include "Optimizer.hpp"
+#include "Profiler.hpp"
+#include "Pruning.hpp"
+#include "SparseMatrix.hpp"
 #include "Vector.hpp"
 
 namespace NeuralNetwork
 {
     Layer::Layer()
-        : neuronCount(1), weightMatrix(Math::Matrix(1, 1)), biasVector(Math::Vector(1)), valueMatrix(Math::Matrix(1, 1)), activationFn(nullptr) {};
+        : neuronCount(1), weightMatrix(Math::Matrix(1, 1)), biasVector(Math::Vector(1)), valueMatrix(Math::Matrix(1, 1)), pruningMask(Math::Matrix(1, 1)), pruned(false), rank(0), factorU(Math::Matrix(1, 1)), factorV(Math::Matrix(1, 1)), factorValues(Math::Matrix(1, 1)), precision(Precision::Double), activationFn(nullptr) {};
 
     Layer::Layer(std::size_t p_count)
-        : neuronCount(p_count), weightMatrix(Math::Matrix(p_count, 1)), biasVector(Math::Vector(p_count)), valueMatrix(Math::Matrix(p_count, 1)), activationFn(nullptr) {};
+        : neuronCount(p_count), weightMatrix(Math::Matrix(p_count, 1)), biasVector(Math::Vector(p_count)), valueMatrix(Math::Matrix(p_count, 1)), pruningMask(Math::Matrix(1, 1)), pruned(false), rank(0), factorU(Math::Matrix(1, 1)), factorV(Math::Matrix(1, 1)), factorValues(Math::Matrix(1, 1)), precision(Precision::Double), activationFn(nullptr) {};
 
     Layer::Layer(std::size_t p_count, ActivationFn::ActivationFn *p_fn)
-        : neuronCount(p_count), weightMatrix(Math::Matrix(p_count, 1)), biasVector(Math::Vector(p_count)), valueMatrix(Math::Matrix(p_count, 1)), activationFn(p_fn) {};
+        : neuronCount(p_count), weightMatrix(Math::Matrix(p_count, 1)), biasVector(Math::Vector(p_count)), valueMatrix(Math::Matrix(p_count, 1)), pruningMask(Math::Matrix(1, 1)), pruned(false), rank(0), factorU(Math::Matrix(1, 1)), factorV(Math::Matrix(1, 1)), factorValues(Math::Matrix(1, 1)), precision(Precision::Double), activationFn(p_fn) {};
+
+    Layer::Layer(std::size_t p_count, ActivationFn::ActivationFn *p_fn, std::size_t p_rank)
+        : neuronCount(p_count), weightMatrix(Math::Matrix(1, 1)), biasVector(Math::Vector(p_count)), valueMatrix(Math::Matrix(p_count, 1)), pruningMask(Math::Matrix(1, 1)), pruned(false), rank(p_rank), factorU(Math::Matrix(p_count, p_rank)), factorV(Math::Matrix(p_rank, 1)), factorValues(Math::Matrix(p_rank, 1)), precision(Precision::Double), activationFn(p_fn)
+    {
+        if (rank == 0 || rank > neuronCount)
+            throw std::invalid_argument("rank must be positive and at most the number of neurons");
+    };
 
     Layer::~Layer()
     {
@@ -28,20 +43,59 @@ namespace NeuralNetwork
     };
 
     Layer::Layer(const Layer &p_layer)
-        : neuronCount(p_layer.neuronCount), connectionCount(p_layer.connectionCount), weightMatrix(p_layer.weightMatrix), biasVector(p_layer.biasVector), valueMatrix(p_layer.valueMatrix), activationFn(nullptr)
+        : neuronCount(p_layer.neuronCount), connectionCount(p_layer.connectionCount), weightMatrix(p_layer.weightMatrix), biasVector(p_layer.biasVector), valueMatrix(p_layer.valueMatrix), pruningMask(p_layer.pruningMask), pruned(p_layer.pruned), rank(p_layer.rank), factorU(p_layer.factorU), factorV(p_layer.factorV), factorValues(p_layer.factorValues), precision(p_layer.precision), lowPrecisionWeights(p_layer.lowPrecisionWeights), activationFn(nullptr)
     {
         if (p_layer.activationFn)
             activationFn = p_layer.activationFn->clone();
     };
 
+    Layer &Layer::operator=(const Layer &p_layer)
+    {
+        if (this == &p_layer)
+            return *this;
+
+        neuronCount = p_layer.neuronCount;
+        connectionCount = p_layer.connectionCount;
+        weightMatrix = p_layer.weightMatrix;
+        biasVector = p_layer.biasVector;
+        valueMatrix = p_layer.valueMatrix;
+        pruningMask = p_layer.pruningMask;
+        pruned = p_layer.pruned;
+        rank = p_layer.rank;
+        factorU = p_layer.factorU;
+        factorV = p_layer.factorV;
+        factorValues = p_layer.factorValues;
+        precision = p_layer.precision;
+        lowPrecisionWeights = p_layer.lowPrecisionWeights;
+
+        delete activationFn;
+        activationFn = p_layer.activationFn ? p_layer.activationFn->clone() : nullptr;
+
+        return *this;
+    };
+
     void Layer::InitializeConnections(std::size_t count)
     {
         srand(std::chrono::system_clock::now().time_since_epoch().count());
 
         connectionCount = count;
-
-        weightMatrix = Math::Matrix::RandomMatrix(neuronCount, connectionCount, -0.1, 0.1);
         biasVector = Math::Matrix(neuronCount, 1);
+        pruned = false;
+
+        if (rank == 0) {
+            weightMatrix = Math::Matrix::RandomMatrix(neuronCount, connectionCount, -0.1, 0.1);
+            return;
+        }
+
+        if (rank > connectionCount)
+            throw std::invalid_argument("rank must be at most the number of connections");
+
+        // The product of the factors has the variance of weights drawn from [-0.1, 0.1], rank * (bound^2 / 3)^2 = 0.1^2 / 3
+        const double bound = std::pow(0.03 / rank, 0.25);
+
+        weightMatrix = Math::Matrix(1, 1);
+        factorU = Math::Matrix::RandomMatrix(neuronCount, rank, -bound, bound);
+        factorV = Math::Matrix::RandomMatrix(rank, connectionCount, -bound, bound);
     };
 
     Math::Matrix Layer::Output()
@@ -54,20 +108,270 @@ namespace NeuralNetwork
 
     Math::Matrix Layer::CalculateValues(Math::Matrix input)
     {
+        NN_PROFILE_SCOPE("Layer::CalculateValues", 0, 0);
+
         if (input.rows != connectionCount)
             throw std::invalid_argument("input dimensions do not match specified dimensions");
 
-        valueMatrix = weightMatrix * input + biasVector;
+        if (rank) {
+            factorValues = factorV * input;
+            valueMatrix = factorU * factorValues + biasVector;
+        }
+        else if (lowPrecision()) {
+            std::vector<float> lowPrecisionInput(input.rows * input.cols);
+            ToLowPrecision(input.data(), input.rows, input.cols, precision, false, lowPrecisionInput.data());
+
+            valueMatrix.Resize(neuronCount, input.cols);
+            LowPrecisionProduct(lowPrecisionWeights.data(), connectionCount, 1, lowPrecisionInput.data(), neuronCount, connectionCount, input.cols, biasVector.data(), valueMatrix.data());
+        }
+        else {
+            valueMatrix = weightMatrix * input + biasVector;
+        }
+
+        return Output();
+    };
+
+    Math::Matrix Layer::CalculateValues(const Math::SparseMatrix &input)
+    {
+        NN_PROFILE_SCOPE("Layer::CalculateValues (sparse)", 0, 0);
+
+        if (input.cols != connectionCount)
+            throw std::invalid_argument("input dimensions do not match specified dimensions");
+
+        if (rank) {
+            factorValues = input.TransposedProduct(factorV);
+            valueMatrix = factorU * factorValues + biasVector;
+        }
+        else {
+            valueMatrix = input.TransposedProduct(weightMatrix) + biasVector;
+        }
 
         return Output();
     };
 
+    Math::Matrix Layer::Weights() const
+    {
+        return rank ? factorU * factorV : weightMatrix;
+    };
+
+    Math::Matrix Layer::CalculateInputDerivatives(const Math::Matrix &adjustmentMatrix)
+    {
+        NN_PROFILE_SCOPE("Layer::CalculateInputDerivatives", 0, 0);
+
+        if (rank)
+            return factorV.Transpose() * (factorU.Transpose() * adjustmentMatrix);
+
+        if (lowPrecision()) {
+            std::vector<float> lowPrecisionAdjustments(adjustmentMatrix.rows * adjustmentMatrix.cols);
+            ToLowPrecision(adjustmentMatrix.data(), adjustmentMatrix.rows, adjustmentMatrix.cols, precision, false, lowPrecisionAdjustments.data());
+
+            // the weights are read transposed through their strides
+            Math::Matrix inputDerivatives(connectionCount, adjustmentMatrix.cols);
+            LowPrecisionProduct(lowPrecisionWeights.data(), 1, connectionCount, lowPrecisionAdjustments.data(), connectionCount, neuronCount, adjustmentMatrix.cols, nullptr, inputDerivatives.data());
+
+            return inputDerivatives;
+        }
+
+        return weightMatrix.Transpose() * adjustmentMatrix;
+    };
+
+    Math::Matrix Layer::CalculateWeightDerivatives(const Math::Matrix &adjustmentMatrix, Math::Matrix input)
+    {
+        NN_PROFILE_SCOPE("Layer::CalculateWeightDerivatives", 0, 0);
+
+        if (adjustmentMatrix.cols != input.cols)
+            throw std::invalid_argument("number of adjustments do not match number of inputs");
+
+        if (!lowPrecision())
+            return adjustmentMatrix * input.Transpose();
+
+        std::vector<float> lowPrecisionAdjustments(adjustmentMatrix.rows * adjustmentMatrix.cols);
+        std::vector<float> lowPrecisionInput(input.rows * input.cols);
+        ToLowPrecision(adjustmentMatrix.data(), adjustmentMatrix.rows, adjustmentMatrix.cols, precision, false, lowPrecisionAdjustments.data());
+        ToLowPrecision(input.data(), input.rows, input.cols, precision, true, lowPrecisionInput.data());
+
+        Math::Matrix weightDerivatives(adjustmentMatrix.rows, input.rows);
+        LowPrecisionProduct(lowPrecisionAdjustments.data(), adjustmentMatrix.cols, 1, lowPrecisionInput.data(), adjustmentMatrix.rows, input.cols, input.rows, nullptr, weightDerivatives.data());
+
+        return weightDerivatives;
+    };
+
+    void Layer::SetPrecision(Precision p_precision)
+    {
+        precision = p_precision;
+
+        if (lowPrecision()) {
+            lowPrecisionWeights.resize(neuronCount * connectionCount);
+            ToLowPrecision(weightMatrix.data(), neuronCount, connectionCount, precision, false, lowPrecisionWeights.data());
+        }
+        else {
+            lowPrecisionWeights = std::vector<float>();
+        }
+    };
+
+    bool Layer::lowPrecision() const
+    {
+        return precision != Precision::Double && rank == 0;
+    };
+
     void Layer::AdjustNeurons(Math::Matrix weightShiftMatrix, Math::Vector biasShiftVector, double mult)
     {
+        if (rank)
+            throw std::invalid_argument("factorized layers are adjusted through their factors");
+
         if (weightMatrix.rows != weightShiftMatrix.rows || weightMatrix.cols != weightShiftMatrix.cols || biasVector.size() != biasShiftVector.size())
             throw std::invalid_argument("number of adjustments do not match number of neurons");
 
-        weightMatrix += weightShiftMatrix * mult;
+        // pruned weights are not adjusted, so they stay at zero
+        if (pruned)
+            weightMatrix += (weightShiftMatrix & pruningMask) * mult;
+        else
+            weightMatrix += weightShiftMatrix * mult;
+
+        biasVector += biasShiftVector * mult;
+    };
+
+    void Layer::AdjustNeurons(const Math::Matrix &adjustmentMatrix, const Math::SparseMatrix &input, Math::Vector biasShiftVector, double mult)
+    {
+        if (adjustmentMatrix.rows != neuronCount || input.cols != connectionCount || biasVector.size() != biasShiftVector.size())
+            throw std::invalid_argument("number of adjustments do not match number of neurons");
+
+        if (rank)
+            throw std::invalid_argument("factorized layers are adjusted through their factors");
+
+        input.AddProduct(adjustmentMatrix, mult, weightMatrix, pruned ? &pruningMask : nullptr);
         biasVector += biasShiftVector * mult;
     };
+
+    void Layer::AdjustFactors(const Math::Matrix &adjustmentMatrix, Math::Matrix input, Math::Vector biasShiftVector, double mult)
+    {
+        if (!rank)
+            throw std::invalid_argument("layer is not factorized");
+
+        if (adjustmentMatrix.rows != neuronCount || input.rows != connectionCount || biasVector.size() != biasShiftVector.size())
+            throw std::invalid_argument("number of adjustments do not match number of neurons");
+
+        // Propagated through the factor before it is adjusted
+        Math::Matrix factorAdjustments = factorU.Transpose() * adjustmentMatrix;
+
+        factorU += adjustmentMatrix * factorValues.Transpose() * mult;
+        factorV += factorAdjustments * input.Transpose() * mult;
+        biasVector += biasShiftVector * mult;
+    };
+
+    void Layer::AdjustFactors(const Math::Matrix &adjustmentMatrix, const Math::SparseMatrix &input, Math::Vector biasShiftVector, double mult)
+    {
+        if (!rank)
+            throw std::invalid_argument("layer is not factorized");
+
+        if (adjustmentMatrix.rows != neuronCount || input.cols != connectionCount || biasVector.size() != biasShiftVector.size())
+            throw std::invalid_argument("number of adjustments do not match number of neurons");
+
+        Math::Matrix factorAdjustments = factorU.Transpose() * adjustmentMatrix;
+
+        factorU += adjustmentMatrix * factorValues.Transpose() * mult;
+        input.AddProduct(factorAdjustments, mult, factorV);
+        biasVector += biasShiftVector * mult;
+    };
+
+    const std::size_t Layer::OPTIMIZER_SLOTS;
+
+    void Layer::Optimize(Optimizer::Optimizer &optimizer, std::size_t slot, const Math::Matrix &weightGradients, const Math::Vector &biasGradients, double learningRate)
+    {
+        NN_PROFILE_SCOPE("Layer::Optimize", 0, 0);
+
+        if (rank)
+            throw std::invalid_argument("factorized layers are optimized from their adjustments and inputs");
+
+        if (weightMatrix.rows != weightGradients.rows || weightMatrix.cols != weightGradients.cols || biasVector.size() != biasGradients.size())
+            throw std::invalid_argument("number of gradients do not match number of parameters");
+
+        // pruned weights are masked, so they stay at zero
+        optimizer.Update(slot, weightMatrix.data(), weightGradients.data(), weightMatrix.rows * weightMatrix.cols, learningRate, pruned ? pruningMask.data() : nullptr);
+        optimizer.Update(slot + 2, biasVector.data(), biasGradients.data(), neuronCount, learningRate, nullptr, false);
+
+        if (lowPrecision())
+            ToLowPrecision(weightMatrix.data(), neuronCount, connectionCount, precision, false, lowPrecisionWeights.data());
+    };
+
+    void Layer::Optimize(Optimizer::Optimizer &optimizer, std::size_t slot, const Math::Matrix &adjustmentMatrix, Math::Matrix input, const Math::Vector &biasGradients, double learningRate)
+    {
+        NN_PROFILE_SCOPE("Layer::Optimize (factorized)", 0, 0);
+
+        if (!rank)
+            return Optimize(optimizer, slot, CalculateWeightDerivatives(adjustmentMatrix, input), biasGradients, learningRate);
+
+        if (adjustmentMatrix.rows != neuronCount || input.rows != connectionCount || biasVector.size() != biasGradients.size())
+            throw std::invalid_argument("number of adjustments do not match number of neurons");
+
+        // Propagated through the first factor before it is updated
+        Math::Matrix factorAdjustments = factorU.Transpose() * adjustmentMatrix;
+        Math::Matrix factorUGradients = adjustmentMatrix * factorValues.Transpose();
+        Math::Matrix factorVGradients = factorAdjustments * input.Transpose();
+
+        optimizer.Update(slot, factorU.data(), factorUGradients.data(), neuronCount * rank, learningRate);
+        optimizer.Update(slot + 1, factorV.data(), factorVGradients.data(), rank * connectionCount, learningRate);
+        optimizer.Update(slot + 2, biasVector.data(), biasGradients.data(), neuronCount, learningRate, nullptr, false);
+    };
+
+    void Layer::Optimize(Optimizer::Optimizer &optimizer, std::size_t slot, const Math::Matrix &adjustmentMatrix, const Math::SparseMatrix &input, const Math::Vector &biasGradients, double learningRate)
+    {
+        NN_PROFILE_SCOPE("Layer::Optimize (sparse)", 0, 0);
+
+        if (optimizer.id() == Optimizer::Id::SGD) {
+            if (rank)
+                AdjustFactors(adjustmentMatrix, input, biasGradients, -learningRate);
+            else
+                AdjustNeurons(adjustmentMatrix, input, biasGradients, -learningRate);
+
+            if (lowPrecision())
+                ToLowPrecision(weightMatrix.data(), neuronCount, connectionCount, precision, false, lowPrecisionWeights.data());
+
+            return;
+        }
+
+        if (adjustmentMatrix.rows != neuronCount || input.cols != connectionCount || biasVector.size() != biasGradients.size())
+            throw std::invalid_argument("number of adjustments do not match number of neurons");
+
+        if (!rank) {
+            Math::Matrix weightGradients(neuronCount, connectionCount);
+            input.AddProduct(adjustmentMatrix, 1, weightGradients);
+
+            return Optimize(optimizer, slot, weightGradients, biasGradients, learningRate);
+        }
+
+        Math::Matrix factorAdjustments = factorU.Transpose() * adjustmentMatrix;
+        Math::Matrix factorUGradients = adjustmentMatrix * factorValues.Transpose();
+        Math::Matrix factorVGradients(rank, connectionCount);
+        input.AddProduct(factorAdjustments, 1, factorVGradients);
+
+        optimizer.Update(slot, factorU.data(), factorUGradients.data(), neuronCount * rank, learningRate);
+        optimizer.Update(slot + 1, factorV.data(), factorVGradients.data(), rank * connectionCount, learningRate);
+        optimizer.Update(slot + 2, biasVector.data(), biasGradients.data(), neuronCount, learningRate, nullptr, false);
+    };
+
+    LowRankFactors Layer::Factorize(std::size_t p_rank)
+    {
+        LowRankFactors factors = TruncatedSVD(Weights(), p_rank);
+
+        rank = p_rank;
+        factorU = factors.u;
+        factorV = factors.v;
+        weightMatrix = Math::Matrix(1, 1);
+        pruned = false;
+
+        return factors;
+    };
+
+    void Layer::Prune(const PruningOptions &options)
+    {
+        if (rank)
+            throw std::invalid_argument("factorized layers cannot be pruned");
+
+        Math::Matrix mask = PruningMask(weightMatrix, options);
+
+        pruningMask = pruned ? mask & pruningMask : mask;
+        weightMatrix = weightMatrix & pruningMask;
+        pruned = true;
+    };
 }
\ No newline at end of file
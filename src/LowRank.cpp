@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "LowRank.hpp"
+#include "Matrix.hpp"
+
+namespace NeuralNetwork
+{
+    namespace
+    {
+        // Rows are orthogonal enough once their correlation is below this, relative to their norms
+        const double JACOBI_TOLERANCE = 1e-12;
+        const std::size_t MAX_JACOBI_SWEEPS = 60;
+
+        double Dot(const double *a, const double *b, std::size_t size)
+        {
+            double sum = 0;
+
+            for (std::size_t k = 0; k < size; k++) {
+                sum += a[k] * b[k];
+            }
+
+            return sum;
+        }
+
+        /**
+         * Rotates a pair of rows in place, `a = c * a - s * b` and `b = s * a + c * b`
+         */
+        void Rotate(double *a, double *b, std::size_t size, double c, double s)
+        {
+            for (std::size_t k = 0; k < size; k++) {
+                const double x = a[k];
+                const double y = b[k];
+
+                a[k] = c * x - s * y;
+                b[k] = s * x + c * y;
+            }
+        }
+    }
+
+    LowRankFactors TruncatedSVD(const Math::Matrix &matrix, std::size_t rank)
+    {
+        const std::size_t rows = matrix.rows;
+        const std::size_t cols = matrix.cols;
+
+        if (rank == 0 || rank > std::min(rows, cols))
+            throw std::invalid_argument("rank must be positive and at most the smaller dimension of the matrix");
+
+        // Rotating the rows until they are orthogonal gives `rotated = rotation * matrix`, so `matrix = transpose(rotation) * rotated`,
+        // where the norms of the rotated rows are the singular values and the rows of the rotation the left singular vectors
+        std::vector<double> rotated(matrix.data(), matrix.data() + rows * cols);
+        std::vector<double> rotation(rows * rows, 0);
+
+        for (std::size_t i = 0; i < rows; i++) {
+            rotation[i * rows + i] = 1;
+        }
+
+        for (std::size_t sweep = 0; sweep < MAX_JACOBI_SWEEPS; sweep++) {
+            bool converged = true;
+
+            for (std::size_t i = 0; i < rows; i++) {
+                for (std::size_t j = i + 1; j < rows; j++) {
+                    double *a = &rotated[i * cols];
+                    double *b = &rotated[j * cols];
+
+                    const double alpha = Dot(a, a, cols);
+                    const double beta = Dot(b, b, cols);
+                    const double gamma = Dot(a, b, cols);
+
+                    if (std::abs(gamma) <= JACOBI_TOLERANCE * std::sqrt(alpha * beta))
+                        continue;
+
+                    converged = false;
+
+                    // Rotation zeroing the inner product of the pair, through the smaller of the two angles that do
+                    const double zeta = (beta - alpha) / (2 * gamma);
+                    const double t = (zeta >= 0 ? 1 : -1) / (std::abs(zeta) + std::sqrt(1 + zeta * zeta));
+                    const double c = 1 / std::sqrt(1 + t * t);
+                    const double s = c * t;
+
+                    Rotate(a, b, cols, c, s);
+                    Rotate(&rotation[i * rows], &rotation[j * rows], rows, c, s);
+                }
+            }
+
+            if (converged)
+                break;
+        }
+
+        std::vector<double> norms(rows);
+
+        for (std::size_t i = 0; i < rows; i++) {
+            norms[i] = std::sqrt(Dot(&rotated[i * cols], &rotated[i * cols], cols));
+        }
+
+        std::vector<std::size_t> order(rows);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&norms](std::size_t a, std::size_t b) { return norms[a] > norms[b]; });
+
+        LowRankFactors factors = {Math::Matrix(rows, rank), Math::Matrix(rank, cols), std::vector<double>(std::min(rows, cols))};
+        double *u = factors.u.data();
+        double *v = factors.v.data();
+
+        for (std::size_t k = 0; k < factors.singularValues.size(); k++) {
+            factors.singularValues[k] = norms[order[k]];
+        }
+
+        for (std::size_t k = 0; k < rank; k++) {
+            const std::size_t source = order[k];
+            const double norm = norms[source];
+
+            // A zero singular value leaves both factors zero for its rank
+            if (norm == 0)
+                continue;
+
+            const double scale = std::sqrt(norm);
+
+            for (std::size_t i = 0; i < rows; i++) {
+                u[i * rank + k] = rotation[source * rows + i] * scale;
+            }
+
+            for (std::size_t j = 0; j < cols; j++) {
+                v[k * cols + j] = rotated[source * cols + j] / scale;
+            }
+        }
+
+        return factors;
+    }
+}
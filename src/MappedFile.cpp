@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "AlignedBuffer.hpp"
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &pathname)
+    : mapping(nullptr), mappingSize(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+{
+    fileHandle = CreateFileA(pathname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("error opening file at \"" + pathname + "\"");
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    mappingSize = fileSize.QuadPart;
+
+    // Empty files cannot be mapped, and are left as an empty mapping
+    if (mappingSize == 0)
+        return;
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mappingHandle)
+        mapping = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+
+    if (!mapping) {
+        if (mappingHandle)
+            CloseHandle(mappingHandle);
+
+        CloseHandle(fileHandle);
+        throw std::runtime_error("error mapping file at \"" + pathname + "\"");
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapping)
+        UnmapViewOfFile(mapping);
+
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+
+    CloseHandle(fileHandle);
+}
+
+void MappedFile::AdviseSequential() const {}
+
+#else
+
+MappedFile::MappedFile(const std::string &pathname)
+    : mapping(nullptr), mappingSize(0)
+{
+    int file = open(pathname.c_str(), O_RDONLY);
+
+    if (file < 0)
+        throw std::runtime_error("error opening file at \"" + pathname + "\"");
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0) {
+        close(file);
+        throw std::runtime_error("error reading size of file at \"" + pathname + "\"");
+    }
+
+    mappingSize = status.st_size;
+
+    // Empty files cannot be mapped, and are left as an empty mapping
+    if (mappingSize > 0) {
+        void *address = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, file, 0);
+
+        if (address == MAP_FAILED) {
+            close(file);
+            throw std::runtime_error("error mapping file at \"" + pathname + "\"");
+        }
+
+        mapping = static_cast<const char *>(address);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(file);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mapping)
+        munmap(const_cast<char *>(mapping), mappingSize);
+}
+
+void MappedFile::AdviseSequential() const
+{
+    if (mapping)
+        posix_madvise(const_cast<char *>(mapping), mappingSize, POSIX_MADV_SEQUENTIAL);
+}
+
+#endif
+
+const char *MappedFile::data() const
+{
+    return mapping;
+}
+
+std::size_t MappedFile::size() const
+{
+    return mappingSize;
+}
+
+bool MappedFile::IsLittleEndian()
+{
+    const std::uint16_t value = 1;
+    return *reinterpret_cast<const unsigned char *>(&value) == 1;
+}
+
+void MappedFile::WritePadding(std::ostream &file, std::size_t alignment)
+{
+    static const char zeros[4096] = {};
+    const std::size_t position = file.tellp();
+
+    for (std::size_t padding = AlignedBuffer::AlignUp(position, alignment) - position; padding > 0;) {
+        const std::size_t count = std::min(padding, sizeof(zeros));
+        file.write(zeros, count);
+        padding -= count;
+    }
+}
@@ -4,35 +4,61 @@
 #include <random>
 #include <chrono>
 #include <algorithm>
+#include <new>
 
 #include "Matrix.hpp"
+#include "Profiler.hpp"
 #include "Vector.hpp"
-#include "ThreadPool.hpp"
+#include "Threadpool.hpp"
 
 namespace Math
 {
+    void *AllocateStorage(std::size_t bytes)
+    {
+        void *pointer = ::operator new(bytes);
+        NN_PROFILE_ALLOCATION(bytes);
+
+        return pointer;
+    }
+
+    void FreeStorage(void *pointer, std::size_t bytes)
+    {
+        NN_PROFILE_DEALLOCATION(bytes);
+        ::operator delete(pointer);
+    }
+
     ThreadPool Matrix::threadPool;
     
-    void Matrix::UseThreadPool(std::function<void(unsigned int start, unsigned int end)> fn, int total)
+    void Matrix::UseThreadPool(std::function<void(unsigned int start, unsigned int end)> fn, int total, double bytesPerRow, double flopsPerRow, int granularity)
     {
         std::condition_variable event;
         static std::mutex eventMutex;
         std::atomic<int> completedTasksCount(0);
 
-        const int MAX_THREADS = Matrix::threadPool.poolSize();
-        const int THREAD_NUM = std::min({total, MAX_THREADS});
+        if (total <= 0)
+            return;
 
-        int block = total / THREAD_NUM;
+        const int MAX_THREADS = Matrix::threadPool.poolSize();
+        const int blockCount = (total + granularity - 1) / granularity;
+        const int THREAD_NUM = std::min({blockCount, MAX_THREADS});
 
-        int start = 0;
-        int end = block;
+        // rows are split into chunks of whole blocks, the last chunk ending at the last row
+        const int block = (blockCount + THREAD_NUM - 1) / THREAD_NUM * granularity;
+        int taskCount = 0;
 
-        for (int i = 0; i < THREAD_NUM; i++)
+        for (int start = 0; start < total; start += block)
         {
+            const int end = std::min(start + block, total);
+            taskCount++;
 
             Matrix::threadPool.QueueTask(
-                [start, end, &fn, &completedTasksCount, &event] {
-                    fn(start, end);
+                [=, &fn, &completedTasksCount, &event] {
+                    {
+                        // so the counters of pool threads are read with the work they do, the region on the calling thread only counting its own
+                        NN_PROFILE_SCOPE("Matrix threadpool task", (end - start) * bytesPerRow, (end - start) * flopsPerRow);
+                        fn(start, end);
+                    }
+
                     {
                         std::unique_lock<std::mutex> lock{eventMutex};
                         completedTasksCount.fetch_add(1);
@@ -40,14 +66,13 @@ namespace Math
                     }
                 }
             );
-            start = end;
-            end = std::min(end + block, total);
         }
 
         {
+            NN_PROFILE_SCOPE("Matrix threadpool wait", 0, 0);
             std::unique_lock<std::mutex> lock{eventMutex};
-            event.wait(lock, [&completedTasksCount, THREAD_NUM]
-                        { return completedTasksCount == THREAD_NUM; });
+            event.wait(lock, [&completedTasksCount, taskCount]
+                        { return completedTasksCount == taskCount; });
             event.notify_all();
         }
     };
@@ -58,7 +83,7 @@ namespace Math
         if (rows < 1 || cols < 1) 
             throw std::invalid_argument("matrix dimensions must be positive");
 
-        values = std::vector<double>(rows * cols, 0);
+        values = Storage(rows * cols, 0);
     };
 
     Matrix::Matrix(std::size_t p_rows, std::size_t p_cols, double value)
@@ -67,7 +92,7 @@ namespace Math
         if (rows < 1 || cols < 1) 
             throw std::invalid_argument("matrix dimensions must be positive");
         
-        values = std::vector<double>(rows * cols, value);
+        values = Storage(rows * cols, value);
     };
 
 
@@ -86,7 +111,7 @@ namespace Math
             }
         }
         
-        values = std::vector<double>(rows * cols, 0);
+        values = Storage(rows * cols, 0);
 
         for (unsigned int i = 0; i < rows; i++) {
             for (unsigned int j = 0; j < cols; j++) {
@@ -109,7 +134,7 @@ namespace Math
             }
         }
             
-        values = std::vector<double>(rows * cols, 0);
+        values = Storage(rows * cols, 0);
 
         for (unsigned int i = 0; i < rows; i++) {
             for (unsigned int j = 0; j < cols; j++) {
@@ -127,7 +152,7 @@ namespace Math
         if (p_values.size() != rows * cols) 
             throw std::invalid_argument("length of values array does not match matrix size");
             
-        values = p_values;
+        values.assign(p_values.begin(), p_values.end());
     };
 
     Matrix Matrix::RandomMatrix(std::size_t rows, std::size_t cols, double min, double max)
@@ -149,6 +174,8 @@ namespace Math
 
     Matrix Matrix::operator+(Matrix const &matrix) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator+", 3 * rows * cols * sizeof(double), rows * cols);
+
         if (rows != matrix.rows || cols != matrix.cols)
             throw std::invalid_argument("matrices are not of the same size");
 
@@ -163,13 +190,15 @@ namespace Math
 
     Matrix Matrix::operator+(Vector const &vector) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator+ (vector)", (2 * rows * cols + rows) * sizeof(double), rows * cols);
+
         if (rows != vector.size())
             throw std::invalid_argument("vector cannot be expanded to matrix of the same size");
 
         Matrix result(rows, cols);
 
         for (unsigned int i = 0; i < rows * cols; i++) {
-                result.values[i] = values[i] + vector.values[i % vector.rows];
+                result.values[i] = values[i] + vector.values[i / cols];
         }
 
         return result;
@@ -177,6 +206,8 @@ namespace Math
 
     Matrix &Matrix::operator+=(Matrix const &matrix)
     {
+        NN_PROFILE_SCOPE("Matrix::operator+=", 3 * rows * cols * sizeof(double), rows * cols);
+
         if (rows != matrix.rows || cols != matrix.cols)
             throw std::invalid_argument("matrices are not of the same size");
 
@@ -189,6 +220,8 @@ namespace Math
 
     Matrix Matrix::operator-(Matrix const &matrix) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator-", 3 * rows * cols * sizeof(double), rows * cols);
+
         if (rows != matrix.rows || cols != matrix.cols)
             throw std::invalid_argument("matrices are not of the same size");
 
@@ -203,13 +236,15 @@ namespace Math
 
     Matrix Matrix::operator-(Vector const &vector) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator- (vector)", (2 * rows * cols + rows) * sizeof(double), rows * cols);
+
         if (rows != vector.size())
             throw std::invalid_argument("vector cannot be expanded to matrix of the same size");
 
         Matrix result(rows, cols);
 
         for (unsigned int i = 0; i < rows * cols; i++) {
-                result.values[i] = values[i] - vector.values[i % vector.rows];
+                result.values[i] = values[i] - vector.values[i / cols];
         }
 
         return result;
@@ -217,6 +252,8 @@ namespace Math
 
     Matrix &Matrix::operator-=(Matrix const &matrix)
     {
+        NN_PROFILE_SCOPE("Matrix::operator-=", 3 * rows * cols * sizeof(double), rows * cols);
+
         if (rows != matrix.rows || cols != matrix.cols)
             throw std::invalid_argument("matrices are not of the same size");
 
@@ -229,11 +266,13 @@ namespace Math
 
     Matrix Matrix::operator-()
     {
-        return Matrix(rows, cols, values) * -1.0;
+        return *this * -1.0;
     };
 
     Matrix operator*(const double &num, Matrix const &matrix)
     {
+        NN_PROFILE_SCOPE("Matrix::operator* (scalar)", 2 * matrix.rows * matrix.cols * sizeof(double), matrix.rows * matrix.cols);
+
         Matrix result(matrix.rows, matrix.cols);
 
         for (unsigned int i = 0; i < matrix.rows; i++) {
@@ -247,6 +286,8 @@ namespace Math
 
     Matrix Matrix::operator*(const double &num) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator* (scalar)", 2 * rows * cols * sizeof(double), rows * cols);
+
         Matrix result(rows, cols);
 
         for (unsigned int i = 0; i < rows; i++) {
@@ -260,6 +301,8 @@ namespace Math
 
     Matrix &Matrix::operator*=(const double &num)
     {
+        NN_PROFILE_SCOPE("Matrix::operator*=", 2 * rows * cols * sizeof(double), rows * cols);
+
         for (unsigned int i = 0; i < rows; i++) {
             for (unsigned int j = 0; j < cols; j++) {
                 values[i * cols + j] *= num;
@@ -271,6 +314,8 @@ namespace Math
 
     Matrix Matrix::operator/(const double &num) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator/", 2 * rows * cols * sizeof(double), rows * cols);
+
         Matrix result(rows, cols);
 
         for (unsigned int i = 0; i < rows; i++) {
@@ -284,6 +329,8 @@ namespace Math
 
     Matrix &Matrix::operator/=(const double &num)
     {
+        NN_PROFILE_SCOPE("Matrix::operator/=", 2 * rows * cols * sizeof(double), rows * cols);
+
         for (unsigned int i = 0; i < rows; i++) {
             for (unsigned int j = 0; j < cols; j++) {
                 values[i * cols + j] /= num;
@@ -295,6 +342,8 @@ namespace Math
 
     Matrix Matrix::operator*(Matrix const &matrix) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator*", (rows * cols + matrix.rows * matrix.cols + rows * matrix.cols) * sizeof(double), 2 * rows * cols * matrix.cols);
+
         if (cols != matrix.rows)
             throw std::invalid_argument("left matrix column count and right matrix row count does not match");
     
@@ -312,7 +361,8 @@ namespace Math
                         }
                     }
                 }
-            , rows);
+            // each row of the result reads a row of the left matrix, and its share of the right matrix
+            , rows, (cols + matrix.cols + (double) matrix.rows * matrix.cols / rows) * sizeof(double), 2.0 * cols * matrix.cols);
         }
         else {
             for (unsigned int i = 0; i < rows; i++) {
@@ -329,6 +379,8 @@ namespace Math
 
     Matrix Matrix::operator&(Matrix const &matrix) const
     {
+        NN_PROFILE_SCOPE("Matrix::operator&", 3 * rows * cols * sizeof(double), rows * cols);
+
         if (rows != matrix.rows || cols != matrix.cols)
             throw std::invalid_argument("matrices are not of the same size");
 
@@ -359,12 +411,32 @@ namespace Math
         return values[row * cols + col];
     }
 
+    double *Matrix::data()
+    {
+        return values.data();
+    }
+
+    const double *Matrix::data() const
+    {
+        return values.data();
+    }
+
+    void Matrix::Resize(std::size_t p_rows, std::size_t p_cols)
+    {
+        if (p_rows < 1 || p_cols < 1) 
+            throw std::invalid_argument("matrix dimensions must be positive");
+
+        rows = p_rows;
+        cols = p_cols;
+        values.resize(rows * cols);
+    }
+
     Matrix::operator std::vector<double>() const
     {
         if (rows != 1 && cols != 1)
             throw std::invalid_argument("only column or row matrices can be cast to vectors");
 
-        return values;
+        return std::vector<double>(values.begin(), values.end());
     }
 
     Matrix::operator double() const
@@ -377,6 +449,8 @@ namespace Math
 
     Matrix Matrix::Transpose()
     {
+        NN_PROFILE_SCOPE("Matrix::Transpose", 2 * rows * cols * sizeof(double), 0);
+
         Matrix result(cols, rows);
 
         for (unsigned int i = 0; i < rows; i++) {
@@ -390,6 +464,8 @@ namespace Math
 
     Matrix Matrix::Apply(std::function<double(double)> fn)
     {
+        NN_PROFILE_SCOPE("Matrix::Apply", 2 * rows * cols * sizeof(double), 0);
+
         Matrix result(rows, cols);
 
         for (unsigned int i = 0; i < rows; i++) {
@@ -403,6 +479,8 @@ namespace Math
     
     Matrix Matrix::ApplyForEach(std::function<double(double, double)> fn, Matrix argMatrix)
     {
+        NN_PROFILE_SCOPE("Matrix::ApplyForEach", 3 * rows * cols * sizeof(double), 0);
+
         if (rows != argMatrix.rows || cols != argMatrix.cols)
             throw std::invalid_argument("argument matrix size not match matrix size");
         
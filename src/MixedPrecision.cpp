@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+#include "Matrix.hpp"
+#include "MixedPrecision.hpp"
+#include "Profiler.hpp"
+
+namespace NeuralNetwork
+{
+    namespace
+    {
+        // Products of fewer multiply-adds than this run on the calling thread, as waking the threadpool would cost more than they do
+        const std::size_t PARALLEL_THRESHOLD = 1 << 18;
+
+        // The output is computed in tiles of ROW_BLOCK rows by COL_BLOCK columns, whose sums stay in registers for the whole inner dimension
+        const std::size_t ROW_BLOCK = 4;
+        const std::size_t COL_BLOCK = 16;
+
+        /**
+         * Rounds a float to the nearest bfloat16, ties to even, keeping it stored as a float
+         */
+        float RoundToBFloat16(float value)
+        {
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            // infinities and NaNs are left as they are, rounding could turn a NaN into an infinity
+            if ((bits & 0x7F800000) == 0x7F800000)
+                return value;
+
+            bits += 0x7FFF + ((bits >> 16) & 1);
+            bits &= 0xFFFF0000;
+
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        template <bool BFLOAT16>
+        void Convert(const double *source, std::size_t rows, std::size_t cols, bool transpose, float *destination)
+        {
+            for (std::size_t i = 0; i < rows; i++) {
+                for (std::size_t j = 0; j < cols; j++) {
+                    const float value = (float) source[i * cols + j];
+                    destination[transpose ? j * rows + i : i * cols + j] = BFLOAT16 ? RoundToBFloat16(value) : value;
+                }
+            }
+        }
+
+#if defined(__AVX2__) && defined(__FMA__)
+        /**
+         * Computes a tile of `ROWS` rows by `COL_BLOCK` columns of the output, starting at row `i` and column `j`
+         */
+        template <std::size_t ROWS>
+        void ProductTile(const float *a, std::size_t aRowStride, std::size_t aColStride, const float *b, std::size_t inner, std::size_t cols, const double *bias, double *output, std::size_t i, std::size_t j)
+        {
+            __m256 sums[ROWS][2];
+
+            for (std::size_t r = 0; r < ROWS; r++) {
+                sums[r][0] = _mm256_setzero_ps();
+                sums[r][1] = _mm256_setzero_ps();
+            }
+
+            for (std::size_t k = 0; k < inner; k++) {
+                const __m256 b0 = _mm256_loadu_ps(b + k * cols + j);
+                const __m256 b1 = _mm256_loadu_ps(b + k * cols + j + 8);
+
+                for (std::size_t r = 0; r < ROWS; r++) {
+                    const __m256 value = _mm256_set1_ps(a[(i + r) * aRowStride + k * aColStride]);
+                    sums[r][0] = _mm256_fmadd_ps(value, b0, sums[r][0]);
+                    sums[r][1] = _mm256_fmadd_ps(value, b1, sums[r][1]);
+                }
+            }
+
+            for (std::size_t r = 0; r < ROWS; r++) {
+                const __m256d rowBias = _mm256_set1_pd(bias ? bias[i + r] : 0);
+                double *out = output + (i + r) * cols + j;
+
+                for (std::size_t h = 0; h < 2; h++) {
+                    _mm256_storeu_pd(out + 8 * h, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(sums[r][h])), rowBias));
+                    _mm256_storeu_pd(out + 8 * h + 4, _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(sums[r][h], 1)), rowBias));
+                }
+            }
+        }
+#endif
+
+        /**
+         * Computes the rows of the output from `start` to `end`
+         */
+        void ProductRows(const float *a, std::size_t aRowStride, std::size_t aColStride, const float *b, std::size_t inner, std::size_t cols, const double *bias, double *output, std::size_t start, std::size_t end)
+        {
+            std::size_t j = 0;
+
+#if defined(__AVX2__) && defined(__FMA__)
+            // a column block of the right matrix is reused by every row before moving on to the next
+            for (; j + COL_BLOCK <= cols; j += COL_BLOCK) {
+                std::size_t i = start;
+
+                for (; i + ROW_BLOCK <= end; i += ROW_BLOCK) {
+                    ProductTile<ROW_BLOCK>(a, aRowStride, aColStride, b, inner, cols, bias, output, i, j);
+                }
+
+                for (; i < end; i++) {
+                    ProductTile<1>(a, aRowStride, aColStride, b, inner, cols, bias, output, i, j);
+                }
+            }
+#endif
+
+            if (j == cols)
+                return;
+
+            // remaining columns are summed a row at a time, the inner loop being contiguous so the compiler vectorizes it
+            std::vector<float> sums(cols - j);
+
+            for (std::size_t i = start; i < end; i++) {
+                std::fill(sums.begin(), sums.end(), 0.0f);
+
+                for (std::size_t k = 0; k < inner; k++) {
+                    const float value = a[i * aRowStride + k * aColStride];
+                    const float *row = b + k * cols + j;
+
+                    for (std::size_t c = 0; c < sums.size(); c++) {
+                        sums[c] += value * row[c];
+                    }
+                }
+
+                for (std::size_t c = 0; c < sums.size(); c++) {
+                    output[i * cols + j + c] = sums[c] + (bias ? bias[i] : 0);
+                }
+            }
+        }
+    }
+
+    void ToLowPrecision(const double *source, std::size_t rows, std::size_t cols, Precision precision, bool transpose, float *destination)
+    {
+        NN_PROFILE_SCOPE("ToLowPrecision", rows * cols * (sizeof(double) + sizeof(float)), 0);
+
+        if (precision == Precision::BFloat16)
+            Convert<true>(source, rows, cols, transpose, destination);
+        else
+            Convert<false>(source, rows, cols, transpose, destination);
+    }
+
+    void LowPrecisionProduct(const float *a, std::size_t aRowStride, std::size_t aColStride, const float *b, std::size_t rows, std::size_t inner, std::size_t cols, const double *bias, double *output)
+    {
+        NN_PROFILE_SCOPE("LowPrecisionProduct", (rows * inner + inner * cols) * sizeof(float) + rows * cols * sizeof(double), 2 * rows * inner * cols);
+
+        if (rows == 0 || cols == 0)
+            return;
+
+        if (rows * inner * cols < PARALLEL_THRESHOLD || rows < 2 * ROW_BLOCK) {
+            ProductRows(a, aRowStride, aColStride, b, inner, cols, bias, output, 0, rows);
+            return;
+        }
+
+        // chunks of whole row tiles are computed by the matrix threadpool, shared with every other product of the backward pass
+        Math::Matrix::UseThreadPool(
+            [=](unsigned int start, unsigned int end) { ProductRows(a, aRowStride, aColStride, b, inner, cols, bias, output, start, end); },
+            rows, inner * sizeof(float) + cols * sizeof(double) + (double) inner * cols * sizeof(float) / rows, 2.0 * inner * cols, ROW_BLOCK
+        );
+    }
+}
@@ -1,27 +1,180 @@
 #include <iostream>
+#include <atomic>
 #include <cmath>
 #include <utility>
 #include <vector>
 #include <algorithm>
 #include <random>
 #include <chrono>
-
+#include <memory>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "ActivationFn.hpp"
+#include "AlignedBuffer.hpp"
+#include "BackgroundWorker.hpp"
+#include "BatchLoader.hpp"
 #include "Data.hpp"
+#include "DataStream.hpp"
+#include "Dataset.hpp"
+#include "DatasetStream.hpp"
+#include "Evaluator.hpp"
+#include "InferenceModel.hpp"
 #include "Layer.hpp"
+#include "LowRank.hpp"
+#include "MappedFile.hpp"
 #include "Matrix.hpp"
+#include "MixedPrecision.hpp"
 #include "NeuralNetwork.hpp"
 #include "Neuron.hpp"
+#include "Optimizer.hpp"
+#include "Profiler.hpp"
+#include "QuantizedModel.hpp"
+#include "Schedule.hpp"
+#include "TaskGraph.hpp"
+#include "Threadpool.hpp"
 
 namespace NeuralNetwork
 {
+    namespace
+    {
+        /**
+         * Draws a uniform random sample of a stream in one pass, holding only the sample in memory
+         * @param data stream to sample, rewound before reading
+         * @param count number of instances to sample
+         * @returns the sampled instances, fewer when the stream is shorter
+         */
+        Dataset SampleStream(DataStream &data, std::size_t count)
+        {
+            const std::size_t chunkSize = 1024;
+
+            Dataset sample(count, data.parameterSize(), data.labelSize());
+            Data chunk(Math::Matrix(data.parameterSize(), chunkSize), Math::Matrix(data.labelSize(), chunkSize));
+            std::default_random_engine rng(std::chrono::system_clock::now().time_since_epoch().count());
+            std::size_t seen = 0;
+
+            data.Reset();
+
+            // Reservoir sampling, the t-th instance replaces a random sampled instance with probability count / t
+            while (std::size_t read = data.Read(chunkSize, chunk)) {
+                for (std::size_t k = 0; k < read; k++, seen++) {
+                    std::size_t slot = seen < count ? seen : std::uniform_int_distribution<std::size_t>(0, seen)(rng);
+
+                    if (slot >= count)
+                        continue;
+
+                    for (std::size_t j = 0; j < data.parameterSize(); j++) {
+                        sample.Parameters(slot)[j] = chunk.parameters.data()[j * read + k];
+                    }
+
+                    for (std::size_t j = 0; j < data.labelSize(); j++) {
+                        sample.Labels(slot)[j] = chunk.label.data()[j * read + k];
+                    }
+                }
+            }
+
+            if (seen == 0)
+                throw std::invalid_argument("cannot sample an empty stream");
+
+            return seen < count ? sample.Subset(0, seen) : sample;
+        }
+
+        const char CHECKPOINT_MAGIC[8] = {'N', 'N', 'M', 'O', 'D', 'E', 'L', '\0'};
+        const std::uint32_t CHECKPOINT_VERSION = 1;
+
+        // The parameter section starts on a page boundary, and every matrix in it on a cache line
+        const std::size_t CHECKPOINT_PAGE_ALIGNMENT = 4096;
+        const std::size_t CHECKPOINT_ALIGNMENT = 64;
+
+        /**
+         * Types of the sections of a checkpoint, values must stay stable across versions
+         */
+        enum class CheckpointSection : std::uint32_t
+        {
+            Layers = 1,             // A CheckpointLayer per layer, input layer first
+            Parameters = 2,         // Weights and biases, located through the layer table
+            OptimizerState = 3      // State of the optimizer, for resuming training
+        };
+
+        /**
+         * Header at the start of a checkpoint, values are stored little endian
+         */
+        struct CheckpointHeader
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t headerSize;
+            std::uint32_t sectionCount;
+            std::uint8_t costFn;
+            std::uint8_t reserved[3];
+            std::uint64_t sectionTableOffset;   // In bytes from the start of the file
+        };
+
+        struct CheckpointSectionEntry
+        {
+            std::uint32_t type;
+            std::uint32_t reserved;
+            std::uint64_t offset;               // In bytes from the start of the file
+            std::uint64_t size;
+        };
+
+        struct CheckpointLayer
+        {
+            std::uint64_t neuronCount;
+            std::uint64_t connectionCount;      // 0 for the input layer
+            std::uint8_t activationFn;
+            std::uint8_t reserved[3];
+            std::uint32_t rank;                 // 0 for whole weights, otherwise the weights are stored as two row-major factors
+            std::uint64_t weightOffset;         // Row-major weights, or the first factor followed by the second on the next aligned offset, in bytes from the start of the file
+            std::uint64_t biasOffset;
+        };
+
+        /**
+         * Divides gradients computed from a scaled cost by the loss scale
+         * @returns whether every gradient is finite
+         */
+        bool Unscale(Math::Matrix &gradients, double scale)
+        {
+            const double inverse = 1 / scale;
+            double *values = gradients.data();
+            bool finite = true;
+
+            for (std::size_t i = 0; i < gradients.rows * gradients.cols; i++) {
+                values[i] *= inverse;
+
+                if (!std::isfinite(values[i]))
+                    finite = false;
+            }
+
+            return finite;
+        }
+
+        void PrintResults(const EvaluationResult &results)
+        {
+            std::cout << "Accuracy: " << results.accuracy << "\t\t";
+            std::cout << "Cost: " << results.cost << std::endl;
+
+            if (results.validated) {
+                std::cout << "Validation Accuracy: " << results.validationAccuracy << "\t";
+                std::cout << "Validation Cost: " << results.validationCost << std::endl;
+            }
+
+            std::cout << std::endl;
+        }
+    }
+
+    // A layer has at most four tasks in flight (dW, db, dA and the update of the layer above)
+    ThreadPool MultilayerPerceptron::backpropagationPool(std::max(1u, std::min(4u, std::thread::hardware_concurrency())));
+
     MultilayerPerceptron::MultilayerPerceptron()
-        :costFn(nullptr)
+        :costFn(nullptr), optimizer(new Optimizer::SGD()), schedule(new Schedule::Constant())
     {
         layers = std::vector<Layer>(0);
     };
 
     MultilayerPerceptron::MultilayerPerceptron(CostFn::CostFn* p_costFn)
-        :costFn(p_costFn)
+        :costFn(p_costFn), optimizer(new Optimizer::SGD()), schedule(new Schedule::Constant())
     {
         layers = std::vector<Layer>(0);
     };
@@ -29,6 +182,8 @@ namespace NeuralNetwork
     MultilayerPerceptron::~MultilayerPerceptron()
     {
         delete costFn;
+        delete optimizer;
+        delete schedule;
     }
 
     void MultilayerPerceptron::AddLayer(Layer layer)
@@ -48,6 +203,60 @@ namespace NeuralNetwork
         costFn = p_costFn;
     }
 
+    void MultilayerPerceptron::SetEvaluationOptions(EvaluationOptions options)
+    {
+        evaluationOptions = options;
+    }
+
+    void MultilayerPerceptron::SetOptimizer(Optimizer::Optimizer *p_optimizer)
+    {
+        if (!p_optimizer)
+            throw std::invalid_argument("optimizer is not defined");
+
+        delete optimizer;
+        optimizer = p_optimizer;
+    }
+
+    void MultilayerPerceptron::SetLearningRateSchedule(Schedule::Schedule *p_schedule)
+    {
+        if (!p_schedule)
+            throw std::invalid_argument("learning rate schedule is not defined");
+
+        delete schedule;
+        schedule = p_schedule;
+    }
+
+    void MultilayerPerceptron::SetEarlyStopping(EarlyStoppingOptions options)
+    {
+        if (options.patience <= 0)
+            throw std::invalid_argument("the patience of early stopping must be positive");
+
+        earlyStopping = options;
+    }
+
+    void MultilayerPerceptron::SetMixedPrecision(MixedPrecisionOptions options)
+    {
+        if (!(options.lossScale > 0) || !std::isfinite(options.lossScale))
+            throw std::invalid_argument("loss scale must be positive");
+
+        if (options.dynamicLossScale && options.lossScaleInterval == 0)
+            throw std::invalid_argument("loss scale interval must be positive");
+
+        mixedPrecision = options;
+        lossScale = options.lossScale;
+        stepsSinceOverflow = 0;
+    }
+
+    std::size_t MultilayerPerceptron::layerCount() const
+    {
+        return layers.size();
+    }
+
+    void MultilayerPerceptron::SetSparseBatches(bool sparse)
+    {
+        sparseBatches = sparse;
+    }
+
     void MultilayerPerceptron::LoadDataInstance(Data &input)
     {
         if (layers.size() < 1)
@@ -56,141 +265,595 @@ namespace NeuralNetwork
         if (input.parameterSize != layers[0].neuronCount) 
             throw std::invalid_argument("input dimensions do not match specified dimensions");
 
+        if (input.sparse) {
+            sparseInput = &input.sparseParameters;
+            return;
+        }
+
+        sparseInput = nullptr;
         layers[0].valueMatrix = input.parameters;
     }
 
     void MultilayerPerceptron::RunModel()
     {
-        Math::Matrix output = layers[0].Output();
+        NN_PROFILE_SCOPE("MultilayerPerceptron::RunModel", 0, 0);
+
+        if (sparseInput && layers.size() < 2)
+            throw std::invalid_argument("sparse inputs require a layer after the input layer");
+
+        Math::Matrix output = sparseInput ? layers[1].CalculateValues(*sparseInput) : layers[0].Output();
 
-        for (unsigned int i = 1; i < layers.size(); i++) {
+        for (unsigned int i = sparseInput ? 2 : 1; i < layers.size(); i++) {
             output = layers[i].CalculateValues(output);
         }
     }
 
-    Math::Matrix MultilayerPerceptron::GradientDescent(Data &batch, double learningRate)
+    void MultilayerPerceptron::GradientDescent(Data &batch, double learningRate)
     {
-        Layer &layer = layers.back();
+        NN_PROFILE_SCOPE("MultilayerPerceptron::GradientDescent", 0, 0);
 
-        LoadDataInstance(batch);
-        RunModel();
-        
+        {
+            NN_PROFILE_PHASE("forward");
+            LoadDataInstance(batch);
+            RunModel();
+        }
+
+        NN_PROFILE_PHASE("backward");
         Data transformedBatch = costFn->transformLabels(batch, layers.back());
 
+        // Per layer dZ, dW, db and dA[i-1], each written by exactly one task of the graph
+        std::vector<Math::Matrix> adjustmentMatrices(layers.size(), Math::Matrix(1, 1));
+        std::vector<Math::Matrix> weightDerivatives(layers.size(), Math::Matrix(1, 1));
+        std::vector<Math::Vector> biasDerivatives(layers.size(), Math::Vector(1));
+        std::vector<Math::Matrix> prevValueDerivatives(layers.size(), Math::Matrix(1, 1));
+
+        TaskGraph graph;
+        std::atomic<bool> overflowed(false);
+        std::vector<TaskGraph::TaskId> unscaleTasks;
+
+        // the first layer's weights are updated straight from sparse inputs, and factorized layers form the gradients of their
+        // factors in their updates, neither needing dW[i]
+        auto update = [&](std::size_t i) {
+            NN_PROFILE_PHASE("update");
+            const std::size_t slot = i * Layer::OPTIMIZER_SLOTS;
+
+            if (i == 1 && sparseInput)
+                layers[i].Optimize(*optimizer, slot, adjustmentMatrices[i], *sparseInput, biasDerivatives[i], learningRate);
+            else if (layers[i].rank != 0)
+                layers[i].Optimize(*optimizer, slot, adjustmentMatrices[i], layers[i - 1].Output(), biasDerivatives[i], learningRate);
+            else
+                layers[i].Optimize(*optimizer, slot, weightDerivatives[i], biasDerivatives[i], learningRate);
+        };
+
         // dZ[n]
         // batch count divided here to prevent overflow
-        Math::Matrix adjustmentMatrix = layer.valueMatrix.Apply(layer.activationFn->dx())
-                                            & layer.Output().ApplyForEach(costFn->dx(), transformedBatch.label)
-                                            / double(transformedBatch.dataInstanceCount);
-        
-        // dW[n]
-        Math::Matrix weightDerivatives = adjustmentMatrix * layers[layers.size() - 2].Output().Transpose();
-        
-        // db[n]
-        // vector multiplication sums each row
-        Math::Vector biasDerivatives = adjustmentMatrix * Math::Vector(adjustmentMatrix.cols, 1, true);
-        
-        // dA[n-1]
-        Math::Matrix prevValueDerivatives = layer.weightMatrix.Transpose() * adjustmentMatrix;
+        TaskGraph::TaskId adjustmentTask = graph.AddTask(
+            [&] {
+                Layer &layer = layers.back();
+
+                adjustmentMatrices.back() = layer.valueMatrix.Apply(layer.activationFn->dx())
+                                                & layer.Output().ApplyForEach(costFn->dx(), transformedBatch.label)
+                                                * (lossScale / transformedBatch.dataInstanceCount);
+            }
+        );
+
+        // Once dZ[i] is known, dW[i], db[i] and dA[i-1] are independent of each other, and the update of layer i only has to wait
+        // for dA[i-1] to be done reading its weights, so it overlaps with every task of the layers below. With a scaled loss the
+        // updates wait for the gradients of every layer to be unscaled instead
+        for (std::size_t i = layers.size() - 1; i > 0; i--) {
+            const bool sparseWeights = i == 1 && sparseInput;
+            const bool factorized = layers[i].rank != 0;
+
+            // dW[i]
+            std::vector<TaskGraph::TaskId> updateDependencies;
+
+            if (!sparseWeights && !factorized) {
+                updateDependencies.push_back(graph.AddTask(
+                    [&, i] { weightDerivatives[i] = layers[i].CalculateWeightDerivatives(adjustmentMatrices[i], layers[i - 1].Output()); },
+                    {adjustmentTask}
+                ));
+            }
+
+            // db[i]
+            // vector multiplication sums each row
+            TaskGraph::TaskId biasTask = graph.AddTask(
+                [&, i] { biasDerivatives[i] = adjustmentMatrices[i] * Math::Vector(adjustmentMatrices[i].cols, 1, true); },
+                {adjustmentTask}
+            );
+
+            updateDependencies.push_back(biasTask);
+
+            // the input layer has no parameters, so nothing is propagated to it
+            if (i > 1) {
+                // dA[i-1]
+                TaskGraph::TaskId prevValueTask = graph.AddTask(
+                    [&, i] { prevValueDerivatives[i] = layers[i].CalculateInputDerivatives(adjustmentMatrices[i]); },
+                    {adjustmentTask}
+                );
+
+                updateDependencies.push_back(prevValueTask);
+
+                // dZ[i-1]
+                adjustmentTask = graph.AddTask(
+                    [&, i] {
+                        Layer &prevLayer = layers[i - 1];
+                        adjustmentMatrices[i - 1] = prevLayer.valueMatrix.Apply(prevLayer.activationFn->dx()) & prevValueDerivatives[i];
+                    },
+                    {prevValueTask}
+                );
+            }
+
+            if (lossScale == 1) {
+                graph.AddTask([&, i] { update(i); }, updateDependencies);
+                continue;
+            }
+
+            // gradients of a scaled cost are unscaled before the update
+            unscaleTasks.push_back(graph.AddTask(
+                [&, i, sparseWeights, factorized] {
+                    Math::Matrix &gradients = sparseWeights || factorized ? adjustmentMatrices[i] : weightDerivatives[i];
+
+                    if (!Unscale(gradients, lossScale) | !Unscale(biasDerivatives[i], lossScale))
+                        overflowed = true;
+                },
+                updateDependencies
+            ));
+        }
+
+        // gradients overflowing in any layer skip the whole step, so the layers are never updated from different steps
+        if (!unscaleTasks.empty()) {
+            TaskGraph::TaskId checked = graph.AddTask([] {}, unscaleTasks);
+
+            for (std::size_t i = 1; i < layers.size(); i++) {
+                graph.AddTask(
+                    [&, i] {
+                        if (!overflowed)
+                            update(i);
+                    },
+                    {checked}
+                );
+            }
+        }
 
-        layer.AdjustNeurons(-weightDerivatives, -biasDerivatives, learningRate);
+        graph.Run(backpropagationPool);
+        sparseInput = nullptr;
 
-        return prevValueDerivatives;
+        if (!mixedPrecision.dynamicLossScale)
+            return;
+
+        if (overflowed) {
+            lossScale /= 2;
+            stepsSinceOverflow = 0;
+        }
+        else if (++stepsSinceOverflow >= mixedPrecision.lossScaleInterval) {
+            lossScale *= 2;
+            stepsSinceOverflow = 0;
+        }
     }
+    
+    std::tuple<double, double> MultilayerPerceptron::TestData(DataStream &data)
+    {
+        NN_PROFILE_SCOPE("MultilayerPerceptron::TestData", 0, 0);
 
-    Math::Matrix MultilayerPerceptron::Backpropagate(Math::Matrix &changes, std::size_t layerIndex, double learningRate)
+        if (!costFn)
+            throw std::invalid_argument("cost function is not defined");
+
+        return Evaluator(layers, *costFn).Evaluate(data);
+    }
+
+    void MultilayerPerceptron::Train(std::vector<Data> &trainingSet, std::vector<Data> &testingSet, int epochs, double learningRate, int batchSize, int prefetchCount)
     {
-        Layer &layer = layers[layerIndex];
+        Dataset trainingDataset(trainingSet);
 
-        Math::Matrix adjustmentMatrix = layer.valueMatrix.Apply(layer.activationFn->dx())
-                                            & changes;
+        if (testingSet.size())
+            Train(trainingDataset, Dataset(testingSet), epochs, learningRate, batchSize, prefetchCount);
+        else
+            Train(trainingDataset, epochs, learningRate, batchSize, prefetchCount);
+    }
 
-        Math::Matrix weightDerivatives = adjustmentMatrix * layers[layerIndex - 1].Output().Transpose();
-        Math::Vector biasDerivatives = adjustmentMatrix * Math::Vector(adjustmentMatrix.cols, 1, true);
-        Math::Matrix prevValueDerivatives = layer.weightMatrix.Transpose() * adjustmentMatrix;
-        
-        layer.AdjustNeurons(-weightDerivatives, -biasDerivatives, learningRate);
+    void MultilayerPerceptron::Train(std::vector<Data> &trainingSet, int epochs, double learningRate, int batchSize, int prefetchCount)
+    {
+        Train(Dataset(trainingSet), epochs, learningRate, batchSize, prefetchCount);
+    }
 
-        return prevValueDerivatives;
+    void MultilayerPerceptron::Train(const Dataset &trainingSet, const Dataset &testingSet, int epochs, double learningRate, int batchSize, int prefetchCount)
+    {
+        // shuffles and gathers batches in the background, including while the model is being evaluated
+        BatchLoader loader(trainingSet, batchSize, prefetchCount, true, sparseBatches);
+        DatasetStream trainingStream(trainingSet);
+        DatasetStream testingStream(testingSet);
+
+        RunTraining(loader, trainingStream, &testingStream, epochs, learningRate);
     }
-    
-    std::vector<Data> MultilayerPerceptron::BatchData(std::vector<Data> &data, int batchSize)
+
+    void MultilayerPerceptron::Train(const Dataset &trainingSet, int epochs, double learningRate, int batchSize, int prefetchCount)
+    {
+        BatchLoader loader(trainingSet, batchSize, prefetchCount, true, sparseBatches);
+        DatasetStream trainingStream(trainingSet);
+
+        RunTraining(loader, trainingStream, nullptr, epochs, learningRate);
+    }
+
+    void MultilayerPerceptron::Train(DataStream &trainingSet, DataStream &testingSet, int epochs, double learningRate, int batchSize, int prefetchCount)
+    {
+        std::unique_ptr<DataStream> trainingStream = trainingSet.Reopen();
+        BatchLoader loader(trainingSet, std::max(batchSize, 0), prefetchCount);
+
+        RunTraining(loader, *trainingStream, &testingSet, epochs, learningRate);
+    }
+
+    void MultilayerPerceptron::Train(DataStream &trainingSet, int epochs, double learningRate, int batchSize, int prefetchCount)
+    {
+        std::unique_ptr<DataStream> trainingStream = trainingSet.Reopen();
+        BatchLoader loader(trainingSet, std::max(batchSize, 0), prefetchCount);
+
+        RunTraining(loader, *trainingStream, nullptr, epochs, learningRate);
+    }
+
+    EvaluationResult MultilayerPerceptron::Evaluate(const std::vector<Layer> &snapshot, int epoch, DataStream &trainingSet, DataStream *testingSet)
+    {
+        NN_PROFILE_SCOPE("MultilayerPerceptron::Evaluate", 0, 0);
+        NN_PROFILE_PHASE("evaluation");
+
+        Evaluator evaluator(snapshot, *costFn);
+        EvaluationResult results = {epoch, 0, 0, testingSet != nullptr, 0, 0};
+
+        std::tie(results.accuracy, results.cost) = evaluator.Evaluate(trainingSet);
+
+        if (testingSet)
+            std::tie(results.validationAccuracy, results.validationCost) = evaluator.Evaluate(*testingSet);
+
+        if (evaluationOptions.callback)
+            evaluationOptions.callback(results);
+        else {
+            if (evaluationOptions.asynchronous)
+                std::cout << "Epoch " << epoch << " evaluation" << std::endl;
+
+            PrintResults(results);
+        }
+
+        return results;
+    }
+
+    void MultilayerPerceptron::RunTraining(BatchLoader &loader, DataStream &trainingSet, DataStream *testingSet, int epochs, double learningRate)
     {
-        std::default_random_engine rng(std::chrono::system_clock::now().time_since_epoch().count());
-        std::shuffle(std::begin(data), std::end(data), rng);
+        if (!costFn)
+            throw std::invalid_argument("cost function is not defined");
+
+        if (earlyStopping.enabled && IsValidationMetric(earlyStopping.metric) && !testingSet)
+            throw std::invalid_argument("early stopping on a validation metric needs a testing set");
+
+        if (schedule->needsTestingSet() && !testingSet)
+            throw std::invalid_argument("a learning rate schedule on a validation metric needs a testing set");
 
-        if (batchSize == 0)
-            batchSize = data.size();
-            
-        unsigned int batches = ceil(data.size() / (double) batchSize);
-            
-        std::vector<std::vector<Data>> trainingSets = std::vector<std::vector<Data>>(batches, std::vector<Data>());
+        // the sample is drawn once, so results of different epochs stay comparable
+        std::unique_ptr<DatasetStream> trainingSample;
 
-        for (unsigned int i = 0; i < data.size(); i++) {
-            trainingSets[i / batchSize].push_back(data[i]);
+        if (evaluationOptions.trainingSampleSize)
+            trainingSample.reset(new DatasetStream(SampleStream(trainingSet, evaluationOptions.trainingSampleSize)));
+
+        DataStream &trainingEvaluationSet = trainingSample ? *trainingSample : trainingSet;
+
+        for (std::size_t i = 1; i < layers.size(); i++) {
+            layers[i].SetPrecision(mixedPrecision.precision);
         }
 
-        std::vector<Data> trainingBatches = {};
+        schedule->Reset();
+        MetricMonitor monitor(earlyStopping.metric, earlyStopping.minDelta);
+        std::vector<Layer> bestLayers;
+
+        // Passes the results of an epoch to the schedule and early stopping, keeping the weights they were evaluated on when they are the best so far
+        // @returns whether training should stop
+        auto observe = [&](const EvaluationResult &results, const std::vector<Layer> &evaluated) {
+            schedule->Observe(results);
+
+            if (!earlyStopping.enabled)
+                return false;
+
+            if (monitor.Observe(results)) {
+                if (earlyStopping.restoreBestWeights)
+                    bestLayers = evaluated;
+
+                return false;
+            }
+
+            return monitor.epochsSinceBest() >= earlyStopping.patience;
+        };
+
+        // evaluation streams are only read by the worker while it runs, the loader reads from its own stream.
+        // the snapshot is declared first, so the worker finishes with it before it is destroyed
+        std::vector<Layer> snapshot;
+        EvaluationResult snapshotResults;
+        std::unique_ptr<BackgroundWorker> evaluationWorker;
+
+        if (evaluationOptions.asynchronous)
+            evaluationWorker.reset(new BackgroundWorker());
+
+        bool stopped = false;
+        double previousRate = learningRate;
+
+        for (int epoch = 0; epoch < epochs && !stopped; epoch++) {
+            NN_PROFILE_EPOCH(epoch);
+            const double rate = schedule->Rate(epoch, learningRate);
+            std::cout << "Epoch " << epoch << std::endl;
+
+            if (rate != previousRate)
+                std::cout << "Learning Rate: " << rate << std::endl;
+
+            previousRate = rate;
+
+            do {
+                GradientDescent(loader.Next(), rate);
+            } while (!loader.EndOfEpoch());
 
-        for (auto batch : trainingSets) {
-            trainingBatches.push_back(Data(batch));
+            if (!evaluationWorker) {
+                stopped = observe(Evaluate(layers, epoch, trainingEvaluationSet, testingSet), layers);
+                continue;
+            }
+
+            // the weights are updated in place by every batch, so the snapshot is a copy taken once the previous evaluation is done with it
+            evaluationWorker->Wait();
+
+            if (epoch > 0 && observe(snapshotResults, snapshot)) {
+                stopped = true;
+                break;
+            }
+
+            snapshot = layers;
+
+            evaluationWorker->Submit([this, &snapshot, &snapshotResults, epoch, &trainingEvaluationSet, testingSet] {
+                snapshotResults = Evaluate(snapshot, epoch, trainingEvaluationSet, testingSet);
+            });
         }
 
-        return trainingBatches;
+        if (evaluationWorker) {
+            evaluationWorker->Wait();
+
+            if (!stopped && !snapshot.empty())
+                stopped = observe(snapshotResults, snapshot);
+        }
+
+        if (stopped)
+            std::cout << "Stopping early, no improvement since epoch " << monitor.bestEpoch() << std::endl;
+
+        // the model ends on the best weights seen, even when the last epoch is worse without having run out of patience
+        if (!bestLayers.empty() && monitor.epochsSinceBest() > 0) {
+            std::cout << "Restoring weights of epoch " << monitor.bestEpoch() << std::endl;
+            layers = std::move(bestLayers);
+        }
     }
-    
-    std::tuple<double, double> MultilayerPerceptron::TestData(Data &data)
+
+    void MultilayerPerceptron::Prune(const PruningOptions &options)
     {
-        LoadDataInstance(data);
-        RunModel();
+        // the input layer has no weights
+        for (std::size_t i = 1; i < layers.size(); i++) {
+            layers[i].Prune(options);
+        }
+    }
 
-        Data transformedData = costFn->transformLabels(data, layers.back());
+    LowRankFactors MultilayerPerceptron::Factorize(std::size_t layer, std::size_t rank)
+    {
+        if (layer == 0 || layer >= layers.size())
+            throw std::invalid_argument("only layers after the input layer have weights");
 
-        double accuracy = costFn->evaluate(layers.back().Output(), data.label);
-        double cost = (double) (Math::Vector(layers.back().neuronCount, 1, false) * layers.back().Output().ApplyForEach(costFn->fn(), transformedData.label) * Math::Vector(transformedData.dataInstanceCount, 1, true)) / transformedData.dataInstanceCount;
+        return layers[layer].Factorize(rank);
+    }
 
-        return std::tuple<double, double>(accuracy, cost);
+    InferenceModel MultilayerPerceptron::Compile(std::size_t maxBatchSize, double maxSparseDensity) const
+    {
+        return InferenceModel(layers, maxBatchSize, maxSparseDensity);
     }
 
-    void MultilayerPerceptron::Train(std::vector<Data> &trainingSet, std::vector<Data> &testingSet, int epochs, double learningRate, int batchSize)
+    QuantizedModel MultilayerPerceptron::Quantize(DataStream &calibrationSet, std::size_t calibrationSize, std::size_t maxBatchSize) const
     {
-        Data trainingSetCache = Data(trainingSet);
-        Data testingSetCache = Data(testingSet);
+        if (layers.size() < 1)
+            throw std::invalid_argument("neural network layers are not defined");
 
-        for (int epoch = 0; epoch < epochs; epoch++) {
-            std::cout << "Epoch " << epoch << std::endl;
+        // the quantized model reads as many values per instance as the input layer has neurons
+        if (calibrationSet.parameterSize() != layers[0].neuronCount)
+            throw std::invalid_argument("input dimensions do not match specified dimensions");
 
-            std::vector<Data> batches = BatchData(trainingSet, batchSize);
+        Dataset sample = SampleStream(calibrationSet, calibrationSize);
+        std::vector<float> calibration(sample.size() * sample.parameterSize());
 
-            for (auto batch : batches) {
-                Math::Matrix changes = GradientDescent(batch, learningRate);
+        for (std::size_t i = 0; i < sample.size(); i++) {
+            std::copy(sample.Parameters(i), sample.Parameters(i) + sample.parameterSize(), &calibration[i * sample.parameterSize()]);
+        }
 
-                for (unsigned int i = layers.size() - 2; i > 0; i--) {
-                    changes = Backpropagate(changes, i, learningRate);
-                }
+        return QuantizedModel(layers, calibration.data(), sample.size(), maxBatchSize);
+    }
+
+    void MultilayerPerceptron::Save(const std::string &pathname) const
+    {
+        if (!MappedFile::IsLittleEndian())
+            throw std::runtime_error("checkpoints can only be written on little endian machines");
+
+        if (layers.size() < 1)
+            throw std::invalid_argument("neural network layers are not defined");
+
+        if (!costFn)
+            throw std::invalid_argument("cost function is not defined");
+
+        std::ofstream file(pathname, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open())
+            throw std::runtime_error("error opening checkpoint file at \"" + pathname + "\"");
+
+        // Offsets are laid out before anything is written, as the tables at the front point at the parameters behind them
+        std::vector<CheckpointSectionEntry> sections(3, CheckpointSectionEntry());
+        const std::size_t sectionTableOffset = sizeof(CheckpointHeader);
+        const std::size_t layerTableOffset = AlignedBuffer::AlignUp(sectionTableOffset + sections.size() * sizeof(CheckpointSectionEntry), CHECKPOINT_ALIGNMENT);
+        const std::size_t parameterOffset = AlignedBuffer::AlignUp(layerTableOffset + layers.size() * sizeof(CheckpointLayer), CHECKPOINT_PAGE_ALIGNMENT);
+
+        std::vector<CheckpointLayer> layerTable(layers.size(), CheckpointLayer());
+        std::size_t offset = parameterOffset;
+
+        for (std::size_t i = 0; i < layers.size(); i++) {
+            const Layer &layer = layers[i];
+            CheckpointLayer &entry = layerTable[i];
+
+            entry.neuronCount = layer.neuronCount;
+            entry.activationFn = static_cast<std::uint8_t>(layer.activationFn ? layer.activationFn->id() : ActivationFn::Id::None);
+
+            if (i == 0)
+                continue;
+
+            entry.connectionCount = layer.connectionCount;
+            entry.rank = layer.rank;
+            entry.weightOffset = offset;
+
+            if (layer.rank) {
+                offset = AlignedBuffer::AlignUp(offset + layer.neuronCount * layer.rank * sizeof(double), CHECKPOINT_ALIGNMENT);
+                offset = AlignedBuffer::AlignUp(offset + layer.rank * layer.connectionCount * sizeof(double), CHECKPOINT_ALIGNMENT);
+            }
+            else {
+                offset = AlignedBuffer::AlignUp(offset + layer.neuronCount * layer.connectionCount * sizeof(double), CHECKPOINT_ALIGNMENT);
             }
 
-            std::tuple<double, double> results = TestData(trainingSetCache);
-            double accuracy = std::get<0>(results);
-            double cost = std::get<1>(results);
-            std::cout << "Accuracy: " << accuracy << "\t\t";
-            std::cout << "Cost: " << cost << std::endl;
+            entry.biasOffset = offset;
+            offset = AlignedBuffer::AlignUp(offset + layer.neuronCount * sizeof(double), CHECKPOINT_ALIGNMENT);
+        }
 
-            if (testingSet.size()) {
-                std::tuple<double, double> valResults = TestData(testingSetCache);
-                double valAccuracy = std::get<0>(valResults);
-                double valCost = std::get<1>(valResults);
-                std::cout << "Validation Accuracy: " << valAccuracy << "\t";
-                std::cout << "Validation Cost: " << valCost << std::endl;
+        sections[0] = {static_cast<std::uint32_t>(CheckpointSection::Layers), 0, layerTableOffset, layerTable.size() * sizeof(CheckpointLayer)};
+        sections[1] = {static_cast<std::uint32_t>(CheckpointSection::Parameters), 0, parameterOffset, offset - parameterOffset};
+
+        // The optimizer state follows the parameters, aligned so its moments can be copied straight from the mapping
+        std::vector<char> optimizerState = optimizer->SaveState();
+        sections[2] = {static_cast<std::uint32_t>(CheckpointSection::OptimizerState), 0, offset, optimizerState.size()};
+
+        CheckpointHeader header = {};
+        std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+        header.version = CHECKPOINT_VERSION;
+        header.headerSize = sizeof(CheckpointHeader);
+        header.sectionCount = sections.size();
+        header.costFn = static_cast<std::uint8_t>(costFn->id());
+        header.sectionTableOffset = sectionTableOffset;
+
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(sections.data()), sections.size() * sizeof(CheckpointSectionEntry));
+        MappedFile::WritePadding(file, CHECKPOINT_ALIGNMENT);
+        file.write(reinterpret_cast<const char *>(layerTable.data()), layerTable.size() * sizeof(CheckpointLayer));
+        MappedFile::WritePadding(file, CHECKPOINT_PAGE_ALIGNMENT);
+
+        for (std::size_t i = 1; i < layers.size(); i++) {
+            if (layers[i].rank) {
+                file.write(reinterpret_cast<const char *>(layers[i].factorU.data()), layers[i].neuronCount * layers[i].rank * sizeof(double));
+                MappedFile::WritePadding(file, CHECKPOINT_ALIGNMENT);
+                file.write(reinterpret_cast<const char *>(layers[i].factorV.data()), layers[i].rank * layers[i].connectionCount * sizeof(double));
+                MappedFile::WritePadding(file, CHECKPOINT_ALIGNMENT);
+            }
+            else {
+                file.write(reinterpret_cast<const char *>(layers[i].weightMatrix.data()), layers[i].neuronCount * layers[i].connectionCount * sizeof(double));
+                MappedFile::WritePadding(file, CHECKPOINT_ALIGNMENT);
             }
 
-            std::cout << std::endl;
+            file.write(reinterpret_cast<const char *>(layers[i].biasVector.data()), layers[i].neuronCount * sizeof(double));
+            MappedFile::WritePadding(file, CHECKPOINT_ALIGNMENT);
         }
+
+        file.write(optimizerState.data(), optimizerState.size());
+
+        if (!file)
+            throw std::runtime_error("error writing checkpoint file at \"" + pathname + "\"");
     }
 
-    void MultilayerPerceptron::Train(std::vector<Data> &trainingSet, int epochs, double learningRate, int batchSize)
+    void MultilayerPerceptron::Load(const std::string &pathname)
     {
-        std::vector<Data> testingSet = {};
-        Train(trainingSet, testingSet, epochs, learningRate, batchSize);
+        if (!MappedFile::IsLittleEndian())
+            throw std::runtime_error("checkpoints can only be read on little endian machines");
+
+        MappedFile file(pathname);
+        const std::string error = "checkpoint file at \"" + pathname + "\"";
+
+        if (file.size() < sizeof(CheckpointHeader) || std::memcmp(file.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0)
+            throw std::runtime_error("\"" + pathname + "\" is not a checkpoint file");
+
+        CheckpointHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        if (header.version != CHECKPOINT_VERSION || header.headerSize != sizeof(CheckpointHeader))
+            throw std::runtime_error(error + " has unsupported version " + std::to_string(header.version));
+
+        if (header.sectionTableOffset + header.sectionCount * sizeof(CheckpointSectionEntry) > file.size())
+            throw std::runtime_error(error + " is truncated");
+
+        // Sections this version does not know about are skipped
+        const CheckpointSectionEntry *layerSection = nullptr;
+        const CheckpointSectionEntry *optimizerSection = nullptr;
+        const CheckpointSectionEntry *sectionTable = reinterpret_cast<const CheckpointSectionEntry *>(file.data() + header.sectionTableOffset);
+
+        for (std::size_t i = 0; i < header.sectionCount; i++) {
+            if (sectionTable[i].offset + sectionTable[i].size > file.size())
+                throw std::runtime_error(error + " is truncated");
+
+            if (sectionTable[i].type == static_cast<std::uint32_t>(CheckpointSection::Layers))
+                layerSection = &sectionTable[i];
+
+            if (sectionTable[i].type == static_cast<std::uint32_t>(CheckpointSection::OptimizerState))
+                optimizerSection = &sectionTable[i];
+        }
+
+        if (!layerSection || layerSection->size < sizeof(CheckpointLayer) || layerSection->size % sizeof(CheckpointLayer) != 0)
+            throw std::runtime_error(error + " has no layers");
+
+        const std::size_t layerCount = layerSection->size / sizeof(CheckpointLayer);
+        std::vector<CheckpointLayer> layerTable(layerCount);
+        std::memcpy(layerTable.data(), file.data() + layerSection->offset, layerSection->size);
+
+        std::vector<Layer> loadedLayers;
+        loadedLayers.reserve(layerCount);
+
+        for (std::size_t i = 0; i < layerCount; i++) {
+            const CheckpointLayer &entry = layerTable[i];
+            const std::size_t factorUBytes = entry.neuronCount * entry.rank * sizeof(double);
+            const std::size_t factorVOffset = AlignedBuffer::AlignUp(entry.weightOffset + factorUBytes, CHECKPOINT_ALIGNMENT);
+            const std::size_t weightBytes = entry.rank ? factorVOffset - entry.weightOffset + entry.rank * entry.connectionCount * sizeof(double) : entry.neuronCount * entry.connectionCount * sizeof(double);
+            const std::size_t biasBytes = entry.neuronCount * sizeof(double);
+
+            if (entry.neuronCount == 0 || (i > 0 && entry.connectionCount != layerTable[i - 1].neuronCount))
+                throw std::runtime_error(error + " has inconsistent layer sizes");
+
+            if (entry.rank > std::min(entry.neuronCount, entry.connectionCount))
+                throw std::runtime_error(error + " has a rank larger than its layer");
+
+            Layer layer(entry.neuronCount, i > 0 ? ActivationFn::Create(static_cast<ActivationFn::Id>(entry.activationFn)) : nullptr);
+
+            if (i == 0) {
+                layer.connectionCount = 0;
+                loadedLayers.push_back(layer);
+                continue;
+            }
+
+            if (entry.weightOffset + weightBytes > file.size() || entry.biasOffset + biasBytes > file.size())
+                throw std::runtime_error(error + " is truncated");
+
+            layer.connectionCount = entry.connectionCount;
+            layer.biasVector = Math::Vector(entry.neuronCount);
+            std::memcpy(layer.biasVector.data(), file.data() + entry.biasOffset, biasBytes);
+
+            if (entry.rank) {
+                layer.rank = entry.rank;
+                layer.factorU = Math::Matrix(entry.neuronCount, entry.rank);
+                layer.factorV = Math::Matrix(entry.rank, entry.connectionCount);
+                std::memcpy(layer.factorU.data(), file.data() + entry.weightOffset, factorUBytes);
+                std::memcpy(layer.factorV.data(), file.data() + factorVOffset, entry.rank * entry.connectionCount * sizeof(double));
+            }
+            else {
+                layer.weightMatrix = Math::Matrix(entry.neuronCount, entry.connectionCount);
+                std::memcpy(layer.weightMatrix.data(), file.data() + entry.weightOffset, weightBytes);
+            }
+
+            loadedLayers.push_back(layer);
+        }
+
+        // State of a different optimizer, or of none, starts the model's optimizer over
+        if (!optimizerSection || !optimizer->LoadState(file.data() + optimizerSection->offset, optimizerSection->size))
+            optimizer->Reset();
+
+        CostFn::CostFn *loadedCostFn = CostFn::Create(static_cast<CostFn::Id>(header.costFn));
+
+        layers = loadedLayers;
+        delete costFn;
+        costFn = loadedCostFn;
     }
 }
\ No newline at end of file
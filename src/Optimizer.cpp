@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "AlignedBuffer.hpp"
+#include "Matrix.hpp"
+#include "Optimizer.hpp"
+#include "Profiler.hpp"
+
+namespace Optimizer
+{
+    namespace
+    {
+        // Blocks smaller than this are updated on the calling thread, as waking the threadpool would cost more than the update
+        const std::size_t PARALLEL_THRESHOLD = 1 << 15;
+
+        // Chunks of a split update start on a cache line, so no two threads write the same line
+        const std::size_t CHUNK_ALIGNMENT = 64 / sizeof(double);
+
+        const std::size_t STATE_ALIGNMENT = 64;
+
+        /**
+         * Layout of saved state, followed by a `SavedSlot` per slot with state, and the moments of every slot
+         */
+        struct SavedHeader
+        {
+            std::uint8_t id;
+            std::uint8_t momentCount;
+            std::uint8_t reserved[6];
+            std::uint64_t slotCount;
+        };
+
+        struct SavedSlot
+        {
+            std::uint64_t slot;
+            std::uint64_t count;
+            std::uint64_t steps;
+            std::uint64_t offset;       // Of the first moment in bytes from the start of the state, later moments each starting on the next aligned offset
+        };
+
+        // The kernels are written once over a generic lane type, a SIMD register of doubles for the body of a range and a double for its tail
+#if defined(__AVX__)
+        using Pack = __m256d;
+        const std::size_t PACK_SIZE = 4;
+
+        inline Pack Add(Pack a, Pack b) { return _mm256_add_pd(a, b); }
+        inline Pack Sub(Pack a, Pack b) { return _mm256_sub_pd(a, b); }
+        inline Pack Mul(Pack a, Pack b) { return _mm256_mul_pd(a, b); }
+        inline Pack Div(Pack a, Pack b) { return _mm256_div_pd(a, b); }
+        inline Pack Sqrt(Pack a) { return _mm256_sqrt_pd(a); }
+        inline void Store(double *destination, Pack value) { _mm256_storeu_pd(destination, value); }
+#elif defined(__SSE2__)
+        using Pack = __m128d;
+        const std::size_t PACK_SIZE = 2;
+
+        inline Pack Add(Pack a, Pack b) { return _mm_add_pd(a, b); }
+        inline Pack Sub(Pack a, Pack b) { return _mm_sub_pd(a, b); }
+        inline Pack Mul(Pack a, Pack b) { return _mm_mul_pd(a, b); }
+        inline Pack Div(Pack a, Pack b) { return _mm_div_pd(a, b); }
+        inline Pack Sqrt(Pack a) { return _mm_sqrt_pd(a); }
+        inline void Store(double *destination, Pack value) { _mm_storeu_pd(destination, value); }
+#endif
+
+        inline double Add(double a, double b) { return a + b; }
+        inline double Sub(double a, double b) { return a - b; }
+        inline double Mul(double a, double b) { return a * b; }
+        inline double Div(double a, double b) { return a / b; }
+        inline double Sqrt(double a) { return std::sqrt(a); }
+        inline void Store(double *destination, double value) { *destination = value; }
+
+        template <typename Lane>
+        Lane Load(const double *source);
+
+        template <typename Lane>
+        Lane Broadcast(double value);
+
+        template <>
+        inline double Load<double>(const double *source) { return *source; }
+
+        template <>
+        inline double Broadcast<double>(double value) { return value; }
+
+#if defined(__AVX__)
+        template <>
+        inline Pack Load<Pack>(const double *source) { return _mm256_loadu_pd(source); }
+
+        template <>
+        inline Pack Broadcast<Pack>(double value) { return _mm256_set1_pd(value); }
+#elif defined(__SSE2__)
+        template <>
+        inline Pack Load<Pack>(const double *source) { return _mm_loadu_pd(source); }
+
+        template <>
+        inline Pack Broadcast<Pack>(double value) { return _mm_set1_pd(value); }
+#endif
+
+        /**
+         * Calls `fn(i, lane)` over a range, a whole SIMD register at a time and then one value at a time
+         */
+        template <typename Fn>
+        void ForEachLane(std::size_t start, std::size_t end, Fn fn)
+        {
+            std::size_t i = start;
+
+#if defined(__AVX__) || defined(__SSE2__)
+            for (; i + PACK_SIZE <= end; i += PACK_SIZE) {
+                fn(i, Pack());
+            }
+#endif
+
+            for (; i < end; i++) {
+                fn(i, 0.0);
+            }
+        }
+
+        /**
+         * Gradient of a lane, zeroed where masked
+         */
+        template <typename Lane>
+        Lane Gradient(const double *gradients, const double *mask, std::size_t i)
+        {
+            Lane gradient = Load<Lane>(gradients + i);
+            return mask ? Mul(gradient, Load<Lane>(mask + i)) : gradient;
+        }
+    }
+
+    Optimizer::~Optimizer() {}
+
+    Optimizer::State &Optimizer::Slot(std::size_t slot, std::size_t count)
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+
+        if (slot >= states.size())
+            states.resize(slot + 1);
+
+        std::unique_ptr<State> &state = states[slot];
+
+        if (!state || state->count != count) {
+            state.reset(new State());
+            state->count = count;
+
+            for (std::size_t k = 0; k < momentCount(); k++) {
+                state->moments[k].reset(new AlignedBuffer(count * sizeof(double), STATE_ALIGNMENT));
+            }
+        }
+
+        return *state;
+    }
+
+    void Optimizer::Update(std::size_t slot, double *parameters, const double *gradients, std::size_t count, double learningRate, const double *mask, bool decay)
+    {
+        NN_PROFILE_SCOPE("Optimizer::Update", count * (3 + 2 * momentCount()) * sizeof(double), 0);
+
+        if (count == 0)
+            return;
+
+        State &state = Slot(slot, count);
+        state.steps++;
+
+        UpdateArgs args = {parameters, gradients, mask, {nullptr, nullptr}, learningRate, state.steps, decay};
+
+        for (std::size_t k = 0; k < momentCount(); k++) {
+            args.moments[k] = static_cast<double *>(state.moments[k]->data());
+        }
+
+        if (count < PARALLEL_THRESHOLD) {
+            Run(args, 0, count);
+            return;
+        }
+
+        // chunks are split through the matrix threadpool, whose tasks never wait, so updates queued from backward pass tasks cannot deadlock
+        Math::Matrix::UseThreadPool(
+            [this, &args](unsigned int start, unsigned int end) { Run(args, start, end); },
+            count, (3 + 2 * momentCount()) * sizeof(double), 0, CHUNK_ALIGNMENT
+        );
+    }
+
+    void Optimizer::Reset()
+    {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        states.clear();
+    }
+
+    std::vector<char> Optimizer::SaveState() const
+    {
+        std::vector<SavedSlot> slots;
+        std::size_t offset = 0;
+
+        for (std::size_t i = 0; i < states.size(); i++) {
+            if (states[i])
+                slots.push_back({i, states[i]->count, states[i]->steps, 0});
+        }
+
+        offset = AlignedBuffer::AlignUp(sizeof(SavedHeader) + slots.size() * sizeof(SavedSlot), STATE_ALIGNMENT);
+
+        for (SavedSlot &slot : slots) {
+            slot.offset = offset;
+            offset += momentCount() * AlignedBuffer::AlignUp(slot.count * sizeof(double), STATE_ALIGNMENT);
+        }
+
+        std::vector<char> data(offset, 0);
+        SavedHeader header = {};
+        header.id = static_cast<std::uint8_t>(id());
+        header.momentCount = momentCount();
+        header.slotCount = slots.size();
+
+        std::memcpy(data.data(), &header, sizeof(header));
+
+        if (!slots.empty())
+            std::memcpy(data.data() + sizeof(header), slots.data(), slots.size() * sizeof(SavedSlot));
+
+        for (const SavedSlot &slot : slots) {
+            std::size_t momentOffset = slot.offset;
+
+            for (std::size_t k = 0; k < momentCount(); k++) {
+                std::memcpy(data.data() + momentOffset, states[slot.slot]->moments[k]->data(), slot.count * sizeof(double));
+                momentOffset += AlignedBuffer::AlignUp(slot.count * sizeof(double), STATE_ALIGNMENT);
+            }
+        }
+
+        return data;
+    }
+
+    bool Optimizer::LoadState(const void *data, std::size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        SavedHeader header;
+
+        if (size < sizeof(header))
+            throw std::runtime_error("optimizer state is truncated");
+
+        std::memcpy(&header, bytes, sizeof(header));
+
+        if (header.id != static_cast<std::uint8_t>(id()) || header.momentCount != momentCount())
+            return false;
+
+        if (sizeof(header) + header.slotCount * sizeof(SavedSlot) > size)
+            throw std::runtime_error("optimizer state is truncated");
+
+        std::vector<SavedSlot> slots(header.slotCount);
+
+        if (!slots.empty())
+            std::memcpy(slots.data(), bytes + sizeof(header), slots.size() * sizeof(SavedSlot));
+
+        std::vector<std::unique_ptr<State>> loaded;
+
+        for (const SavedSlot &slot : slots) {
+            const std::size_t momentSize = AlignedBuffer::AlignUp(slot.count * sizeof(double), STATE_ALIGNMENT);
+
+            if (slot.offset + momentCount() * momentSize > size)
+                throw std::runtime_error("optimizer state is truncated");
+
+            if (slot.slot >= loaded.size())
+                loaded.resize(slot.slot + 1);
+
+            loaded[slot.slot].reset(new State());
+            State &state = *loaded[slot.slot];
+            state.count = slot.count;
+            state.steps = slot.steps;
+
+            for (std::size_t k = 0; k < momentCount(); k++) {
+                state.moments[k].reset(new AlignedBuffer(slot.count * sizeof(double), STATE_ALIGNMENT));
+                std::memcpy(state.moments[k]->data(), bytes + slot.offset + k * momentSize, slot.count * sizeof(double));
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        states.swap(loaded);
+
+        return true;
+    }
+
+    Id SGD::id() const
+    {
+        return Id::SGD;
+    }
+
+    std::size_t SGD::momentCount() const
+    {
+        return 0;
+    }
+
+    void SGD::Run(const UpdateArgs &args, std::size_t start, std::size_t end) const
+    {
+        ForEachLane(start, end, [&args](std::size_t i, auto lane) {
+            using Lane = decltype(lane);
+
+            Lane gradient = Gradient<Lane>(args.gradients, args.mask, i);
+            Store(args.parameters + i, Sub(Load<Lane>(args.parameters + i), Mul(Broadcast<Lane>(args.learningRate), gradient)));
+        });
+    }
+
+    Momentum::Momentum(double p_momentum)
+        : momentum(p_momentum) {}
+
+    Id Momentum::id() const
+    {
+        return Id::Momentum;
+    }
+
+    std::size_t Momentum::momentCount() const
+    {
+        return 1;
+    }
+
+    void Momentum::Run(const UpdateArgs &args, std::size_t start, std::size_t end) const
+    {
+        const double mu = momentum;
+
+        ForEachLane(start, end, [&args, mu](std::size_t i, auto lane) {
+            using Lane = decltype(lane);
+
+            Lane velocity = Add(Mul(Broadcast<Lane>(mu), Load<Lane>(args.moments[0] + i)), Gradient<Lane>(args.gradients, args.mask, i));
+
+            // Masked parameters also drop the velocity they had before being masked
+            if (args.mask)
+                velocity = Mul(velocity, Load<Lane>(args.mask + i));
+
+            Store(args.moments[0] + i, velocity);
+            Store(args.parameters + i, Sub(Load<Lane>(args.parameters + i), Mul(Broadcast<Lane>(args.learningRate), velocity)));
+        });
+    }
+
+    Nesterov::Nesterov(double p_momentum)
+        : Momentum(p_momentum) {}
+
+    Id Nesterov::id() const
+    {
+        return Id::Nesterov;
+    }
+
+    void Nesterov::Run(const UpdateArgs &args, std::size_t start, std::size_t end) const
+    {
+        const double mu = momentum;
+
+        ForEachLane(start, end, [&args, mu](std::size_t i, auto lane) {
+            using Lane = decltype(lane);
+
+            const Lane gradient = Gradient<Lane>(args.gradients, args.mask, i);
+            Lane velocity = Add(Mul(Broadcast<Lane>(mu), Load<Lane>(args.moments[0] + i)), gradient);
+
+            if (args.mask)
+                velocity = Mul(velocity, Load<Lane>(args.mask + i));
+
+            // Steps from where the velocity is about to carry the parameters
+            const Lane step = Add(gradient, Mul(Broadcast<Lane>(mu), velocity));
+
+            Store(args.moments[0] + i, velocity);
+            Store(args.parameters + i, Sub(Load<Lane>(args.parameters + i), Mul(Broadcast<Lane>(args.learningRate), step)));
+        });
+    }
+
+    Adam::Adam(double p_beta1, double p_beta2, double p_epsilon)
+        : beta1(p_beta1), beta2(p_beta2), epsilon(p_epsilon), weightDecay(0) {}
+
+    Id Adam::id() const
+    {
+        return Id::Adam;
+    }
+
+    std::size_t Adam::momentCount() const
+    {
+        return 2;
+    }
+
+    void Adam::Run(const UpdateArgs &args, std::size_t start, std::size_t end) const
+    {
+        // Bias corrections are folded into the learning rate and the root of the squared average, `step = lr * c1 * m / (sqrt(v) * c2 + eps)`
+        const double rate = args.learningRate / (1 - std::pow(beta1, (double) args.steps));
+        const double rootCorrection = 1 / std::sqrt(1 - std::pow(beta2, (double) args.steps));
+        const double decay = args.decay ? 1 - args.learningRate * weightDecay : 1;
+        const double b1 = beta1;
+        const double b2 = beta2;
+        const double eps = epsilon;
+
+        ForEachLane(start, end, [&args, rate, rootCorrection, decay, b1, b2, eps](std::size_t i, auto lane) {
+            using Lane = decltype(lane);
+
+            const Lane gradient = Gradient<Lane>(args.gradients, args.mask, i);
+            Lane mean = Add(Mul(Broadcast<Lane>(b1), Load<Lane>(args.moments[0] + i)), Mul(Broadcast<Lane>(1 - b1), gradient));
+            Lane square = Add(Mul(Broadcast<Lane>(b2), Load<Lane>(args.moments[1] + i)), Mul(Broadcast<Lane>(1 - b2), Mul(gradient, gradient)));
+
+            if (args.mask) {
+                const Lane mask = Load<Lane>(args.mask + i);
+                mean = Mul(mean, mask);
+                square = Mul(square, mask);
+            }
+
+            const Lane step = Div(Mul(Broadcast<Lane>(rate), mean), Add(Mul(Sqrt(square), Broadcast<Lane>(rootCorrection)), Broadcast<Lane>(eps)));
+
+            Store(args.moments[0] + i, mean);
+            Store(args.moments[1] + i, square);
+            Store(args.parameters + i, Sub(Mul(Load<Lane>(args.parameters + i), Broadcast<Lane>(decay)), step));
+        });
+    }
+
+    AdamW::AdamW(double p_beta1, double p_beta2, double p_epsilon, double p_weightDecay)
+        : Adam(p_beta1, p_beta2, p_epsilon)
+    {
+        weightDecay = p_weightDecay;
+    }
+
+    Id AdamW::id() const
+    {
+        return Id::AdamW;
+    }
+}
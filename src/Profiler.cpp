@@ -0,0 +1,805 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "Profiler.hpp"
+
+namespace Profiler
+{
+    namespace
+    {
+        struct Totals
+        {
+            std::uint64_t calls = 0;
+            std::int64_t nanoseconds = 0;
+            std::int64_t selfNanoseconds = 0;
+            std::uint64_t bytes = 0;
+            std::uint64_t flops = 0;
+            std::uint64_t counters[COUNTER_COUNT] = {};
+            std::uint64_t countedCalls = 0;
+            std::uint64_t queuedTasks = 0;
+        };
+
+        struct AllocationTotals
+        {
+            std::uint64_t allocations = 0;
+            std::uint64_t bytes = 0;
+            std::uint64_t peakLiveBytes = 0;
+        };
+
+        // Site of allocations made outside every region
+        const std::size_t NO_REGION = (std::size_t) -1;
+
+        struct Event
+        {
+            std::size_t region;
+            std::int64_t start;
+            std::int64_t duration;
+            std::uint64_t bytes;
+            std::uint64_t flops;
+        };
+
+        /**
+         * Calls recorded by a single thread, only written by that thread
+         */
+        struct ThreadLog
+        {
+            std::size_t thread;
+            std::vector<Totals> totals;             // Indexed by region
+            std::vector<Event> events;
+            std::vector<std::int64_t> nestedTime;   // Time spent in the regions nested in each open scope, innermost last
+            std::vector<std::size_t> openRegions;   // Region of each open scope, innermost last
+            std::map<std::pair<const char *, std::size_t>, AllocationTotals> allocations;   // Indexed by phase and site
+        };
+
+        /**
+         * Names of the regions and logs of every thread that recorded a call, logs outliving their threads so their calls are still exported
+         */
+        struct Registry
+        {
+            std::mutex mutex;
+            std::vector<std::string> names;
+            std::vector<std::unique_ptr<ThreadLog>> logs;
+            std::vector<EpochAllocations> epochs;
+        };
+
+        Registry &GetRegistry()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        thread_local ThreadLog *threadLog = nullptr;
+
+        ThreadLog &Log()
+        {
+            if (threadLog)
+                return *threadLog;
+
+            Registry &registry = GetRegistry();
+            std::unique_lock<std::mutex> lock(registry.mutex);
+
+            registry.logs.emplace_back(new ThreadLog());
+            threadLog = registry.logs.back().get();
+            threadLog->thread = registry.logs.size();
+
+            return *threadLog;
+        }
+
+        std::atomic<bool> countersEnabled(false);
+
+        thread_local const char *threadPhase = nullptr;
+
+        // Process-wide, as the storage freed by a thread is often allocated by another
+        std::atomic<std::uint64_t> liveBytes(0);
+
+        // Totals of the epoch not closed yet
+        std::atomic<std::uint64_t> epochAllocationCount(0);
+        std::atomic<std::uint64_t> epochBytes(0);
+        std::atomic<std::uint64_t> epochPeakLiveBytes(0);
+
+        void RaiseTo(std::atomic<std::uint64_t> &peak, std::uint64_t value)
+        {
+            std::uint64_t current = peak.load(std::memory_order_relaxed);
+
+            while (current < value && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+        }
+
+        /**
+         * Hardware counters of a single thread, opened as one group so they are read together by a single system call
+         */
+        class CounterGroup
+        {
+        public:
+            ~CounterGroup()
+            {
+#ifdef __linux__
+                for (std::size_t i = 0; i < COUNTER_COUNT; i++) {
+                    if (fds[i] >= 0)
+                        close(fds[i]);
+                }
+#endif
+            }
+
+            /**
+             * Opens the counters of the calling thread, once
+             * @returns whether cycles could be counted, the other events being optional
+             */
+            bool Open()
+            {
+                if (opened || failed)
+                    return opened;
+
+#ifdef __linux__
+                const std::uint32_t types[COUNTER_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+                const std::uint64_t configs[COUNTER_COUNT] = {
+                    PERF_COUNT_HW_CPU_CYCLES,
+                    PERF_COUNT_HW_INSTRUCTIONS,
+                    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+                    PERF_COUNT_HW_CACHE_MISSES,
+                    PERF_COUNT_HW_BRANCH_MISSES
+                };
+
+                for (std::size_t i = 0; i < COUNTER_COUNT; i++) {
+                    perf_event_attr attributes;
+                    std::memset(&attributes, 0, sizeof(attributes));
+                    attributes.size = sizeof(attributes);
+                    attributes.type = types[i];
+                    attributes.config = configs[i];
+                    attributes.exclude_kernel = 1;
+                    attributes.exclude_hv = 1;
+                    attributes.read_format = PERF_FORMAT_GROUP;
+
+                    // the cycles counter leads the group, and the group is given up without it
+                    fds[i] = syscall(SYS_perf_event_open, &attributes, 0, -1, i == 0 ? -1 : fds[0], 0);
+
+                    if (i == 0 && fds[0] < 0)
+                        break;
+
+                    if (fds[i] >= 0)
+                        order[openCount++] = i;
+                }
+
+                opened = fds[0] >= 0;
+#endif
+
+                failed = !opened;
+                return opened;
+            }
+
+            /**
+             * Reads every counter, indexed by `Counter`, events that could not be opened reading 0
+             * @returns false when the counters of the thread could not be opened
+             */
+            bool Read(std::uint64_t *values)
+            {
+                if (!Open())
+                    return false;
+
+#ifdef __linux__
+                std::uint64_t buffer[1 + COUNTER_COUNT];
+
+                if (read(fds[0], buffer, sizeof(buffer)) < (ssize_t) ((1 + openCount) * sizeof(std::uint64_t)))
+                    return false;
+
+                std::fill(values, values + COUNTER_COUNT, 0);
+
+                for (std::size_t i = 0; i < openCount; i++) {
+                    values[order[i]] = buffer[1 + i];
+                }
+
+                return true;
+#else
+                return false;
+#endif
+            }
+
+        private:
+            int fds[COUNTER_COUNT] = {-1, -1, -1, -1, -1};
+            std::size_t order[COUNTER_COUNT] = {};     // Counter of each value of a group read, in the order the counters were opened
+            std::size_t openCount = 0;
+            bool opened = false;
+            bool failed = false;
+        };
+
+        thread_local CounterGroup counterGroup;
+
+        /**
+         * Nanoseconds since the first call, so trace timestamps start near zero
+         */
+        std::int64_t Now()
+        {
+            static const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+        }
+
+        void WriteEscaped(std::ostream &out, const std::string &text)
+        {
+            for (char c : text) {
+                if (c == '"' || c == '\\')
+                    out << '\\';
+
+                out << c;
+            }
+        }
+
+        /**
+         * Measures the roofline of the calling thread
+         * @param triadSize values in each array of the triad
+         */
+        Roofline MeasureThread(std::size_t triadSize)
+        {
+            Roofline roofline = {0, 0, 1, 0, 0};
+
+            // Independent chains of multiply-adds, enough of them to hide the latency of each
+            const std::size_t FLOP_ITERATIONS = 1 << 22;
+
+#if defined(__AVX2__) && defined(__FMA__)
+            const std::size_t CHAINS = 10;
+            const double flopsPerIteration = CHAINS * 4 * 2;
+            __m256d sums[CHAINS];
+            const __m256d factor = _mm256_set1_pd(0.999999);
+            const __m256d addend = _mm256_set1_pd(1e-9);
+
+            for (std::size_t c = 0; c < CHAINS; c++) {
+                sums[c] = _mm256_set1_pd((double) c);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (std::size_t i = 0; i < FLOP_ITERATIONS; i++) {
+                for (std::size_t c = 0; c < CHAINS; c++) {
+                    sums[c] = _mm256_fmadd_pd(sums[c], factor, addend);
+                }
+            }
+
+            __m256d total = sums[0];
+
+            for (std::size_t c = 1; c < CHAINS; c++) {
+                total = _mm256_add_pd(total, sums[c]);
+            }
+
+            volatile double sink = _mm256_cvtsd_f64(total);
+#elif defined(__SSE2__)
+            const std::size_t CHAINS = 10;
+            const double flopsPerIteration = CHAINS * 2 * 2;
+            __m128d sums[CHAINS];
+            const __m128d factor = _mm_set1_pd(0.999999);
+            const __m128d addend = _mm_set1_pd(1e-9);
+
+            for (std::size_t c = 0; c < CHAINS; c++) {
+                sums[c] = _mm_set1_pd((double) c);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (std::size_t i = 0; i < FLOP_ITERATIONS; i++) {
+                for (std::size_t c = 0; c < CHAINS; c++) {
+                    sums[c] = _mm_add_pd(_mm_mul_pd(sums[c], factor), addend);
+                }
+            }
+
+            __m128d total = sums[0];
+
+            for (std::size_t c = 1; c < CHAINS; c++) {
+                total = _mm_add_pd(total, sums[c]);
+            }
+
+            volatile double sink = _mm_cvtsd_f64(total);
+#else
+            const std::size_t CHAINS = 10;
+            const double flopsPerIteration = CHAINS * 2;
+            double sums[CHAINS];
+
+            for (std::size_t c = 0; c < CHAINS; c++) {
+                sums[c] = c;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (std::size_t i = 0; i < FLOP_ITERATIONS; i++) {
+                for (std::size_t c = 0; c < CHAINS; c++) {
+                    sums[c] = sums[c] * 0.999999 + 1e-9;
+                }
+            }
+
+            volatile double sink = 0;
+
+            for (std::size_t c = 0; c < CHAINS; c++) {
+                sink = sink + sums[c];
+            }
+#endif
+
+            (void) sink;
+            roofline.gflops = flopsPerIteration * FLOP_ITERATIONS / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e-9;
+
+            // Triad over arrays larger than the last level cache, counting the bytes read and written as STREAM does, best of a few passes
+            const std::size_t TRIAD_PASSES = 5;
+            std::vector<double> a(triadSize, 0), b(triadSize, 1), c(triadSize, 2);
+
+            for (std::size_t pass = 0; pass < TRIAD_PASSES; pass++) {
+                auto triadStart = std::chrono::steady_clock::now();
+
+                for (std::size_t i = 0; i < triadSize; i++) {
+                    a[i] = b[i] + 3 * c[i];
+                }
+
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - triadStart).count();
+                roofline.gigabytesPerSecond = std::max(roofline.gigabytesPerSecond, 3 * sizeof(double) * triadSize / seconds * 1e-9);
+                std::swap(a, b);
+            }
+
+            return roofline;
+        }
+    }
+
+    std::size_t Register(const char *name)
+    {
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+
+        std::vector<std::string>::iterator found = std::find(registry.names.begin(), registry.names.end(), name);
+
+        if (found != registry.names.end())
+            return found - registry.names.begin();
+
+        registry.names.push_back(name);
+        return registry.names.size() - 1;
+    }
+
+    Scope::Scope(std::size_t p_region, std::uint64_t p_bytes, std::uint64_t p_flops)
+        :region(p_region), bytes(p_bytes), flops(p_flops)
+    {
+        ThreadLog &log = Log();
+        log.nestedTime.push_back(0);
+        log.openRegions.push_back(region);
+
+        // counters are read before the clock, so the time of a region leaves out its own reads
+        counted = countersEnabled.load(std::memory_order_relaxed) && counterGroup.Read(startCounters);
+        start = Now();
+    }
+
+    Scope::~Scope()
+    {
+        const std::int64_t duration = Now() - start;
+        std::uint64_t endCounters[COUNTER_COUNT];
+
+        if (counted)
+            counted = counterGroup.Read(endCounters);
+
+        ThreadLog &log = Log();
+
+        const std::int64_t nested = log.nestedTime.back();
+        log.nestedTime.pop_back();
+        log.openRegions.pop_back();
+
+        if (!log.nestedTime.empty())
+            log.nestedTime.back() += duration;
+
+        if (log.totals.size() <= region)
+            log.totals.resize(region + 1);
+
+        Totals &totals = log.totals[region];
+        totals.calls++;
+        totals.nanoseconds += duration;
+        totals.selfNanoseconds += duration - nested;
+        totals.bytes += bytes;
+        totals.flops += flops;
+
+        if (counted) {
+            for (std::size_t i = 0; i < COUNTER_COUNT; i++) {
+                totals.counters[i] += endCounters[i] - startCounters[i];
+            }
+
+            totals.countedCalls++;
+        }
+
+        if (log.events.size() < MAX_TRACE_EVENTS)
+            log.events.push_back({region, start, duration, bytes, flops});
+    }
+
+    Phase::Phase(const char *name)
+        :previous(threadPhase)
+    {
+        threadPhase = name;
+    }
+
+    Phase::~Phase()
+    {
+        threadPhase = previous;
+    }
+
+    const char *Phase::Current()
+    {
+        return threadPhase;
+    }
+
+    Epoch::Epoch(int p_epoch)
+        :epoch(p_epoch) {}
+
+    Epoch::~Epoch()
+    {
+        // allocations of other threads racing with the close land in either epoch, the totals of both staying exact
+        const std::uint64_t live = liveBytes.load(std::memory_order_relaxed);
+        EpochAllocations totals = {epoch, epochAllocationCount.exchange(0), epochBytes.exchange(0), epochPeakLiveBytes.exchange(live)};
+
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+        registry.epochs.push_back(totals);
+    }
+
+    void RecordAllocation(std::size_t bytes)
+    {
+        const std::uint64_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        epochAllocationCount.fetch_add(1, std::memory_order_relaxed);
+        epochBytes.fetch_add(bytes, std::memory_order_relaxed);
+        RaiseTo(epochPeakLiveBytes, live);
+
+        ThreadLog &log = Log();
+        AllocationTotals &totals = log.allocations[std::make_pair(threadPhase, log.openRegions.empty() ? NO_REGION : log.openRegions.back())];
+        totals.allocations++;
+        totals.bytes += bytes;
+        totals.peakLiveBytes = std::max(totals.peakLiveBytes, live);
+    }
+
+    void RecordDeallocation(std::size_t bytes)
+    {
+        liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    void RecordQueuedTask()
+    {
+        ThreadLog &log = Log();
+
+        if (log.openRegions.empty())
+            return;
+
+        const std::size_t region = log.openRegions.back();
+
+        if (log.totals.size() <= region)
+            log.totals.resize(region + 1);
+
+        log.totals[region].queuedTasks++;
+    }
+
+    std::uint64_t LiveBytes()
+    {
+        return liveBytes.load(std::memory_order_relaxed);
+    }
+
+    bool Enabled()
+    {
+#ifdef NN_PROFILE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    std::vector<RegionSummary> Summarize()
+    {
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+
+        std::vector<RegionSummary> summaries(registry.names.size(), RegionSummary());
+
+        for (std::size_t i = 0; i < summaries.size(); i++) {
+            summaries[i].name = registry.names[i];
+        }
+
+        for (const std::unique_ptr<ThreadLog> &log : registry.logs) {
+            for (std::size_t i = 0; i < log->totals.size(); i++) {
+                const Totals &totals = log->totals[i];
+                summaries[i].calls += totals.calls;
+                summaries[i].seconds += totals.nanoseconds * 1e-9;
+                summaries[i].selfSeconds += totals.selfNanoseconds * 1e-9;
+                summaries[i].bytes += totals.bytes;
+                summaries[i].flops += totals.flops;
+                summaries[i].countedCalls += totals.countedCalls;
+                summaries[i].queuedTasks += totals.queuedTasks;
+
+                for (std::size_t k = 0; k < COUNTER_COUNT; k++) {
+                    summaries[i].counters[k] += totals.counters[k];
+                }
+            }
+        }
+
+        summaries.erase(std::remove_if(summaries.begin(), summaries.end(), [](const RegionSummary &summary) { return summary.calls == 0; }), summaries.end());
+        std::stable_sort(summaries.begin(), summaries.end(), [](const RegionSummary &a, const RegionSummary &b) { return a.selfSeconds > b.selfSeconds; });
+
+        return summaries;
+    }
+
+    void PrintSummary(std::ostream &out)
+    {
+        if (!Enabled()) {
+            out << "profiling is disabled, build with -DNN_PROFILE to record regions" << std::endl;
+            return;
+        }
+
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+
+        out << std::left << std::setw(40) << "region" << std::right << std::setw(10) << "calls" << std::setw(12) << "total ms"
+            << std::setw(12) << "self ms" << std::setw(12) << "mean us" << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s" << std::endl;
+
+        out << std::fixed;
+
+        for (const RegionSummary &summary : Summarize()) {
+            out << std::left << std::setw(40) << summary.name << std::right << std::setw(10) << summary.calls << std::setprecision(2)
+                << std::setw(12) << summary.seconds * 1e3 << std::setw(12) << summary.selfSeconds * 1e3
+                << std::setw(12) << summary.seconds * 1e6 / summary.calls;
+
+            // throughput over the whole time of the region, nested regions included
+            out << std::setw(10);
+
+            if (summary.bytes && summary.seconds > 0)
+                out << summary.bytes / summary.seconds * 1e-9;
+            else
+                out << "";
+
+            out << std::setw(10);
+
+            if (summary.flops && summary.seconds > 0)
+                out << summary.flops / summary.seconds * 1e-9;
+            else
+                out << "";
+
+            out << std::endl;
+        }
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    std::vector<AllocationSummary> SummarizeAllocations()
+    {
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+
+        // phases are merged by name, as the same literal can have a different address in every translation unit
+        std::map<std::pair<std::string, std::string>, AllocationSummary> merged;
+
+        for (const std::unique_ptr<ThreadLog> &log : registry.logs) {
+            for (const auto &entry : log->allocations) {
+                const std::string phase = entry.first.first ? entry.first.first : "";
+                const std::string site = entry.first.second == NO_REGION ? "" : registry.names[entry.first.second];
+
+                AllocationSummary &summary = merged.emplace(std::make_pair(phase, site), AllocationSummary{phase, site, 0, 0, 0}).first->second;
+                summary.allocations += entry.second.allocations;
+                summary.bytes += entry.second.bytes;
+                summary.peakLiveBytes = std::max(summary.peakLiveBytes, entry.second.peakLiveBytes);
+            }
+        }
+
+        std::vector<AllocationSummary> summaries;
+
+        for (const auto &entry : merged) {
+            summaries.push_back(entry.second);
+        }
+
+        std::stable_sort(summaries.begin(), summaries.end(), [](const AllocationSummary &a, const AllocationSummary &b) { return a.bytes > b.bytes; });
+
+        return summaries;
+    }
+
+    std::vector<EpochAllocations> AllocationsByEpoch()
+    {
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+
+        return registry.epochs;
+    }
+
+    void PrintAllocationSummary(std::ostream &out)
+    {
+        if (!Enabled()) {
+            out << "profiling is disabled, build with -DNN_PROFILE to count allocations" << std::endl;
+            return;
+        }
+
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+
+        out << std::fixed << std::setprecision(2);
+        out << std::right << std::setw(8) << "epoch" << std::setw(14) << "allocations" << std::setw(12) << "MB" << std::setw(14) << "peak live MB" << std::endl;
+
+        for (const EpochAllocations &epoch : AllocationsByEpoch()) {
+            out << std::setw(8) << epoch.epoch << std::setw(14) << epoch.allocations << std::setw(12) << epoch.bytes * 1e-6
+                << std::setw(14) << epoch.peakLiveBytes * 1e-6 << std::endl;
+        }
+
+        out << std::left << std::setw(12) << "phase" << std::setw(40) << "site" << std::right << std::setw(14) << "allocations"
+            << std::setw(12) << "MB" << std::setw(12) << "mean KB" << std::setw(14) << "peak live MB" << std::endl;
+
+        for (const AllocationSummary &summary : SummarizeAllocations()) {
+            out << std::left << std::setw(12) << (summary.phase.empty() ? "-" : summary.phase) << std::setw(40) << (summary.site.empty() ? "-" : summary.site)
+                << std::right << std::setw(14) << summary.allocations << std::setw(12) << summary.bytes * 1e-6
+                << std::setw(12) << summary.bytes * 1e-3 / summary.allocations << std::setw(14) << summary.peakLiveBytes * 1e-6 << std::endl;
+        }
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    void WriteTrace(const std::string &pathname)
+    {
+        std::ofstream file(pathname, std::ios::trunc);
+
+        if (!file.is_open())
+            throw std::runtime_error("error opening trace file at \"" + pathname + "\"");
+
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+        file << std::fixed << std::setprecision(3);
+
+        bool first = true;
+
+        for (const std::unique_ptr<ThreadLog> &log : registry.logs) {
+            file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->thread
+                 << ",\"args\":{\"name\":\"thread " << log->thread << "\"}}";
+            first = false;
+
+            for (const Event &event : log->events) {
+                file << ",\n{\"name\":\"";
+                WriteEscaped(file, registry.names[event.region]);
+                file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << log->thread << ",\"ts\":" << event.start * 1e-3 << ",\"dur\":" << event.duration * 1e-3
+                     << ",\"args\":{\"bytes\":" << event.bytes << ",\"flops\":" << event.flops << "}}";
+            }
+        }
+
+        file << std::endl << "]}" << std::endl;
+
+        if (!file)
+            throw std::runtime_error("error writing trace file at \"" + pathname + "\"");
+    }
+
+    bool EnableCounters()
+    {
+        // opening them on the calling thread tells whether any thread can, other threads open theirs as they record
+        if (!counterGroup.Open())
+            return false;
+
+        countersEnabled = true;
+        return true;
+    }
+
+    Roofline MeasureRoofline(std::size_t threads)
+    {
+        // arrays of 4M values are larger than the last level cache of a single socket
+        const std::size_t TRIAD_SIZE = 1 << 22;
+
+        Roofline roofline = MeasureThread(TRIAD_SIZE);
+        roofline.threads = std::max<std::size_t>(threads, 1);
+        roofline.parallelGflops = roofline.gflops;
+        roofline.parallelGigabytesPerSecond = roofline.gigabytesPerSecond;
+
+        if (roofline.threads == 1)
+            return roofline;
+
+        // every thread measures at once, sharing the memory bandwidth as the threads of a pool do, the arrays of all of them
+        // together still being larger than the caches
+        std::vector<Roofline> results(roofline.threads);
+        std::vector<std::thread> workers;
+        std::atomic<std::size_t> ready(0);
+
+        for (std::size_t i = 0; i < roofline.threads; i++) {
+            workers.emplace_back([&, i] {
+                ready++;
+
+                while (ready < roofline.threads) {}
+
+                results[i] = MeasureThread(std::max<std::size_t>(TRIAD_SIZE / roofline.threads, 1 << 18));
+            });
+        }
+
+        roofline.parallelGflops = 0;
+        roofline.parallelGigabytesPerSecond = 0;
+
+        for (std::size_t i = 0; i < roofline.threads; i++) {
+            workers[i].join();
+            roofline.parallelGflops += results[i].gflops;
+            roofline.parallelGigabytesPerSecond += results[i].gigabytesPerSecond;
+        }
+
+        return roofline;
+    }
+
+    void PrintCounterSummary(std::ostream &out, const Roofline &roofline)
+    {
+        const std::ios::fmtflags flags = out.flags();
+        const std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(2);
+        out << "roofline: " << roofline.gflops << " GFLOP/s, " << roofline.gigabytesPerSecond << " GB/s, ridge at "
+            << roofline.gflops / roofline.gigabytesPerSecond << " flop/byte for 1 thread, " << roofline.parallelGflops << " GFLOP/s, "
+            << roofline.parallelGigabytesPerSecond << " GB/s, ridge at " << roofline.parallelGflops / roofline.parallelGigabytesPerSecond
+            << " flop/byte for " << roofline.threads << " threads" << std::endl;
+
+        out << std::left << std::setw(40) << "region" << std::right << std::setw(10) << "counted" << std::setw(8) << "IPC" << std::setw(10) << "L1 MPKI"
+            << std::setw(10) << "LLC MPKI" << std::setw(10) << "br MPKI" << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s"
+            << std::setw(10) << "flop/B" << std::setw(9) << "bound" << std::setw(9) << "threads" << std::setw(8) << "% roof" << std::endl;
+
+        for (const RegionSummary &summary : Summarize()) {
+            if (!summary.countedCalls)
+                continue;
+
+            const double cycles = summary.counters[(std::size_t) Counter::Cycles];
+            const double kiloInstructions = summary.counters[(std::size_t) Counter::Instructions] / 1e3;
+            const double gflops = summary.seconds > 0 ? summary.flops / summary.seconds * 1e-9 : 0;
+            const double gigabytesPerSecond = summary.seconds > 0 ? summary.bytes / summary.seconds * 1e-9 : 0;
+
+            auto perKiloInstruction = [&](Counter counter) { return kiloInstructions > 0 ? summary.counters[(std::size_t) counter] / kiloInstructions : 0; };
+
+            out << std::left << std::setw(40) << summary.name << std::right << std::setw(10) << summary.countedCalls
+                << std::setw(8) << (cycles > 0 ? kiloInstructions * 1e3 / cycles : 0) << std::setw(10) << perKiloInstruction(Counter::L1DataMisses)
+                << std::setw(10) << perKiloInstruction(Counter::LastLevelCacheMisses) << std::setw(10) << perKiloInstruction(Counter::BranchMisses);
+
+            // regions counting no bytes, such as waits, have no arithmetic intensity to place them on the roofline
+            if (!summary.bytes) {
+                out << std::setw(10) << "" << std::setw(10) << "" << std::setw(10) << "" << std::setw(9) << "-" << std::setw(9) << "" << std::setw(8) << "" << std::endl;
+                continue;
+            }
+
+            // the work of regions queuing tasks runs on every thread of the pools while they are timed on one
+            const bool parallel = summary.queuedTasks > 0;
+            const double peakGflops = parallel ? roofline.parallelGflops : roofline.gflops;
+            const double peakGigabytesPerSecond = parallel ? roofline.parallelGigabytesPerSecond : roofline.gigabytesPerSecond;
+
+            const double intensity = (double) summary.flops / summary.bytes;
+            const bool memoryBound = intensity < peakGflops / peakGigabytesPerSecond;
+
+            // memory-bound regions are held to the bandwidth, which also places regions counting no operations
+            const double achieved = memoryBound ? gigabytesPerSecond / peakGigabytesPerSecond : gflops / peakGflops;
+
+            out << std::setw(10) << gflops << std::setw(10) << gigabytesPerSecond << std::setw(10) << intensity
+                << std::setw(9) << (memoryBound ? "memory" : "compute") << std::setw(9) << (parallel ? roofline.threads : 1) << std::setw(8) << achieved * 100 << std::endl;
+        }
+
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    void Reset()
+    {
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+
+        for (const std::unique_ptr<ThreadLog> &log : registry.logs) {
+            log->totals.clear();
+            log->events.clear();
+            log->allocations.clear();
+        }
+
+        registry.epochs.clear();
+        epochAllocationCount = 0;
+        epochBytes = 0;
+        epochPeakLiveBytes = liveBytes.load();
+    }
+}
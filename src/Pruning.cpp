@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "Pruning.hpp"
+
+namespace NeuralNetwork
+{
+    namespace
+    {
+        /**
+         * Indices of the `count` smallest scores, ties broken by position so the result does not depend on the sort
+         */
+        std::vector<std::size_t> Smallest(const std::vector<double> &scores, std::size_t count)
+        {
+            std::vector<std::size_t> indices(scores.size());
+            std::iota(indices.begin(), indices.end(), 0);
+
+            auto smaller = [&scores](std::size_t a, std::size_t b) {
+                return scores[a] < scores[b] || (scores[a] == scores[b] && a < b);
+            };
+
+            if (count < indices.size())
+                std::nth_element(indices.begin(), indices.begin() + count, indices.end(), smaller);
+
+            indices.resize(std::min(count, indices.size()));
+            return indices;
+        }
+    }
+
+    Math::Matrix PruningMask(const Math::Matrix &weights, const PruningOptions &options)
+    {
+        if (options.sparsity < 0 || options.sparsity > 1)
+            throw std::invalid_argument("sparsity must be between 0 and 1");
+
+        const std::size_t rows = weights.rows;
+        const std::size_t cols = weights.cols;
+        const double *values = weights.data();
+
+        Math::Matrix mask(rows, cols, 1.0);
+        double *kept = mask.data();
+
+        switch (options.pattern) {
+        case PruningOptions::Pattern::Magnitude: {
+            std::vector<double> scores(rows * cols);
+
+            for (std::size_t i = 0; i < rows * cols; i++) {
+                scores[i] = std::abs(values[i]);
+            }
+
+            for (std::size_t i : Smallest(scores, (std::size_t) std::lround(options.sparsity * rows * cols))) {
+                kept[i] = 0;
+            }
+
+            break;
+        }
+        case PruningOptions::Pattern::NM: {
+            if (options.m == 0 || options.n > options.m)
+                throw std::invalid_argument("N:M pruning requires 0 < m and n <= m");
+
+            std::vector<double> scores;
+
+            for (std::size_t row = 0; row < rows; row++) {
+                for (std::size_t start = 0; start < cols; start += options.m) {
+                    std::size_t size = std::min(options.m, cols - start);
+                    scores.assign(size, 0);
+
+                    for (std::size_t k = 0; k < size; k++) {
+                        scores[k] = std::abs(values[row * cols + start + k]);
+                    }
+
+                    // A partial group at the end of the row keeps up to n weights as well
+                    for (std::size_t k : Smallest(scores, size > options.n ? size - options.n : 0)) {
+                        kept[row * cols + start + k] = 0;
+                    }
+                }
+            }
+
+            break;
+        }
+        case PruningOptions::Pattern::Block: {
+            if (options.blockRows == 0 || options.blockCols == 0)
+                throw std::invalid_argument("blocks must have positive dimensions");
+
+            const std::size_t blockRowCount = (rows + options.blockRows - 1) / options.blockRows;
+            const std::size_t blockColCount = (cols + options.blockCols - 1) / options.blockCols;
+
+            // Blocks are scored by their mean magnitude, so partial blocks on the edges are not favored for removal
+            std::vector<double> scores(blockRowCount * blockColCount, 0);
+            std::vector<std::size_t> sizes(scores.size(), 0);
+
+            for (std::size_t row = 0; row < rows; row++) {
+                for (std::size_t col = 0; col < cols; col++) {
+                    std::size_t block = row / options.blockRows * blockColCount + col / options.blockCols;
+                    scores[block] += std::abs(values[row * cols + col]);
+                    sizes[block]++;
+                }
+            }
+
+            for (std::size_t i = 0; i < scores.size(); i++) {
+                scores[i] /= sizes[i];
+            }
+
+            for (std::size_t block : Smallest(scores, (std::size_t) std::lround(options.sparsity * scores.size()))) {
+                std::size_t firstRow = block / blockColCount * options.blockRows;
+                std::size_t firstCol = block % blockColCount * options.blockCols;
+
+                for (std::size_t row = firstRow; row < std::min(firstRow + options.blockRows, rows); row++) {
+                    for (std::size_t col = firstCol; col < std::min(firstCol + options.blockCols, cols); col++) {
+                        kept[row * cols + col] = 0;
+                    }
+                }
+            }
+
+            break;
+        }
+        }
+
+        return mask;
+    }
+}
@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "ActivationFn.hpp"
+#include "AlignedBuffer.hpp"
+#include "Layer.hpp"
+#include "Matrix.hpp"
+#include "QuantizedModel.hpp"
+
+namespace NeuralNetwork
+{
+    namespace
+    {
+        // Instances computed together, so each weight block is loaded once for all of them
+#if defined(__AVX2__)
+        const std::size_t SAMPLE_BLOCK = 4;
+#else
+        const std::size_t SAMPLE_BLOCK = 2;
+#endif
+
+        const std::int32_t QUANTIZED_MAX = 127;
+
+        /**
+         * Quantizes a value onto [0, 127], rounding to the nearest integer
+         */
+        inline std::uint8_t Quantize(float value, float inverseScale, std::int32_t zeroPoint)
+        {
+            std::int32_t quantized = (std::int32_t) std::lrint(value * inverseScale) + zeroPoint;
+            return (std::uint8_t) std::min(std::max(quantized, (std::int32_t) 0), QUANTIZED_MAX);
+        }
+
+#if defined(__AVX2__)
+        /**
+         * Adds the sums of four products of unsigned by signed bytes to each 32 bit lane
+         */
+        inline __m256i MultiplyAccumulate(__m256i accumulator, __m256i inputs, __m256i weights)
+        {
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+            return _mm256_dpbusd_epi32(accumulator, inputs, weights);
+#elif defined(__AVXVNNI__)
+            return _mm256_dpbusd_avx_epi32(accumulator, inputs, weights);
+#else
+            // Pairs of products are summed into 16 bits, which 7 bit inputs keep from saturating
+            const __m256i pairs = _mm256_maddubs_epi16(inputs, weights);
+            return _mm256_add_epi32(accumulator, _mm256_madd_epi16(pairs, _mm256_set1_epi16(1)));
+#endif
+        }
+#endif
+
+        /**
+         * Accumulates the integer products of one row block of a layer for `S` instances
+         * @param weights packed row block, `ROW_BLOCK * INPUT_GROUP` weights per group of inputs
+         * @param input first quantized input instance
+         * @param inputStride distance between the inputs of consecutive instances
+         * @param inputCount number of inputs of each instance, a multiple of `INPUT_GROUP`
+         * @param accumulators written with `ROW_BLOCK` sums for each instance
+         */
+        template <std::size_t S>
+        void Accumulate(const std::int8_t *weights, const std::uint8_t *input, std::size_t inputStride, std::size_t inputCount, std::int32_t *accumulators)
+        {
+            const std::size_t B = QuantizedModel::ROW_BLOCK;
+            const std::size_t G = QuantizedModel::INPUT_GROUP;
+
+#if defined(__AVX2__)
+            __m256i sums[S];
+
+            for (std::size_t s = 0; s < S; s++) {
+                sums[s] = _mm256_setzero_si256();
+            }
+
+            for (std::size_t k = 0; k < inputCount; k += G) {
+                const __m256i weight = _mm256_load_si256(reinterpret_cast<const __m256i *>(weights + k * B));
+
+                for (std::size_t s = 0; s < S; s++) {
+                    std::int32_t group;
+                    std::memcpy(&group, input + s * inputStride + k, sizeof(group));
+                    sums[s] = MultiplyAccumulate(sums[s], _mm256_set1_epi32(group), weight);
+                }
+            }
+
+            for (std::size_t s = 0; s < S; s++) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(accumulators + s * B), sums[s]);
+            }
+#elif defined(__SSE2__)
+            // Without byte multiplies, weights and inputs are widened to 16 bits, and `madd` leaves two partial sums per row
+            __m128i sums[S][4];
+
+            for (std::size_t s = 0; s < S; s++) {
+                for (std::size_t i = 0; i < 4; i++) {
+                    sums[s][i] = _mm_setzero_si128();
+                }
+            }
+
+            const __m128i zero = _mm_setzero_si128();
+
+            for (std::size_t k = 0; k < inputCount; k += G) {
+                const __m128i low = _mm_load_si128(reinterpret_cast<const __m128i *>(weights + k * B));
+                const __m128i high = _mm_load_si128(reinterpret_cast<const __m128i *>(weights + k * B + 16));
+
+                // Each register holds the four weights of two rows, sign extended
+                const __m128i weight[4] = {
+                    _mm_srai_epi16(_mm_unpacklo_epi8(low, low), 8),
+                    _mm_srai_epi16(_mm_unpackhi_epi8(low, low), 8),
+                    _mm_srai_epi16(_mm_unpacklo_epi8(high, high), 8),
+                    _mm_srai_epi16(_mm_unpackhi_epi8(high, high), 8)
+                };
+
+                for (std::size_t s = 0; s < S; s++) {
+                    std::int32_t group;
+                    std::memcpy(&group, input + s * inputStride + k, sizeof(group));
+                    const __m128i value = _mm_unpacklo_epi8(_mm_set1_epi32(group), zero);
+
+                    for (std::size_t i = 0; i < 4; i++) {
+                        sums[s][i] = _mm_add_epi32(sums[s][i], _mm_madd_epi16(weight[i], value));
+                    }
+                }
+            }
+
+            for (std::size_t s = 0; s < S; s++) {
+                for (std::size_t i = 0; i < 4; i += 2) {
+                    // Adds the two partial sums of each of four rows
+                    const __m128 first = _mm_castsi128_ps(sums[s][i]);
+                    const __m128 second = _mm_castsi128_ps(sums[s][i + 1]);
+                    const __m128i even = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+                    const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(accumulators + s * B + i * 2), _mm_add_epi32(even, odd));
+                }
+            }
+#else
+            for (std::size_t s = 0; s < S; s++) {
+                std::int32_t *sums = accumulators + s * B;
+                std::fill(sums, sums + B, 0);
+
+                for (std::size_t k = 0; k < inputCount; k += G) {
+                    const std::int8_t *weight = weights + k * B;
+                    const std::uint8_t *value = input + s * inputStride + k;
+
+                    for (std::size_t l = 0; l < B; l++) {
+                        for (std::size_t j = 0; j < G; j++) {
+                            sums[l] += value[j] * weight[l * G + j];
+                        }
+                    }
+                }
+            }
+#endif
+        }
+
+        /**
+         * Dequantizes the sums of a row block, then adds the bias and applies the activation
+         * @param accumulators `ROW_BLOCK` integer sums
+         * @param output written with `ROW_BLOCK` values
+         */
+        inline void Dequantize(const std::int32_t *accumulators, const float *scales, const float *bias, ActivationFn::Id activation, float *output)
+        {
+            for (std::size_t l = 0; l < QuantizedModel::ROW_BLOCK; l++) {
+                output[l] = accumulators[l] * scales[l] + bias[l];
+            }
+
+            ActivationFn::Apply(activation, output, QuantizedModel::ROW_BLOCK);
+        }
+    }
+
+    const std::size_t QuantizedModel::ROW_BLOCK;
+    const std::size_t QuantizedModel::INPUT_GROUP;
+
+    QuantizedModel::Workspace::Workspace(std::size_t size, std::size_t outputSize)
+        : front(size), back(size), output(outputSize) {}
+
+    QuantizedModel::QuantizedModel(const std::vector<Layer> &p_layers, const float *calibration, std::size_t calibrationCount, std::size_t maxBatchSize)
+        : batchSize(maxBatchSize), workspaces(new WorkspacePool())
+    {
+        if (p_layers.size() < 2)
+            throw std::invalid_argument("neural network layers are not defined");
+
+        if (batchSize == 0)
+            throw std::invalid_argument("batch size must be positive");
+
+        if (calibrationCount == 0)
+            throw std::invalid_argument("calibration requires at least one instance");
+
+        inputCount = p_layers[0].neuronCount;
+        paddedInputCount = AlignedBuffer::AlignUp(inputCount, ROW_BLOCK);
+
+        // Runs the calibration set through the model, recording the range of every layer's inputs
+        // Ranges always include zero, so zero is represented exactly and ReLU outputs lose no precision at the bottom
+        std::vector<float> lows(p_layers.size(), 0);
+        std::vector<float> highs(p_layers.size(), 0);
+        std::vector<float> values(calibration, calibration + calibrationCount * inputCount);
+
+        // Factorized layers are quantized multiplied out, their rank only saving memory in single precision
+        std::vector<Math::Matrix> layerWeights;
+
+        for (const Layer &layer : p_layers) {
+            layerWeights.push_back(layer.Weights());
+        }
+
+        for (std::size_t i = 0; ; i++) {
+            for (float value : values) {
+                lows[i] = std::min(lows[i], value);
+                highs[i] = std::max(highs[i], value);
+            }
+
+            // The range of the outputs of the last layer is not needed, as they are not quantized
+            if (i + 2 >= p_layers.size())
+                break;
+
+            const Layer &layer = p_layers[i + 1];
+            const double *weights = layerWeights[i + 1].data();
+            const double *bias = layer.biasVector.data();
+            const ActivationFn::Id activation = layer.activationFn ? layer.activationFn->id() : ActivationFn::Id::None;
+            std::vector<float> next(calibrationCount * layer.neuronCount);
+
+            for (std::size_t s = 0; s < calibrationCount; s++) {
+                const float *instance = &values[s * layer.connectionCount];
+                float *output = &next[s * layer.neuronCount];
+
+                for (std::size_t row = 0; row < layer.neuronCount; row++) {
+                    double sum = bias[row];
+
+                    for (std::size_t k = 0; k < layer.connectionCount; k++) {
+                        sum += weights[row * layer.connectionCount + k] * instance[k];
+                    }
+
+                    output[row] = sum;
+                }
+
+                ActivationFn::Apply(activation, output, layer.neuronCount);
+            }
+
+            values.swap(next);
+        }
+
+        std::vector<Quantization> quantizations(p_layers.size());
+
+        for (std::size_t i = 0; i < p_layers.size(); i++) {
+            float scale = (highs[i] - lows[i]) / QUANTIZED_MAX;
+            quantizations[i].scale = scale > 0 ? scale : 1;
+            quantizations[i].zeroPoint = std::min((std::int32_t) std::lrint(-lows[i] / quantizations[i].scale), QUANTIZED_MAX);
+        }
+
+        input = quantizations[0];
+        std::size_t widest = paddedInputCount;
+        std::size_t layerInputCount = paddedInputCount;
+
+        for (std::size_t i = 1; i < p_layers.size(); i++) {
+            const Layer &layer = p_layers[i];
+            const Quantization &layerInput = quantizations[i - 1];
+            QuantizedLayer quantized;
+
+            quantized.inputCount = layerInputCount;
+            quantized.outputCount = layer.neuronCount;
+            quantized.paddedOutputCount = AlignedBuffer::AlignUp(layer.neuronCount, ROW_BLOCK);
+            quantized.activation = layer.activationFn ? layer.activationFn->id() : ActivationFn::Id::None;
+            quantized.output = quantizations[i];
+            quantized.weights.reset(new AlignedBuffer(quantized.paddedOutputCount * quantized.inputCount));
+            quantized.scales.reset(new AlignedBuffer(quantized.paddedOutputCount * sizeof(float)));
+            quantized.bias.reset(new AlignedBuffer(quantized.paddedOutputCount * sizeof(float)));
+
+            // Padded rows and inputs keep zero weights, so they add nothing to the sums
+            std::int8_t *weights = static_cast<std::int8_t *>(quantized.weights->data());
+            float *scales = static_cast<float *>(quantized.scales->data());
+            float *bias = static_cast<float *>(quantized.bias->data());
+            const double *source = layerWeights[i].data();
+
+            for (std::size_t row = 0; row < quantized.outputCount; row++) {
+                const double *sourceRow = source + row * layer.connectionCount;
+                double largest = 0;
+
+                for (std::size_t k = 0; k < layer.connectionCount; k++) {
+                    largest = std::max(largest, std::abs(sourceRow[k]));
+                }
+
+                const double weightScale = largest > 0 ? largest / QUANTIZED_MAX : 1;
+                std::int8_t *block = weights + row / ROW_BLOCK * ROW_BLOCK * quantized.inputCount;
+                std::int32_t rowSum = 0;
+
+                for (std::size_t k = 0; k < layer.connectionCount; k++) {
+                    std::int8_t weight = (std::int8_t) std::lrint(sourceRow[k] / weightScale);
+                    block[k / INPUT_GROUP * ROW_BLOCK * INPUT_GROUP + row % ROW_BLOCK * INPUT_GROUP + k % INPUT_GROUP] = weight;
+                    rowSum += weight;
+                }
+
+                // The zero point of the inputs is folded into the bias, as sum(w * (x - z)) = sum(w * x) - z * sum(w)
+                scales[row] = layerInput.scale * weightScale;
+                bias[row] = layer.biasVector.data()[row] - scales[row] * layerInput.zeroPoint * rowSum;
+            }
+
+            layerInputCount = quantized.paddedOutputCount;
+            widest = std::max(widest, quantized.paddedOutputCount);
+            layers.push_back(std::move(quantized));
+        }
+
+        workspaceSize = batchSize * widest;
+    }
+
+    void QuantizedModel::PredictBatch(const float *values, std::size_t count, float *output, Workspace &workspace) const
+    {
+        std::uint8_t *buffers[2] = {static_cast<std::uint8_t *>(workspace.front.data()), static_cast<std::uint8_t *>(workspace.back.data())};
+        float *outputs = static_cast<float *>(workspace.output.data());
+
+        const float inverseScale = 1 / input.scale;
+
+        for (std::size_t s = 0; s < count; s++) {
+            for (std::size_t k = 0; k < inputCount; k++) {
+                buffers[0][s * paddedInputCount + k] = Quantize(values[s * inputCount + k], inverseScale, input.zeroPoint);
+            }
+        }
+
+        std::int32_t accumulators[SAMPLE_BLOCK * ROW_BLOCK];
+        float dequantized[ROW_BLOCK];
+
+        for (std::size_t i = 0; i < layers.size(); i++) {
+            const QuantizedLayer &layer = layers[i];
+            const bool last = i + 1 == layers.size();
+            const std::uint8_t *layerInput = buffers[i % 2];
+            std::uint8_t *layerOutput = buffers[(i + 1) % 2];
+            const std::int8_t *weights = static_cast<const std::int8_t *>(layer.weights->data());
+            const float *scales = static_cast<const float *>(layer.scales->data());
+            const float *bias = static_cast<const float *>(layer.bias->data());
+            const float outputInverseScale = 1 / layer.output.scale;
+
+            // Writes the sums of a row block for consecutive instances, quantized for the next layer unless this is the last
+            auto finish = [&](std::size_t first, std::size_t instances, std::size_t row) {
+                for (std::size_t t = 0; t < instances; t++) {
+                    const std::size_t position = (first + t) * layer.paddedOutputCount + row;
+
+                    if (last) {
+                        Dequantize(accumulators + t * ROW_BLOCK, scales + row, bias + row, layer.activation, outputs + position);
+                        continue;
+                    }
+
+                    Dequantize(accumulators + t * ROW_BLOCK, scales + row, bias + row, layer.activation, dequantized);
+
+                    for (std::size_t l = 0; l < ROW_BLOCK; l++) {
+                        layerOutput[position + l] = Quantize(dequantized[l], outputInverseScale, layer.output.zeroPoint);
+                    }
+                }
+            };
+
+            for (std::size_t row = 0; row < layer.paddedOutputCount; row += ROW_BLOCK) {
+                const std::int8_t *block = weights + row * layer.inputCount;
+
+                std::size_t s = 0;
+
+                for (; s + SAMPLE_BLOCK <= count; s += SAMPLE_BLOCK) {
+                    Accumulate<SAMPLE_BLOCK>(block, layerInput + s * layer.inputCount, layer.inputCount, layer.inputCount, accumulators);
+                    finish(s, SAMPLE_BLOCK, row);
+                }
+
+                for (; s < count; s++) {
+                    Accumulate<1>(block, layerInput + s * layer.inputCount, layer.inputCount, layer.inputCount, accumulators);
+                    finish(s, 1, row);
+                }
+            }
+        }
+
+        const QuantizedLayer &last = layers.back();
+
+        for (std::size_t s = 0; s < count; s++) {
+            std::memcpy(output + s * last.outputCount, outputs + s * last.paddedOutputCount, last.outputCount * sizeof(float));
+        }
+    }
+
+    void QuantizedModel::Predict(const float *input, std::size_t count, float *output) const
+    {
+        std::unique_ptr<Workspace> workspace;
+
+        {
+            std::unique_lock<std::mutex> lock(workspaces->mutex);
+
+            if (!workspaces->available.empty()) {
+                workspace = std::move(workspaces->available.back());
+                workspaces->available.pop_back();
+            }
+        }
+
+        if (!workspace)
+            workspace.reset(new Workspace(workspaceSize, batchSize * layers.back().paddedOutputCount * sizeof(float)));
+
+        for (std::size_t start = 0; start < count; start += batchSize) {
+            std::size_t batch = std::min(batchSize, count - start);
+            PredictBatch(input + start * inputCount, batch, output + start * outputSize(), *workspace);
+        }
+
+        std::unique_lock<std::mutex> lock(workspaces->mutex);
+        workspaces->available.push_back(std::move(workspace));
+    }
+
+    std::size_t QuantizedModel::inputSize() const
+    {
+        return inputCount;
+    }
+
+    std::size_t QuantizedModel::outputSize() const
+    {
+        return layers.back().outputCount;
+    }
+
+    std::size_t QuantizedModel::maxBatchSize() const
+    {
+        return batchSize;
+    }
+
+    std::size_t QuantizedModel::weightSize() const
+    {
+        std::size_t size = 0;
+
+        for (const QuantizedLayer &layer : layers) {
+            size += layer.weights->size();
+        }
+
+        return size;
+    }
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "Evaluator.hpp"
+#include "Schedule.hpp"
+
+namespace Schedule
+{
+    namespace
+    {
+        const double PI = 3.14159265358979323846;
+    }
+
+    Schedule::~Schedule() {}
+
+    void Schedule::Observe(const NeuralNetwork::EvaluationResult &results) {}
+
+    void Schedule::Reset() {}
+
+    bool Schedule::needsTestingSet() const
+    {
+        return false;
+    }
+
+    double Constant::Rate(int epoch, double baseRate)
+    {
+        return baseRate;
+    }
+
+    Step::Step(int p_stepSize, double p_gamma)
+        :stepSize(p_stepSize), gamma(p_gamma)
+    {
+        if (stepSize <= 0)
+            throw std::invalid_argument("the step size of a schedule must be positive");
+    }
+
+    double Step::Rate(int epoch, double baseRate)
+    {
+        return baseRate * std::pow(gamma, epoch / stepSize);
+    }
+
+    Cosine::Cosine(int p_period, double p_minFactor)
+        :period(p_period), minFactor(p_minFactor)
+    {
+        if (period <= 0)
+            throw std::invalid_argument("the period of a schedule must be positive");
+    }
+
+    double Cosine::Rate(int epoch, double baseRate)
+    {
+        const double progress = (double) std::min(epoch, period) / period;
+        return baseRate * (minFactor + (1 - minFactor) * (1 + std::cos(PI * progress)) / 2);
+    }
+
+    Warmup::Warmup(int p_epochs, Schedule *p_after)
+        :epochs(p_epochs), after(p_after ? p_after : new Constant())
+    {
+        if (epochs <= 0)
+            throw std::invalid_argument("warmup must last at least an epoch");
+    }
+
+    double Warmup::Rate(int epoch, double baseRate)
+    {
+        if (epoch < epochs)
+            return baseRate * (epoch + 1) / epochs;
+
+        return after->Rate(epoch - epochs, baseRate);
+    }
+
+    void Warmup::Observe(const NeuralNetwork::EvaluationResult &results)
+    {
+        // The schedule after the warmup sees epochs counted from the end of the warmup, as it does in `Rate`
+        if (results.epoch < epochs)
+            return;
+
+        NeuralNetwork::EvaluationResult shifted = results;
+        shifted.epoch -= epochs;
+        after->Observe(shifted);
+    }
+
+    void Warmup::Reset()
+    {
+        after->Reset();
+    }
+
+    bool Warmup::needsTestingSet() const
+    {
+        return after->needsTestingSet();
+    }
+
+    ReduceOnPlateau::ReduceOnPlateau(NeuralNetwork::Metric metric, double p_factor, int p_patience, double minDelta, double p_minFactor)
+        :monitor(metric, minDelta), factor(p_factor), patience(p_patience), minFactor(p_minFactor)
+    {
+        if (factor <= 0 || factor >= 1)
+            throw std::invalid_argument("the factor reducing the learning rate must be between 0 and 1");
+
+        if (patience <= 0)
+            throw std::invalid_argument("the patience of a schedule must be positive");
+    }
+
+    double ReduceOnPlateau::Rate(int epoch, double baseRate)
+    {
+        return baseRate * std::max(scale, minFactor);
+    }
+
+    void ReduceOnPlateau::Observe(const NeuralNetwork::EvaluationResult &results)
+    {
+        if (monitor.Observe(results))
+            return;
+
+        // A reduction restarts the patience, so the lower rate gets as many epochs to improve as the rate before it
+        const int since = std::min(monitor.epochsSinceBest(), results.epoch - lastReduction);
+
+        if (since >= patience) {
+            scale *= factor;
+            lastReduction = results.epoch;
+        }
+    }
+
+    void ReduceOnPlateau::Reset()
+    {
+        monitor.Reset();
+        scale = 1;
+        lastReduction = -1;
+    }
+
+    bool ReduceOnPlateau::needsTestingSet() const
+    {
+        return NeuralNetwork::IsValidationMetric(monitor.followedMetric());
+    }
+}
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+#include "Data.hpp"
+#include "DataStream.hpp"
+#include "Matrix.hpp"
+#include "ShuffleBuffer.hpp"
+
+namespace
+{
+    // Instances are read from the source in chunks of this size
+    const std::size_t STAGING_SIZE = 1024;
+}
+
+ShuffleBuffer::ShuffleBuffer(DataStream &p_source, std::size_t p_capacity)
+    : source(p_source), capacity(p_capacity), bufferedCount(0),
+      staging(Math::Matrix(p_source.parameterSize(), STAGING_SIZE), Math::Matrix(p_source.labelSize(), STAGING_SIZE)), stagingPosition(STAGING_SIZE),
+      rng(std::chrono::system_clock::now().time_since_epoch().count())
+{
+    if (capacity == 0)
+        throw std::invalid_argument("shuffle buffer capacity must be positive");
+}
+
+std::size_t ShuffleBuffer::parameterSize() const
+{
+    return source.parameterSize();
+}
+
+std::size_t ShuffleBuffer::labelSize() const
+{
+    return source.labelSize();
+}
+
+bool ShuffleBuffer::Pull(double *row)
+{
+    if (stagingPosition == staging.dataInstanceCount) {
+        if (source.Read(STAGING_SIZE, staging) == 0)
+            return false;
+
+        stagingPosition = 0;
+    }
+
+    const std::size_t parameters = staging.parameterSize;
+    const std::size_t count = staging.dataInstanceCount;
+    const double *parameterValues = staging.parameters.data();
+    const double *labelValues = staging.label.data();
+
+    for (std::size_t j = 0; j < parameters; j++) {
+        row[j] = parameterValues[j * count + stagingPosition];
+    }
+
+    for (std::size_t j = 0; j < staging.labelSize; j++) {
+        row[parameters + j] = labelValues[j * count + stagingPosition];
+    }
+
+    stagingPosition++;
+
+    return true;
+}
+
+std::size_t ShuffleBuffer::Read(std::size_t count, Data &batch)
+{
+    const std::size_t instanceSize = parameterSize() + labelSize();
+
+    // The buffer is filled lazily, so constructing or resetting a buffer does not read the source
+    if (bufferedCount == 0) {
+        if (buffer.empty())
+            buffer.resize(capacity * instanceSize);
+
+        while (bufferedCount < capacity && Pull(buffer.data() + bufferedCount * instanceSize))
+            bufferedCount++;
+    }
+
+    if (instances.size() < count * instanceSize)
+        instances.resize(count * instanceSize);
+
+    std::size_t read = 0;
+
+    for (; read < count && bufferedCount > 0; read++) {
+        std::size_t position = std::uniform_int_distribution<std::size_t>(0, bufferedCount - 1)(rng);
+        double *row = buffer.data() + position * instanceSize;
+
+        std::memcpy(instances.data() + read * instanceSize, row, instanceSize * sizeof(double));
+
+        // The drawn instance is replaced by the next one of the source, or by the last buffered instance once the source ends
+        if (!Pull(row)) {
+            bufferedCount--;
+            std::memmove(row, buffer.data() + bufferedCount * instanceSize, instanceSize * sizeof(double));
+        }
+    }
+
+    if (read)
+        WriteBatch(instances.data(), read, batch);
+
+    return read;
+}
+
+bool ShuffleBuffer::AtEnd()
+{
+    return bufferedCount == 0 && stagingPosition == staging.dataInstanceCount && source.AtEnd();
+}
+
+void ShuffleBuffer::Reset()
+{
+    source.Reset();
+    bufferedCount = 0;
+    stagingPosition = staging.dataInstanceCount;
+}
+
+std::unique_ptr<DataStream> ShuffleBuffer::Reopen() const
+{
+    return source.Reopen();
+}
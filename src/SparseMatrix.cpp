@@ -0,0 +1,111 @@
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Matrix.hpp"
+#include "Profiler.hpp"
+#include "SparseMatrix.hpp"
+
+namespace Math
+{
+    SparseMatrix::SparseMatrix()
+        : rows(0), cols(0), rowOffsets(1, 0) {};
+
+    SparseMatrix::SparseMatrix(std::size_t p_rows, std::size_t p_cols)
+        : rows(p_rows), cols(p_cols), rowOffsets(p_rows + 1, 0) {};
+
+    SparseMatrix SparseMatrix::FromTranspose(const Matrix &matrix)
+    {
+        SparseMatrix result(matrix.cols, matrix.rows);
+        const double *values = matrix.data();
+
+        for (std::size_t i = 0; i < matrix.cols; i++) {
+            for (std::size_t j = 0; j < matrix.rows; j++) {
+                double value = values[j * matrix.cols + i];
+
+                if (value == 0)
+                    continue;
+
+                result.columns.push_back(j);
+                result.values.push_back(value);
+            }
+
+            result.rowOffsets[i + 1] = result.values.size();
+        }
+
+        return result;
+    };
+
+    std::size_t SparseMatrix::nonzeroCount() const
+    {
+        return values.size();
+    };
+
+    Matrix SparseMatrix::TransposedProduct(const Matrix &left) const
+    {
+        NN_PROFILE_SCOPE("SparseMatrix::TransposedProduct", (left.rows * left.cols + left.rows * rows + values.size()) * sizeof(double), 2 * left.rows * values.size());
+
+        if (left.cols != cols)
+            throw std::invalid_argument("matrix dimensions do not match for multiplication");
+
+        Matrix result(left.rows, rows);
+        const double *leftValues = left.data();
+        double *resultValues = result.data();
+
+        // A row of the left matrix stays in cache while the nonzero values of every row of this matrix gather from it
+        for (std::size_t r = 0; r < left.rows; r++) {
+            const double *leftRow = leftValues + r * left.cols;
+
+            for (std::size_t i = 0; i < rows; i++) {
+                double sum = 0;
+
+                for (std::size_t j = rowOffsets[i]; j < rowOffsets[i + 1]; j++) {
+                    sum += leftRow[columns[j]] * values[j];
+                }
+
+                resultValues[r * rows + i] = sum;
+            }
+        }
+
+        return result;
+    };
+
+    void SparseMatrix::AddProduct(const Matrix &left, double mult, Matrix &result, const Matrix *mask) const
+    {
+        NN_PROFILE_SCOPE("SparseMatrix::AddProduct", (left.rows * left.cols + left.rows * values.size() * 2) * sizeof(double), 2 * left.rows * values.size());
+
+        if (left.cols != rows || result.rows != left.rows || result.cols != cols)
+            throw std::invalid_argument("matrix dimensions do not match for multiplication");
+
+        if (mask && (mask->rows != result.rows || mask->cols != result.cols))
+            throw std::invalid_argument("mask does not match the size of the result");
+
+        const double *leftValues = left.data();
+        double *resultValues = result.data();
+        const double *maskValues = mask ? mask->data() : nullptr;
+
+        for (std::size_t r = 0; r < left.rows; r++) {
+            double *resultRow = resultValues + r * cols;
+            const double *maskRow = maskValues ? maskValues + r * cols : nullptr;
+
+            for (std::size_t i = 0; i < rows; i++) {
+                const double factor = mult * leftValues[r * left.cols + i];
+
+                if (factor == 0)
+                    continue;
+
+                if (maskRow) {
+                    for (std::size_t j = rowOffsets[i]; j < rowOffsets[i + 1]; j++) {
+                        resultRow[columns[j]] += factor * values[j] * maskRow[columns[j]];
+                    }
+                }
+                else {
+                    for (std::size_t j = rowOffsets[i]; j < rowOffsets[i + 1]; j++) {
+                        resultRow[columns[j]] += factor * values[j];
+                    }
+                }
+            }
+        }
+    };
+}
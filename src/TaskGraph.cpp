@@ -0,0 +1,98 @@
+#include <stdexcept>
+
+#include "Profiler.hpp"
+#include "TaskGraph.hpp"
+#include "Threadpool.hpp"
+
+TaskGraph::TaskId TaskGraph::AddTask(const Task &task, const std::vector<TaskId> &dependencies)
+{
+    TaskId id = nodes.size();
+
+    for (TaskId dependency : dependencies) {
+        if (dependency >= id)
+            throw std::invalid_argument("task dependencies must be added to the graph first");
+
+        nodes[dependency].successors.push_back(id);
+    }
+
+    nodes.push_back(Node{task, {}, dependencies.size()});
+
+    return id;
+}
+
+void TaskGraph::Run(ThreadPool &pool)
+{
+    if (nodes.empty())
+        return;
+
+    remaining.reset(new std::atomic<std::size_t>[nodes.size()]);
+
+    for (TaskId i = 0; i < nodes.size(); i++) {
+        remaining[i].store(nodes[i].dependencyCount);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(run_mutex);
+        finishedCount = 0;
+        error = nullptr;
+    }
+
+    for (TaskId i = 0; i < nodes.size(); i++) {
+        if (nodes[i].dependencyCount == 0)
+            Queue(pool, i);
+    }
+
+    {
+        NN_PROFILE_SCOPE("TaskGraph wait", 0, 0);
+        std::unique_lock<std::mutex> lock(run_mutex);
+        run_condition.wait(lock, [this] { return finishedCount == nodes.size(); });
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void TaskGraph::Queue(ThreadPool &pool, TaskId id)
+{
+    pool.QueueTask(
+        [this, &pool, id] {
+            bool failed;
+
+            {
+                std::unique_lock<std::mutex> lock(run_mutex);
+                failed = error != nullptr;
+            }
+
+            // Once a task has failed the rest of the graph is drained without running
+            if (!failed) {
+                try
+                {
+                    nodes[id].task();
+                }
+                catch (...)
+                {
+                    std::unique_lock<std::mutex> lock(run_mutex);
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+
+            for (TaskId successor : nodes[id].successors) {
+                if (remaining[successor].fetch_sub(1) == 1)
+                    Queue(pool, successor);
+            }
+
+            // Notified under the lock since Run may return and destroy the graph as soon as the count is reached
+            {
+                std::unique_lock<std::mutex> lock(run_mutex);
+                finishedCount++;
+                run_condition.notify_all();
+            }
+        }
+    );
+}
+
+std::size_t TaskGraph::size()
+{
+    return nodes.size();
+}
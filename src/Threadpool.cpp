@@ -3,6 +3,7 @@
 #include <iostream>
 #include <future>
 
+#include "Profiler.hpp"
 #include "Threadpool.hpp"
 
 ThreadPool::ThreadPool(std::size_t num_threads)
@@ -77,7 +78,20 @@ void ThreadPool::QueueTask(const Task &task)
 {
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
+
+#ifdef NN_PROFILE
+        // tasks run in the phase of the thread queuing them, so their allocations are attributed to the work they are part of,
+        // and the region queuing them is marked as spreading its work over the pool
+        const char *phase = Profiler::Phase::Current();
+        Profiler::RecordQueuedTask();
+
+        tasks.push([task, phase] {
+            Profiler::Phase taskPhase(phase);
+            task();
+        });
+#else
         tasks.push(task);
+#endif
     }
 
     mutex_condition.notify_one();
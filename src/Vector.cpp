@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <vector>
@@ -24,7 +25,10 @@ namespace Math
 
     Matrix Vector::Transpose()
     {
-        return Matrix(1, rows, values);
+        Matrix result(1, rows);
+        std::copy(values.begin(), values.end(), result.data());
+
+        return result;
     };
     
     std::size_t Vector::size() const
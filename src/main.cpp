@@ -1,9 +1,13 @@
 #include <iostream>
 #include <vector>
 #include <chrono>
+#include <cstdlib>
+#include <thread>
 
 #include "Data.hpp"
+#include "Dataset.hpp"
 #include "NeuralNetwork.hpp"
+#include "Profiler.hpp"
 
 using namespace NeuralNetwork;
 using namespace std::chrono;
@@ -12,6 +16,11 @@ using namespace std;
 int main(void) {
     srand(time(NULL));
 
+#ifdef NN_PROFILE
+    // hardware counters slow short regions down, so they are only read when asked for
+    const bool counters = getenv("NN_PROFILE_COUNTERS") && Profiler::EnableCounters();
+#endif
+
     auto start = high_resolution_clock::now();
 
     MultilayerPerceptron model(new CostFn::SparseCategoricalCrossEntropy());
@@ -36,7 +45,7 @@ int main(void) {
 
     // Data::TrainTestPartition data = Data::PartitionData(dataset);
 
-    Data::TrainTestPartition data = Data::LoadMNIST();
+    Dataset::TrainTestPartition data = Dataset::LoadMNIST();
 
     // cout << data.first[1].label << endl;
     // for (int i = 0; i < 28; i++) {
@@ -46,6 +55,14 @@ int main(void) {
     //     cout << endl;
     // }
 
+    // 5000 epochs is only a bound, training ends once validation cost stops improving and keeps the best weights
+    model.SetLearningRateSchedule(new Schedule::Warmup(2, new Schedule::ReduceOnPlateau(Metric::ValidationCost, 0.5, 3)));
+
+    EarlyStoppingOptions earlyStopping;
+    earlyStopping.enabled = true;
+    earlyStopping.patience = 8;
+    model.SetEarlyStopping(earlyStopping);
+
     model.Train(data.first, data.second, 5000, 0.1, 128);
     
     auto stop = high_resolution_clock::now();
@@ -53,4 +70,14 @@ int main(void) {
     auto duration = duration_cast<microseconds>(stop - start);
  
     cout << duration.count() << endl;
+
+#ifdef NN_PROFILE
+    // open trace.json in chrome://tracing or Perfetto for the timeline of every thread
+    Profiler::PrintSummary(cout);
+    Profiler::PrintAllocationSummary(cout);
+    Profiler::WriteTrace("trace.json");
+
+    if (counters)
+        Profiler::PrintCounterSummary(cout, Profiler::MeasureRoofline(thread::hardware_concurrency()));
+#endif
 }
\ No newline at end of file
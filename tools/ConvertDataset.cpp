@@ -0,0 +1,89 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CsvReader.hpp"
+#include "Dataset.hpp"
+
+using namespace std;
+
+/**
+ * Converts csv or IDX datasets into the binary dataset format read by `Dataset::Load`
+ *
+ * ConvertDataset csv <input.csv> <output> [--label-column N] [--scale S] [--offset O] [--no-header] [--quantize uint8|uint16]
+ * ConvertDataset idx <images> <labels> <output> [--scale S] [--offset O]
+ *
+ * Quantized csv datasets store each parameter in a byte or two, with a per-parameter scale and offset restoring its range
+ */
+int main(int argc, char **argv) {
+    vector<string> args(argv + 1, argv + argc);
+    vector<string> positional;
+
+    CsvOptions csvOptions;
+    double scale = 1;
+    double offset = 0;
+    string quantize;
+
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--no-header") {
+            csvOptions.hasHeader = false;
+        }
+        else if (args[i].rfind("--", 0) == 0 && i + 1 < args.size()) {
+            const string &value = args[++i];
+
+            if (args[i - 1] == "--label-column")
+                csvOptions.labelColumns = {(size_t) stoul(value)};
+            else if (args[i - 1] == "--scale")
+                scale = stod(value);
+            else if (args[i - 1] == "--offset")
+                offset = stod(value);
+            else if (args[i - 1] == "--quantize" && (value == "uint8" || value == "uint16"))
+                quantize = value;
+            else {
+                cerr << "unknown option " << args[i - 1] << endl;
+                return 1;
+            }
+        }
+        else {
+            positional.push_back(args[i]);
+        }
+    }
+
+    try {
+        if (positional.size() == 3 && positional[0] == "csv") {
+            // csv values are normalized while parsing, as they are stored as doubles
+            csvOptions.scale = scale;
+            csvOptions.offset = offset;
+
+            Dataset dataset = CsvReader(csvOptions).Read(positional[1]);
+
+            if (!quantize.empty())
+                dataset = dataset.Quantize(quantize == "uint8" ? Dataset::DType::UInt8 : Dataset::DType::UInt16);
+
+            dataset.Save(positional[2]);
+
+            cout << "Converted " << dataset.size() << " instances to " << positional[2] << endl;
+        }
+        else if (positional.size() == 4 && positional[0] == "idx") {
+            // IDX bytes are kept as is, and normalized as batches are gathered
+            Dataset dataset = Dataset::ReadIDX(positional[1], positional[2]);
+            dataset.SetNormalization(scale, offset);
+            dataset.Save(positional[3]);
+
+            cout << "Converted " << dataset.size() << " instances to " << positional[3] << endl;
+        }
+        else {
+            cerr << "usage: ConvertDataset csv <input.csv> <output> [--label-column N] [--scale S] [--offset O] [--no-header] [--quantize uint8|uint16]" << endl;
+            cerr << "       ConvertDataset idx <images> <labels> <output> [--scale S] [--offset O]" << endl;
+            return 1;
+        }
+    }
+    catch (const exception &error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
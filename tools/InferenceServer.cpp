@@ -0,0 +1,187 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "BatchScheduler.hpp"
+#include "InferenceModel.hpp"
+#include "NeuralNetwork.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+
+/**
+ * Serves predictions of a model checkpoint to other local processes over a Unix domain socket, batching concurrent requests
+ *
+ * InferenceServer <model> <socket> [--max-batch N] [--max-delay-us D] [--report-seconds S]
+ *
+ * On connecting, the server sends the input and output sizes of the model as two 32 bit unsigned integers.
+ * The client then sends requests of input size floats each, and receives output size floats for every request, in order.
+ * Integers and floats are in the byte order of the machine, as both ends run on it
+ */
+
+#ifndef _WIN32
+
+/**
+ * Reads or writes a whole buffer through a socket
+ * @returns false if the connection closed first
+ */
+bool ReadAll(int socket, void *buffer, size_t size) {
+    char *bytes = (char *) buffer;
+
+    while (size > 0) {
+        ssize_t count = read(socket, bytes, size);
+
+        if (count <= 0)
+            return false;
+
+        bytes += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+bool WriteAll(int socket, const void *buffer, size_t size) {
+    const char *bytes = (const char *) buffer;
+
+    while (size > 0) {
+        ssize_t count = write(socket, bytes, size);
+
+        if (count <= 0)
+            return false;
+
+        bytes += count;
+        size -= count;
+    }
+
+    return true;
+}
+
+/**
+ * Answers the requests of one client until it disconnects
+ */
+void Serve(int client, BatchScheduler &scheduler, const InferenceModel &model) {
+    uint32_t sizes[2] = {(uint32_t) model.inputSize(), (uint32_t) model.outputSize()};
+    vector<float> input(model.inputSize());
+    vector<float> output(model.outputSize());
+
+    if (WriteAll(client, sizes, sizeof(sizes))) {
+        while (ReadAll(client, input.data(), input.size() * sizeof(float))) {
+            scheduler.Predict(input.data(), output.data());
+
+            if (!WriteAll(client, output.data(), output.size() * sizeof(float)))
+                break;
+        }
+    }
+
+    close(client);
+}
+
+int main(int argc, char **argv) {
+    vector<string> args(argv + 1, argv + argc);
+    vector<string> positional;
+
+    size_t maxBatchSize = 64;
+    long maxDelay = 200;
+    double reportSeconds = 10;
+
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i].rfind("--", 0) == 0 && i + 1 < args.size()) {
+            const string &value = args[++i];
+
+            if (args[i - 1] == "--max-batch")
+                maxBatchSize = stoul(value);
+            else if (args[i - 1] == "--max-delay-us")
+                maxDelay = stol(value);
+            else if (args[i - 1] == "--report-seconds")
+                reportSeconds = stod(value);
+            else {
+                cerr << "unknown option " << args[i - 1] << endl;
+                return 1;
+            }
+        }
+        else {
+            positional.push_back(args[i]);
+        }
+    }
+
+    if (positional.size() != 2 || maxBatchSize == 0) {
+        cerr << "usage: InferenceServer <model> <socket> [--max-batch N] [--max-delay-us D] [--report-seconds S]" << endl;
+        return 1;
+    }
+
+    try {
+        MultilayerPerceptron network;
+        network.Load(positional[0]);
+
+        InferenceModel model = network.Compile(maxBatchSize);
+        BatchScheduler scheduler(model, maxBatchSize, chrono::microseconds(maxDelay));
+
+        // A client disconnecting mid-response should end its connection, not the server
+        signal(SIGPIPE, SIG_IGN);
+
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+
+        if (positional[1].size() >= sizeof(address.sun_path))
+            throw invalid_argument("socket path is too long");
+
+        positional[1].copy(address.sun_path, positional[1].size());
+        unlink(positional[1].c_str());
+
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (server < 0 || ::bind(server, (sockaddr *) &address, sizeof(address)) != 0 || listen(server, 64) != 0)
+            throw runtime_error("could not listen on " + positional[1]);
+
+        cout << "Serving " << model.inputSize() << " to " << model.outputSize() << " predictions on " << positional[1] << endl;
+
+        thread reporter([&scheduler, reportSeconds] {
+            while (true) {
+                this_thread::sleep_for(chrono::duration<double>(reportSeconds));
+                SchedulerMetrics metrics = scheduler.Metrics(true);
+
+                cout << fixed << setprecision(1)
+                     << metrics.throughput << " requests/s, "
+                     << metrics.averageBatchSize << " per batch, latency us mean " << metrics.meanLatency
+                     << " p50 " << metrics.p50Latency << " p99 " << metrics.p99Latency << " max " << metrics.maxLatency << endl;
+            }
+        });
+        reporter.detach();
+
+        while (true) {
+            int client = accept(server, nullptr, nullptr);
+
+            if (client < 0)
+                continue;
+
+            thread(Serve, client, ref(scheduler), cref(model)).detach();
+        }
+    }
+    catch (const exception &error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+}
+
+#else
+
+int main() {
+    cerr << "InferenceServer uses Unix domain sockets, which are only supported on POSIX systems" << endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "Dataset.hpp"
+#include "InferenceModel.hpp"
+#include "LowRank.hpp"
+#include "Matrix.hpp"
+#include "NeuralNetwork.hpp"
+
+using namespace NeuralNetwork;
+using namespace std;
+
+/**
+ * Reports the accuracy and latency of a trained model with each of its layers factorized at several ranks, to choose a compression level
+ *
+ * RankReport <model> <testing dataset> [rank...]
+ *
+ * Each layer is factorized alone, the other layers keeping their whole weights. Without ranks, powers of two below the
+ * smaller dimension of each layer are tried. The weights column counts the weights of the layer, in both factors when factorized,
+ * and the energy column is the fraction of the squared singular values kept
+ */
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        cerr << "usage: RankReport <model> <testing dataset> [rank...]" << endl;
+        return 1;
+    }
+
+    vector<size_t> ranks;
+
+    for (int i = 3; i < argc; i++) {
+        ranks.push_back(stoul(argv[i]));
+    }
+
+    try {
+        // Testing instances as single precision, one instance after another
+        Benchmark::Instances testing = Benchmark::ReadInstances(Dataset::Load(argv[2]));
+        const size_t count = testing.count;
+        const vector<float> &inputs = testing.inputs;
+        const vector<size_t> &classes = testing.classes;
+
+        // Accuracy, and the median latency of an instance in batches of 64 and alone
+        auto measure = [&](const MultilayerPerceptron &model) {
+            InferenceModel inference = model.Compile(64, 0);
+            const size_t outputSize = inference.outputSize();
+            vector<float> outputs(count * outputSize);
+
+            inference.Predict(inputs.data(), count, outputs.data());
+            size_t correct = 0;
+
+            for (size_t i = 0; i < count; i++) {
+                const float *output = &outputs[i * outputSize];
+                correct += (size_t) (max_element(output, output + outputSize) - output) == classes[i];
+            }
+
+            size_t next = 0;
+            double batch = Benchmark::Median([&] { inference.Predict(inputs.data(), min<size_t>(64, count), outputs.data()); }, 200) / min<size_t>(64, count);
+            double single = Benchmark::Median([&] { inference.Predict(&inputs[next++ % count * inference.inputSize()], outputs.data()); }, 5000);
+
+            cout << setw(10) << setprecision(4) << (double) correct / count << setprecision(2) << setw(12) << batch << setw(12) << single << endl;
+        };
+
+        MultilayerPerceptron original;
+        original.Load(argv[1]);
+
+        cout << left << setw(8) << "layer" << right << setw(8) << "rank" << setw(12) << "weights" << setw(10) << "energy"
+             << setw(10) << "accuracy" << setw(12) << "batch us" << setw(12) << "single us" << endl;
+
+        cout << left << setw(8) << "-" << right << setw(8) << "full" << setw(12) << "" << setw(10) << "" << fixed;
+        measure(original);
+
+        for (size_t layer = 1; layer < original.layerCount(); layer++) {
+            // Factorizing a copy reports the singular values and shape of the layer
+            MultilayerPerceptron probe;
+            probe.Load(argv[1]);
+            LowRankFactors probeFactors = probe.Factorize(layer, 1);
+
+            const vector<double> &singularValues = probeFactors.singularValues;
+            const size_t fullRank = singularValues.size();
+            const size_t weightCount = probeFactors.u.rows * probeFactors.v.cols;
+            double totalEnergy = 0;
+
+            for (double value : singularValues) {
+                totalEnergy += value * value;
+            }
+
+            vector<size_t> layerRanks = ranks;
+
+            if (layerRanks.empty()) {
+                for (size_t rank = 1; rank < fullRank; rank *= 2) {
+                    layerRanks.push_back(rank);
+                }
+            }
+
+            cout << left << setw(8) << layer << right << setw(8) << "full" << setw(12) << weightCount << endl;
+
+            for (size_t rank : layerRanks) {
+                if (rank == 0 || rank > fullRank)
+                    continue;
+
+                MultilayerPerceptron model;
+                model.Load(argv[1]);
+                model.Factorize(layer, rank);
+
+                double energy = 0;
+
+                for (size_t k = 0; k < rank; k++) {
+                    energy += singularValues[k] * singularValues[k];
+                }
+
+                cout << left << setw(8) << layer << right << setw(8) << rank << setw(12) << rank * (probeFactors.u.rows + probeFactors.v.cols)
+                     << setw(10) << setprecision(4) << (totalEnergy > 0 ? energy / totalEnergy : 1);
+                measure(model);
+            }
+        }
+    }
+    catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}